@@ -212,6 +212,7 @@ class VppTestCase(unittest.TestCase):
     #  @param cls The class pointer.
     #  @param v Integer variable to store required level of verbosity.
     #  @param s String variable to store cli command string.
+    #  @return out String variable with the cli command output.
     @classmethod
     def cli(cls, v, s):
         if cls.verbose < v:
@@ -228,6 +229,7 @@ class VppTestCase(unittest.TestCase):
         if cls.verbose > 0:
             if len(out) > 1:
                 print YELLOW + out + END
+        return out
         ## @var p
         #  Object variable to store file descriptor of vpp_api_test subprocess
         #  with open pipes to the standard output, inputs and error streams.
@@ -0,0 +1,34 @@
+#!/usr/bin/env python
+## @file test_dpdk_clone.py
+#  Module to run the DPDK buffer clone unit tests.
+#
+#  The module runs the "test dpdk clone" CLI, which clones buffer chains of
+#  1 to 64 segments and checks the clones byte by byte.
+
+import unittest
+from framework import VppTestCase, VppTestRunner
+
+
+## Subclass of the VppTestCase class.
+#
+#  No interfaces, the unit tests build their own buffer chains.
+class TestDpdkClone(VppTestCase):
+    """ DPDK Buffer Clone Test Case """
+
+    ## Method defining the clone unit tests.
+    #  @param self The object pointer.
+    def test_dpdk_clone(self):
+        """ DPDK clone of 1 to 64 segment chains
+
+        Test scenario:
+            chains of 1 to 64 segments of 64B, 1500B and 2047B are cloned
+            into the shared buffer pool, and into the jumbo pool if any,
+            every clone holds the packet data in full buffers
+        """
+        out = self.cli(0, "test dpdk clone segments 64")
+        self.assertTrue("FAIL" not in out, out)
+        self.assertTrue("PASS" in out, out)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+## @file test_ip4_forward_perf.py
+#  Module to provide IPv4 forwarding benchmark test case.
+#
+#  The module replays a pcap of packets to 4096 routes through pg0, routed
+#  out of pg1, with the ip4-lookup and ip4-rewrite main loops 2, 4 and 8
+#  packets wide, and reports the clocks/packet of both nodes from the node
+#  runtime statistics. Run it alone with "make test TEST=ip4_forward_perf".
+
+import logging
+logging.getLogger("scapy.runtime").setLevel(logging.ERROR)
+
+import unittest
+from framework import VppTestCase, VppTestRunner
+from util import Util
+from scapy.layers.l2 import Ether, Raw
+from scapy.layers.inet import IP, UDP
+from scapy.utils import wrpcap
+
+
+## Subclass of the VppTestCase class.
+#
+#  pg0 and pg1 are IPv4 interfaces, 10.{0-15}.{0-255}.0/24 are routed to
+#  the pg1 peer.
+class TestIp4ForwardPerf(Util, VppTestCase):
+    """ IPv4 Forwarding Benchmark Test Case """
+
+    # Test variables
+    widths = [2, 4, 8]      # Main loop widths per benchmark run
+    strides = ["8-8-8-8", "16-8-8"]   # Mtrie strides of table 0
+    n_routes = 4096         # Number of /24 routes
+    pkts_per_pcap = 2048    # Number of packets in the pcap
+    n_replays = 4           # Number of pcap replays per benchmark run
+    pcap_file = "/tmp/ip4_forward_perf.pcap"
+
+    ## Class method to start the test case.
+    #  Overrides setUpClass method in VppTestCase class.
+    #  Adds the routes and writes the pcap file.
+    #  @param cls The class pointer.
+    @classmethod
+    def setUpClass(cls):
+        super(TestIp4ForwardPerf, cls).setUpClass()
+
+        try:
+            cls.interfaces = range(2)
+            cls.create_interfaces(cls.interfaces)
+            cls.config_ip4(cls.interfaces)
+            cls.resolve_arp(cls.interfaces)
+
+            for i in range(TestIp4ForwardPerf.n_routes):
+                cls.cli(2, "ip route add 10.%u.%u.0/24 via %s" %
+                        (i / 256, i % 256, cls.MY_IP4S[1]))
+
+            pkts = []
+            for i in range(TestIp4ForwardPerf.pkts_per_pcap):
+                r = (i * 7919) % TestIp4ForwardPerf.n_routes
+                p = (Ether(dst=cls.VPP_MACS[0], src=cls.MY_MACS[0]) /
+                     IP(src=cls.MY_IP4S[0],
+                        dst="10.%u.%u.%u" % (r / 256, r % 256, 1 + i % 254)) /
+                     UDP(sport=1024 + i % 256, dport=1234) /
+                     Raw("%u" % i))
+                cls.extend_packet(p, 64)
+                pkts.append(p)
+            wrpcap(TestIp4ForwardPerf.pcap_file, pkts)
+
+        except Exception as e:
+            cls.tearDownClass()
+            raise e
+
+    ## Method to define tear down VPP actions of the test case.
+    #  Overrides tearDown method in VppTestCase class.
+    #  @param self The object pointer.
+    def tearDown(self):
+        self.cli(2, "show error")
+        self.cli(2, "show run")
+
+    ## Method to read the node runtime statistics.
+    #  Parses "show runtime" output, columns are
+    #  Name State Calls Vectors Suspends Clocks Vectors/Call.
+    #  @param self The object pointer.
+    #  @return nodes Dictionary of (vectors, clocks/vector) by node name.
+    def runtime(self):
+        nodes = {}
+        for line in self.cli(0, "show runtime").splitlines():
+            f = line.split()
+            if len(f) >= 7 and f[3].isdigit():
+                nodes[f[0]] = (int(f[3]), float(f[5]))
+        return nodes
+
+    ## Method to run one benchmark.
+    #  Replays the pcap n_replays times and logs the results.
+    #  @param self The object pointer.
+    #  @param width Integer variable to store the main loop width.
+    #  @param stride String variable to store the mtrie stride.
+    def run_benchmark(self, width, stride):
+        self.cli(0, "set ip forward loop-width %u" % width)
+        self.cli(0, "set ip fib mtrie stride %s table 0" % stride)
+
+        self.cli(0, "clear runtime")
+        for r in range(TestIp4ForwardPerf.n_replays):
+            self.cli(0, "packet-generator new pcap %s source pg0 name bench" %
+                     TestIp4ForwardPerf.pcap_file)
+            self.cli(0, "packet-generator enable")
+            self.cli(0, "packet-generator delete bench")
+        nodes = self.runtime()
+
+        n_pkts = TestIp4ForwardPerf.pkts_per_pcap * TestIp4ForwardPerf.n_replays
+        self.assertEqual(nodes["ip4-lookup"][0], n_pkts)
+        self.assertEqual(nodes["ip4-rewrite-transit"][0], n_pkts)
+
+        self.log("ip4 forward loop width %u, %s mtrie: ip4-lookup %.2f "
+                 "clocks/packet, ip4-rewrite-transit %.2f clocks/packet" %
+                 (width, stride, nodes["ip4-lookup"][1],
+                  nodes["ip4-rewrite-transit"][1]), 0)
+
+    ## Method defining the loop width configuration.
+    #  @param self The object pointer.
+    def test_ip4_forward_loop_width(self):
+        """ Set the ip4 forwarding loop width
+
+        Test scenario:
+            widths 2, 4 and 8 are accepted, 3 is rejected
+        """
+        for width in TestIp4ForwardPerf.widths:
+            self.cli(0, "set ip forward loop-width %u" % width)
+            out = self.cli(0, "set ip forward loop-width")
+            self.assertTrue("width %u" % width in out, out)
+
+        out = self.cli(0, "set ip forward loop-width 3")
+        self.assertTrue("must be 2, 4 or 8" in out, out)
+
+    ## Method defining the forwarding benchmark.
+    #  @param self The object pointer.
+    def test_ip4_forward_perf(self):
+        """ IPv4 forwarding benchmark
+
+        Test scenario:
+        1.config
+            4096 /24 routes via pg1, main loops 2, 4 and 8 packets wide,
+            8-8-8-8 and 16-8-8 mtries
+
+        2.replaying the pcap
+            every packet is looked up and rewritten
+        """
+        for stride in TestIp4ForwardPerf.strides:
+            for width in TestIp4ForwardPerf.widths:
+                self.run_benchmark(width, stride)
+        self.cli(0, "set ip forward loop-width 2")
+        self.cli(0, "set ip fib mtrie stride 8-8-8-8 table 0")
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
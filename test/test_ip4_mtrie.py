@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+## @file test_ip4_mtrie.py
+#  Module to test the 8-8-8-8 and 16-8-8 IPv4 mtries.
+#
+#  The module runs the "test ip4 mtrie" CLI, which fills both mtries with
+#  the same random routes and compares their lookups, and switches the
+#  stride of a FIB table.
+
+import unittest
+from framework import VppTestCase, VppTestRunner
+
+
+## Subclass of the VppTestCase class.
+#
+#  No interfaces, the mtrie test builds its own scratch mtries.
+class TestIp4Mtrie(VppTestCase):
+    """ IPv4 Mtrie Test Case """
+
+    ## Method defining the mtrie lookup comparison.
+    #  @param self The object pointer.
+    def test_ip4_mtrie_lookup(self):
+        """ 8-8-8-8 and 16-8-8 mtrie lookups agree
+
+        Test scenario:
+            both mtries get the same random routes, random destinations
+            return the same adjacencies, before and after deleting half
+            of the routes
+        """
+        out = self.cli(0, "test ip4 mtrie nroutes 20000 nlookups 100000")
+        self.assertTrue("FAIL" not in out, out)
+        self.assertTrue("PASS" in out, out)
+
+    ## Method defining the stride change of a FIB table.
+    #  @param self The object pointer.
+    def test_ip4_mtrie_stride(self):
+        """ Set the mtrie stride of a FIB table
+
+        Test scenario:
+            the mtrie of table 0 is rebuilt as 16-8-8 and back to 8-8-8-8
+        """
+        self.cli(0, "ip route add 10.1.0.0/16 via 172.16.1.2 next-hop-table 0")
+        self.cli(0, "ip route add 10.1.2.0/24 via 172.16.1.2 next-hop-table 0")
+
+        self.cli(0, "set ip fib mtrie stride 16-8-8 table 0")
+        out = self.cli(0, "show ip fib table 0 mtrie")
+        self.assertTrue("16-8-8 stride" in out, out)
+        self.assertTrue("10.1.2.0/24" in out, out)
+
+        self.cli(0, "set ip fib mtrie stride 8-8-8-8 table 0")
+        out = self.cli(0, "show ip fib table 0 mtrie")
+        self.assertTrue("8-8-8-8 stride" in out, out)
+
+        out = self.cli(0, "set ip fib mtrie stride 16-8-8 table 42")
+        self.assertTrue("no such table" in out, out)
+
+        self.cli(0, "ip route del 10.1.2.0/24")
+        self.cli(0, "ip route del 10.1.0.0/16")
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
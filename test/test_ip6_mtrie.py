@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+## @file test_ip6_mtrie.py
+#  Module to test the IPv6 FIB mtrie.
+#
+#  The module runs the "test ip6 mtrie" CLI, which compares the lookups of
+#  the forwarding hash and of the mtrie on a synthetic BGP table, and
+#  enables and disables the mtrie of a FIB table.
+
+import unittest
+from framework import VppTestCase, VppTestRunner
+
+
+## Subclass of the VppTestCase class.
+#
+#  No interfaces, the mtrie test fills its own scratch table.
+class TestIp6Mtrie(VppTestCase):
+    """ IPv6 Mtrie Test Case """
+
+    ## Method defining the hash and mtrie lookup comparison.
+    #  @param self The object pointer.
+    def test_ip6_mtrie_lookup(self):
+        """ IPv6 hash and mtrie lookups agree
+
+        Test scenario:
+            half of a synthetic BGP table is added before the mtrie is
+            built, half after, then half of it is deleted, random
+            destinations get the same load balance from the hash and the
+            mtrie
+        """
+        out = self.cli(0, "test ip6 mtrie nroutes 20000 nlookups 100000")
+        self.assertTrue("FAIL" not in out, out)
+        self.assertTrue("PASS" in out, out)
+
+    ## Method defining the mtrie enable and disable of a FIB table.
+    #  @param self The object pointer.
+    def test_ip6_mtrie_enable(self):
+        """ Enable and disable the mtrie of a FIB table
+
+        Test scenario:
+            the mtrie of table 0 is built from its routes, then removed
+        """
+        self.cli(0, "set ip6 fib mtrie table 0 enable")
+        out = self.cli(0, "show ip6 fib table 0 mtrie summary")
+        self.assertTrue("non-empty root leaves" in out, out)
+
+        self.cli(0, "set ip6 fib mtrie table 0 disable")
+        out = self.cli(0, "show ip6 fib table 0 mtrie summary")
+        self.assertTrue("mtrie not in use" in out, out)
+
+        out = self.cli(0, "set ip6 fib mtrie table 42 enable")
+        self.assertTrue("no such table" in out, out)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -0,0 +1,190 @@
+#!/usr/bin/env python
+## @file test_span_perf.py
+#  Module to provide SPAN (port mirroring) benchmark test case.
+#
+#  The module replays a canonical IMIX pcap through the packet generator
+#  into a mirrored interface with 1, 4 and 16 mirror destinations and
+#  reports, from the node runtime statistics, packets/sec of the whole
+#  path, clocks/packet of the TX (span-output) and RX (span-l2-input)
+#  mirroring nodes, and mirror buffer allocation failures. Run it alone
+#  with "make test TEST=span_perf".
+
+import logging
+logging.getLogger("scapy.runtime").setLevel(logging.ERROR)
+
+import re
+import unittest
+from framework import VppTestCase, VppTestRunner
+from util import Util
+from scapy.layers.l2 import Ether, Raw
+from scapy.layers.inet import IP, UDP
+from scapy.utils import wrpcap
+
+
+## Subclass of the VppTestCase class.
+#
+#  pg0 is L2 cross-connected to pg1. Traffic received on pg0 (rx) or
+#  leaving pg1 (tx) is mirrored to pg2 ... pg17, one destination per
+#  mirror. The destinations do not capture, their TX only frees buffers.
+class TestSpanPerf(Util, VppTestCase):
+    """ SPAN Benchmark Test Case """
+
+    # Test variables
+    n_dsts = [1, 4, 16]     # Mirror destinations per benchmark run
+    interf_nr = 2 + 16      # Number of interfaces
+    imix = [64] * 7 + [594] * 4 + [1518]   # IMIX 7:4:1 packet sizes
+    pkts_per_pcap = 1200    # Number of packets in the canonical pcap
+    n_replays = 4           # Number of pcap replays per benchmark run
+    pcap_file = "/tmp/span_perf.pcap"
+
+    ## Class method to start the test case.
+    #  Overrides setUpClass method in VppTestCase class.
+    #  Writes the canonical pcap file, replayed by every benchmark run.
+    #  @param cls The class pointer.
+    @classmethod
+    def setUpClass(cls):
+        super(TestSpanPerf, cls).setUpClass()
+
+        try:
+            cls.interfaces = range(TestSpanPerf.interf_nr)
+            cls.create_interfaces(cls.interfaces)
+
+            cls.api("sw_interface_set_l2_xconnect rx pg0 tx pg1 enable")
+
+            pkts = []
+            for i in range(TestSpanPerf.pkts_per_pcap):
+                p = (Ether(dst="00:00:00:ff:01:01", src="00:00:00:ff:00:01") /
+                     IP(src="172.17.100.%u" % (1 + i % 64),
+                        dst="172.17.101.1") /
+                     UDP(sport=1024 + i % 256, dport=1234) /
+                     Raw("%u" % i))
+                cls.extend_packet(p, TestSpanPerf.imix[i % 12])
+                pkts.append(p)
+            wrpcap(TestSpanPerf.pcap_file, pkts)
+
+        except Exception as e:
+            cls.tearDownClass()
+            raise e
+
+    ## Method to define tear down VPP actions of the test case.
+    #  Overrides tearDown method in VppTestCase class.
+    #  @param self The object pointer.
+    def tearDown(self):
+        self.cli(2, "show span")
+        self.cli(2, "show error")
+        self.cli(2, "show run")
+
+    ## Static method to return the nominal CPU clock rate.
+    #  Node runtime statistics are in CPU clocks, the rate converts them
+    #  to packets/sec.
+    #  @return hz Float variable to store the CPU clocks per second.
+    @staticmethod
+    def cpu_hz():
+        with open("/proc/cpuinfo") as f:
+            m = re.search(r"cpu MHz\s*:\s*([0-9.]+)", f.read())
+        return float(m.group(1)) * 1e6
+
+    ## Method to read the node runtime statistics.
+    #  Parses "show runtime" output, columns are
+    #  Name State Calls Vectors Suspends Clocks Vectors/Call.
+    #  @param self The object pointer.
+    #  @return nodes Dictionary of (vectors, clocks/vector) by node name.
+    def runtime(self):
+        nodes = {}
+        for line in self.cli(0, "show runtime").splitlines():
+            f = line.split()
+            if len(f) >= 7 and f[3].isdigit():
+                nodes[f[0]] = (int(f[3]), float(f[5]))
+        return nodes
+
+    ## Method to read the SPAN counters of a source interface.
+    #  @param self The object pointer.
+    #  @param src String variable to store the source interface name.
+    #  @return (mirrored, failures) Tuple of the mirrored packets and of the
+    #  copy/clone failures counted for the source.
+    def span_counters(self, src):
+        out = self.cli(0, "show span")
+        m = re.search(r"^%s \(.*\n\s+(\d+) mirrored packets \d+ bytes, "
+                      r"(\d+) copy/clone failures" % src, out, re.M)
+        if m is None:
+            return (0, 0)
+        return (int(m.group(1)), int(m.group(2)))
+
+    ## Method to run one benchmark.
+    #  Mirrors src to n destinations, replays the canonical pcap
+    #  n_replays times and logs the results.
+    #  @param self The object pointer.
+    #  @param src String variable to store the mirrored interface name.
+    #  @param args String variable to store the set span arguments.
+    #  @param node String variable to store the name of the mirroring node.
+    #  @param n Integer variable to store the number of destinations.
+    def run_benchmark(self, src, args, node, n):
+        for i in range(n):
+            self.cli(0, "set span src %s dst pg%u %s" % (src, 2 + i, args))
+        mirrored, failures = self.span_counters(src)
+
+        self.cli(0, "clear runtime")
+        for r in range(TestSpanPerf.n_replays):
+            self.cli(0, "packet-generator new pcap %s source pg0 name bench" %
+                     TestSpanPerf.pcap_file)
+            self.cli(0, "packet-generator enable")
+            self.cli(0, "packet-generator delete bench")
+        nodes = self.runtime()
+
+        n_mirrored, n_failures = self.span_counters(src)
+        n_mirrored -= mirrored
+        n_failures -= failures
+        self.cli(0, "set span src %s disable" % src)
+
+        n_pkts = TestSpanPerf.pkts_per_pcap * TestSpanPerf.n_replays
+        self.assertEqual(nodes["pg-input"][0], n_pkts)
+        self.assertEqual(n_mirrored + n_failures, n * n_pkts)
+
+        # all clocks spent on the path of the packets, per packet sent
+        clocks = sum(v * c for v, c in nodes.values()) / n_pkts
+        pps = self.cpu_hz() / clocks
+        self.log("SPAN %s %s %2u destinations: %.4e packets/sec, %.2f "
+                 "clocks/packet total, %s %.2f clocks/packet, "
+                 "%u buffer alloc failures" %
+                 (src, args, n, pps, clocks, node, nodes[node][1],
+                  n_failures), 0)
+
+    ## Method defining SPAN TX benchmark.
+    #  @param self The object pointer.
+    def test_span_perf_tx(self):
+        """ SPAN TX benchmark
+
+        Test scenario:
+        1.config
+            pg0 l2xconnected to pg1, pg1 TX mirrored to 1, 4 and 16
+            destinations, in copy and clone mode
+
+        2.replaying the canonical pcap
+            every packet is mirrored or counted as a failure
+        """
+        for mode in ("copy", "clone"):
+            for n in TestSpanPerf.n_dsts:
+                self.run_benchmark("pg1", "tx mode %s" % mode, "span-output",
+                                   n)
+
+    ## Method defining SPAN RX benchmark.
+    #  @param self The object pointer.
+    def test_span_perf_rx(self):
+        """ SPAN RX benchmark
+
+        Test scenario:
+        1.config
+            pg0 l2xconnected to pg1, pg0 L2 RX mirrored to 1, 4 and 16
+            destinations, in copy and clone mode
+
+        2.replaying the canonical pcap
+            every packet is mirrored or counted as a failure
+        """
+        for mode in ("copy", "clone"):
+            for n in TestSpanPerf.n_dsts:
+                self.run_benchmark("pg0", "l2 rx mode %s" % mode,
+                                   "span-l2-input", n)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -605,6 +605,14 @@ fill_free_list (vlib_main_t * vm,
   /* Always allocate new buffers in reasonably large sized chunks. */
   n = clib_max (n, fl->min_n_buffers_each_physmem_alloc);
 
+  /* Bounded free list: never grow past max_n_alloc buffers. */
+  if (fl->max_n_alloc)
+    {
+      n = clib_min (n, (int) fl->max_n_alloc - (int) fl->n_alloc);
+      if (n <= 0)
+	return 0;
+    }
+
   n_remaining = n;
   n_alloc = 0;
   while (n_remaining > 0)
@@ -844,6 +852,25 @@ vnet_buffer_free_dpdk_mb (vlib_buffer_t * b)
 {
 }
 
+/*
+ * Drops a reference to a buffer which may be shared with clones owned by
+ * other threads. Returns 1 if the caller held the last reference, and so
+ * must free the buffer.
+ */
+always_inline int
+vlib_buffer_release_reference (vlib_buffer_t * b)
+{
+  if (PREDICT_TRUE (b->n_add_refs == 0))
+    return 1;
+
+  if (__sync_fetch_and_sub (&b->n_add_refs, 1) > 0)
+    return 0;
+
+  /* The other owners released theirs meanwhile, undo the wrap */
+  b->n_add_refs = 0;
+  return 1;
+}
+
 static_always_inline void
 vlib_buffer_free_inline (vlib_main_t * vm,
 			 u32 * buffers, u32 n_buffers, u32 follow_buffer_next)
@@ -918,6 +945,27 @@ again:
       b0 = vlib_get_buffer (vm, bi0);
       b1 = vlib_get_buffer (vm, bi1);
 
+      /*
+       * Buffers shared with clones: drop our references. The buffers
+       * of which we held the last one are freed in the next round.
+       */
+      if (PREDICT_FALSE (b0->n_add_refs | b1->n_add_refs))
+	{
+	  f -= 2;
+	  n[0] = bi0;
+	  n += vlib_buffer_release_reference (b0);
+	  n[0] = bi1;
+	  n += vlib_buffer_release_reference (b1);
+	  if (CLIB_DEBUG > 0)
+	    {
+	      vlib_buffer_set_known_state (vm, bi0,
+					   VLIB_BUFFER_KNOWN_ALLOCATED);
+	      vlib_buffer_set_known_state (vm, bi1,
+					   VLIB_BUFFER_KNOWN_ALLOCATED);
+	    }
+	  continue;
+	}
+
       free0 = (b0->flags & VLIB_BUFFER_RECYCLE) == 0;
       free1 = (b1->flags & VLIB_BUFFER_RECYCLE) == 0;
 
@@ -1003,6 +1051,19 @@ again:
 
       b0 = vlib_get_buffer (vm, bi0);
 
+      /*
+       * Buffer is shared with one or more clones: just drop a reference.
+       * The last owner frees it, together with the rest of its chain.
+       */
+      if (PREDICT_FALSE (vlib_buffer_release_reference (b0) == 0))
+	{
+	  f -= 1;
+	  if (CLIB_DEBUG > 0)
+	    vlib_buffer_set_known_state (vm, bi0,
+					 VLIB_BUFFER_KNOWN_ALLOCATED);
+	  continue;
+	}
+
       free0 = (b0->flags & VLIB_BUFFER_RECYCLE) == 0;
 
       /* Must be before init which will over-write buffer flags. */
@@ -1053,7 +1114,7 @@ again:
 			/* align */ sizeof (vlib_copy_unit_t));
     }
 
-  if (follow_buffer_next && ((n_left = n - next_to_free[i_next_to_free]) > 0))
+  if ((n_left = n - next_to_free[i_next_to_free]) > 0)
     {
       b = next_to_free[i_next_to_free];
       i_next_to_free ^= 1;
@@ -50,6 +50,8 @@
 #include <rte_config.h>
 #define VLIB_BUFFER_DATA_SIZE		(2048)
 #define VLIB_BUFFER_PRE_DATA_SIZE	RTE_PKTMBUF_HEADROOM
+/* Data size of the optional jumbo pools, a whole 9K frame per buffer */
+#define VLIB_BUFFER_JUMBO_DATA_SIZE	(9216)
 #else
 #include <vlib/config.h>	/* for __PRE_DATA_SIZE */
 #define VLIB_BUFFER_DATA_SIZE		(512)
@@ -122,10 +124,17 @@ typedef struct
                                visit enabled feature nodes
                             */
 
-  u32 dont_waste_me; /**< Available space in the (precious)
-                        first 32 octets of buffer metadata
-                        Before allocating any of it, discussion required!
-                     */
+  u8 n_add_refs; /**< Number of additional references to this buffer,
+                    i.e. clone heads chained to it (see vlib_buffer_clone).
+                    The buffer is only returned to its free list once
+                    the last reference is dropped. DPDK builds track
+                    references in the rte_mbuf refcnt instead.
+                 */
+
+  u8 dont_waste_me[3]; /**< Available space in the (precious)
+                          first 32 octets of buffer metadata
+                          Before allocating any of it, discussion required!
+                       */
 
   u32 opaque[8]; /**< Opaque data used by sub-graphs for their own purposes.
                     See .../vnet/vnet/buffer.h
@@ -261,6 +270,9 @@ typedef struct vlib_buffer_free_list_t
   /* Total number of buffers allocated from this free list. */
   u32 n_alloc;
 
+  /* Upper bound of n_alloc, 0 if the free list may grow without bound. */
+  u32 max_n_alloc;
+
   /* Vector of free buffers.  Each element is a byte offset into I/O heap.
      Aligned vectors always has naturally aligned vlib_copy_unit_t sized chunks
      of buffer indices.  Unaligned vector has any left over.  This is meant to
@@ -287,6 +299,12 @@ typedef struct vlib_buffer_free_list_t
     (struct vlib_main_t * vm, struct vlib_buffer_free_list_t * fl);
 
   uword buffer_init_function_opaque;
+
+#if DPDK == 1
+  /* Private per-socket mempools buffers are taken from, if set, instead
+     of the shared pktmbuf_pools. Freed buffers return to their own pool. */
+  struct rte_mempool **pktmbuf_pools;
+#endif
 } __attribute__ ((aligned (16))) vlib_buffer_free_list_t;
 
 typedef struct
@@ -319,6 +337,8 @@ typedef struct
   /*  Vector of rte_mempools per socket */
 #if DPDK == 1
   struct rte_mempool **pktmbuf_pools;
+  /* Vector of jumbo buffer rte_mempools per socket, may be empty */
+  struct rte_mempool **jumbo_pktmbuf_pools;
 #endif
 } vlib_buffer_main_t;
 
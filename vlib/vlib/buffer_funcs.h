@@ -256,6 +256,13 @@ u8 *vlib_validate_buffers (vlib_main_t * vm,
 
 clib_error_t *vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
 				       unsigned socket_id);
+clib_error_t *vlib_buffer_free_list_pool_create (vlib_main_t * vm,
+						 u32 free_list_index,
+						 unsigned num_mbufs,
+						 unsigned socket_id);
+clib_error_t *vlib_buffer_jumbo_pool_create (vlib_main_t * vm,
+					     unsigned num_mbufs,
+					     unsigned socket_id);
 
 /** \brief Allocate buffers into supplied array
 
@@ -522,6 +529,303 @@ vlib_buffer_chain_append_data_with_alloc (vlib_main_t * vm,
 					  void *data, u16 data_len);
 void vlib_buffer_chain_validate (vlib_main_t * vm, vlib_buffer_t * first);
 
+/* Buffer flags which are never inherited by copies or clones. */
+#define VLIB_BUFFER_CLONE_FLAGS_MASK \
+  (~(VLIB_BUFFER_RECYCLE | VLIB_BUFFER_IS_RECYCLED | VLIB_BUFFER_REPL_FAIL))
+
+/* Packets with a shorter tail past the head are copied, not cloned. */
+#define VLIB_BUFFER_CLONE_MIN_TAIL_BYTES (2 * CLIB_CACHE_LINE_BYTES)
+
+/** \brief Copy buffer chain, first buffer of the copy supplied by caller
+
+    Data, length and opaque metadata of every buffer in the chain are
+    copied. The first segment is copied into the already allocated
+    buffer di, any further segments are allocated from the free list
+    of di. On allocation failure di is freed as well.
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param b - (vlib_buffer_t *) first buffer of the chain to copy
+    @param di - (u32) allocated buffer index receiving the first segment
+    @return - (vlib_buffer_t *) first buffer of the copy, or 0 if
+    buffers could not be allocated
+*/
+always_inline vlib_buffer_t *
+vlib_buffer_copy_to (vlib_main_t * vm, vlib_buffer_t * b, u32 di)
+{
+  vlib_buffer_t *s = b, *d, *fd = 0, *ld = 0;
+
+  while (1)
+    {
+      d = vlib_get_buffer (vm, di);
+
+      d->current_data = s->current_data;
+      d->current_length = s->current_length;
+      d->flags = s->flags & VLIB_BUFFER_CLONE_FLAGS_MASK
+	& ~VLIB_BUFFER_NEXT_PRESENT;
+      clib_memcpy (vlib_buffer_get_current (d), vlib_buffer_get_current (s),
+		   s->current_length);
+#if DPDK == 1
+      {
+	struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (d);
+	mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + d->current_data;
+	mb->data_len = d->current_length;
+      }
+#endif
+
+      if (fd == 0)
+	{
+	  fd = d;
+	  fd->total_length_not_including_first_buffer =
+	    s->total_length_not_including_first_buffer;
+	  fd->trace_index = s->trace_index;
+	  clib_memcpy (fd->opaque, s->opaque, sizeof (s->opaque));
+	}
+      else
+	{
+	  ld->next_buffer = di;
+	  ld->flags |= VLIB_BUFFER_NEXT_PRESENT;
+#if DPDK == 1
+	  rte_mbuf_from_vlib_buffer (ld)->next = rte_mbuf_from_vlib_buffer (d);
+	  rte_mbuf_from_vlib_buffer (fd)->nb_segs++;
+#endif
+	}
+      ld = d;
+
+      if (!(s->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      s = vlib_get_buffer (vm, s->next_buffer);
+
+      if (PREDICT_FALSE (vlib_buffer_alloc_from_free_list
+			 (vm, &di, 1, fd->free_list_index) != 1))
+	{
+	  vlib_buffer_free_one (vm, vlib_get_buffer_index (vm, fd));
+	  return 0;
+	}
+    }
+
+#if DPDK == 1
+  rte_mbuf_from_vlib_buffer (fd)->pkt_len =
+    vlib_buffer_length_in_chain (vm, fd);
+#endif
+  return fd;
+}
+
+/** \brief Copy the leading bytes of a buffer, first buffer supplied by caller
+
+    At most n_bytes of the first segment are copied into the already
+    allocated buffer di, together with the opaque metadata. Chained
+    segments are never read, the copy is always a single buffer.
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param b - (vlib_buffer_t *) buffer to copy
+    @param di - (u32) allocated buffer index receiving the copy
+    @param n_bytes - (u32) maximum number of bytes to copy
+    @return - (vlib_buffer_t *) the copy
+*/
+always_inline vlib_buffer_t *
+vlib_buffer_copy_head_to (vlib_main_t * vm, vlib_buffer_t * b, u32 di,
+			  u32 n_bytes)
+{
+  vlib_buffer_t *d = vlib_get_buffer (vm, di);
+
+  d->current_data = b->current_data;
+  d->current_length = clib_min (b->current_length, n_bytes);
+  d->flags = b->flags & VLIB_BUFFER_CLONE_FLAGS_MASK
+    & ~VLIB_BUFFER_NEXT_PRESENT;
+  d->total_length_not_including_first_buffer = 0;
+  d->trace_index = b->trace_index;
+  clib_memcpy (d->opaque, b->opaque, sizeof (b->opaque));
+  clib_memcpy (vlib_buffer_get_current (d), vlib_buffer_get_current (b),
+	       d->current_length);
+#if DPDK == 1
+  {
+    struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (d);
+    mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + d->current_data;
+    mb->data_len = d->current_length;
+    mb->pkt_len = d->current_length;
+  }
+#endif
+
+  return d;
+}
+
+/** \brief Copy buffer chain into freshly allocated buffers
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param b - (vlib_buffer_t *) first buffer of the chain to copy
+    @return - (vlib_buffer_t *) first buffer of the copy, or 0 if
+    buffers could not be allocated
+*/
+always_inline vlib_buffer_t *
+vlib_buffer_copy (vlib_main_t * vm, vlib_buffer_t * b)
+{
+  u32 di;
+
+  if (PREDICT_FALSE (vlib_buffer_alloc (vm, &di, 1) != 1))
+    return 0;
+
+  return vlib_buffer_copy_to (vm, b, di);
+}
+
+/** \brief Attach already allocated heads to a buffer, making them clones
+
+    The common part of vlib_buffer_clone, for callers which allocate the
+    head buffers in bulk. The packet must be longer than head_end_offset.
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param src_buffer - (u32) source buffer index
+    @param heads - (u32 * ) allocated head buffer indices
+    @param n_heads - (u8) number of heads
+    @param head_end_offset - (u16) offset relative to current position
+           where packet head ends
+*/
+always_inline void
+vlib_buffer_clone_to_heads (vlib_main_t * vm, u32 src_buffer, u32 * heads,
+			    u8 n_heads, u16 head_end_offset)
+{
+  vlib_buffer_t *s = vlib_get_buffer (vm, src_buffer);
+  u32 tail_length;
+  u8 i;
+
+  ASSERT (n_heads);
+  ASSERT (s->current_length > head_end_offset);
+  ASSERT (s->n_add_refs + n_heads - 1 < 256);
+
+  tail_length = vlib_buffer_length_in_chain (vm, s) - head_end_offset;
+
+  for (i = 0; i < n_heads; i++)
+    {
+      vlib_buffer_t *d = vlib_get_buffer (vm, heads[i]);
+
+      d->current_data = s->current_data;
+      d->current_length = head_end_offset;
+      d->flags = (s->flags & VLIB_BUFFER_CLONE_FLAGS_MASK)
+	| VLIB_BUFFER_NEXT_PRESENT | VLIB_BUFFER_TOTAL_LENGTH_VALID;
+      d->total_length_not_including_first_buffer = tail_length;
+      d->next_buffer = src_buffer;
+      d->trace_index = s->trace_index;
+      clib_memcpy (d->opaque, s->opaque, sizeof (s->opaque));
+      clib_memcpy (vlib_buffer_get_current (d), vlib_buffer_get_current (s),
+		   head_end_offset);
+#if DPDK == 1
+      {
+	struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (d);
+	struct rte_mbuf *smb = rte_mbuf_from_vlib_buffer (s);
+	mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + d->current_data;
+	mb->data_len = head_end_offset;
+	mb->pkt_len = head_end_offset + tail_length;
+	mb->nb_segs = 1 + smb->nb_segs;
+	mb->next = smb;
+      }
+#endif
+    }
+
+  vlib_buffer_advance (s, head_end_offset);
+
+#if DPDK == 1
+  {
+    struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (s);
+    mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + s->current_data;
+    mb->data_len = s->current_length;
+    /* rte_pktmbuf_free walks the whole chain, so every segment
+       of the shared tail carries the additional references */
+    while (mb)
+      {
+	rte_mbuf_refcnt_update (mb, n_heads - 1);
+	mb = mb->next;
+      }
+  }
+#else
+  /* Other owners of a shared tail may release it concurrently */
+  __sync_fetch_and_add (&s->n_add_refs, n_heads - 1);
+#endif
+}
+
+/** \brief Create multiple clones of buffer and store them in the supplied array
+
+    Each clone is a freshly allocated head holding a private copy of the
+    first head_end_offset bytes of the packet (and of the opaque metadata),
+    chained to the source buffer. The source buffer becomes a reference
+    counted tail shared by all clones and must no longer be used directly.
+    Packets which are not much longer than the head are simply copied,
+    in which case the source buffer is returned as the first clone.
+
+    Nodes may freely rewrite the head of a clone. Chained buffers must
+    never be modified in place, since they may be shared with other
+    clones; see vlib_buffer_free_chain_tail.
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param src_buffer - (u32) source buffer index
+    @param buffers - (u32 * ) buffer index array
+    @param n_buffers - (u8) number of buffer clones requested
+    @param head_end_offset - (u16) offset relative to current position
+           where packet head ends
+    @return - (u8) number of buffers actually cloned, may be
+    less than the number requested. A return value of one means
+    that only the source buffer itself could be returned.
+*/
+always_inline u8
+vlib_buffer_clone (vlib_main_t * vm, u32 src_buffer, u32 * buffers,
+		   u8 n_buffers, u16 head_end_offset)
+{
+  vlib_buffer_t *s = vlib_get_buffer (vm, src_buffer);
+  u8 i;
+
+  ASSERT (n_buffers);
+
+  if (s->current_length <= head_end_offset + VLIB_BUFFER_CLONE_MIN_TAIL_BYTES)
+    {
+      buffers[0] = src_buffer;
+      for (i = 1; i < n_buffers; i++)
+	{
+	  vlib_buffer_t *d = vlib_buffer_copy (vm, s);
+	  if (PREDICT_FALSE (d == 0))
+	    return i;
+	  buffers[i] = vlib_get_buffer_index (vm, d);
+	}
+      return n_buffers;
+    }
+
+  n_buffers = vlib_buffer_alloc (vm, buffers, n_buffers);
+  if (PREDICT_FALSE (n_buffers == 0))
+    {
+      buffers[0] = src_buffer;
+      return 1;
+    }
+
+  vlib_buffer_clone_to_heads (vm, src_buffer, buffers, n_buffers,
+			      head_end_offset);
+  return n_buffers;
+}
+
+/** \brief Free all buffers chained after the given buffer
+
+    Truncates the packet to its first buffer. This is the copy-on-write
+    safe way to drop the rest of a chain: segments shared with clones
+    only lose one reference and are never modified.
+
+    @param vm - (vlib_main_t *) vlib main data structure pointer
+    @param b - (vlib_buffer_t *) first buffer of the chain
+*/
+always_inline void
+vlib_buffer_free_chain_tail (vlib_main_t * vm, vlib_buffer_t * b)
+{
+  if (!(b->flags & VLIB_BUFFER_NEXT_PRESENT))
+    return;
+
+  vlib_buffer_free_one (vm, b->next_buffer);
+  b->flags &= ~VLIB_BUFFER_NEXT_PRESENT;
+  b->total_length_not_including_first_buffer = 0;
+#if DPDK == 1
+  {
+    struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (b);
+    mb->next = 0;
+    mb->nb_segs = 1;
+    mb->pkt_len = mb->data_len;
+  }
+#endif
+}
+
 format_function_t format_vlib_buffer, format_vlib_buffer_and_data,
   format_vlib_buffer_contents;
 
@@ -240,6 +240,38 @@ generic_buffer_node_inline (vlib_main_t * vm,
   return frame->n_vectors;
 }
 
+/** \brief Enqueue a vector of buffers to a single next node.
+ Copies the buffer indices into as many next frames as required.
+ Use when a node has already sorted its buffers by next index.
+
+ @param vm vlib_main_t pointer, varies by thread
+ @param node current node vlib_node_runtime_t pointer
+ @param buffers buffer indices to enqueue
+ @param next_index next index shared by all buffers
+ @param count number of buffers
+*/
+always_inline void
+vlib_buffer_enqueue_to_single_next (vlib_main_t * vm,
+				    vlib_node_runtime_t * node,
+				    u32 * buffers, u32 next_index, u32 count)
+{
+  u32 *to_next, n_left_to_next, n_enq;
+
+  while (count > 0)
+    {
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      n_enq = clib_min (n_left_to_next, count);
+      clib_memcpy (to_next, buffers, n_enq * sizeof (u32));
+
+      buffers += n_enq;
+      count -= n_enq;
+      n_left_to_next -= n_enq;
+
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+}
+
 #endif /* included_vlib_buffer_node_h */
 
 /*
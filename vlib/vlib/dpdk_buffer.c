@@ -464,7 +464,8 @@ fill_free_list (vlib_main_t * vm,
   u32 bi;
   u32 n_remaining = 0, n_alloc = 0;
   unsigned socket_id = rte_socket_id ? rte_socket_id () : 0;
-  struct rte_mempool *rmp = vm->buffer_main->pktmbuf_pools[socket_id];
+  struct rte_mempool *rmp = fl->pktmbuf_pools ?
+    fl->pktmbuf_pools[socket_id] : vm->buffer_main->pktmbuf_pools[socket_id];
   struct rte_mbuf *mb;
 
   /* Too early? */
@@ -745,7 +746,8 @@ vlib_buffer_free_inline (vlib_main_t * vm,
 	  if (PREDICT_TRUE ((b->flags & VLIB_BUFFER_RECYCLE) == 0))
 	    {
 	      mb = rte_mbuf_from_vlib_buffer (b);
-	      ASSERT (rte_mbuf_refcnt_read (mb) == 1);
+	      /* refcnt > 1 for tails shared with vlib_buffer_clone heads */
+	      ASSERT (rte_mbuf_refcnt_read (mb) >= 1);
 	      rte_pktmbuf_free (mb);
 	    }
 	}
@@ -964,11 +966,16 @@ vlib_buffer_chain_validate (vlib_main_t * vm, vlib_buffer_t * b_first)
     }
 }
 
-clib_error_t *
-vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
-			 unsigned socket_id)
+/*
+ * Create the mempool of a socket in the per-socket vector *pools, named
+ * <prefix>_socket<n>. Buffer indices must stay within range of the
+ * physmem virtual area, which is extended to cover the new pool.
+ */
+static clib_error_t *
+buffer_pool_create (vlib_main_t * vm, struct rte_mempool ***pools,
+		    char *prefix, unsigned num_mbufs, unsigned cache_size,
+		    unsigned data_size, unsigned socket_id)
 {
-  vlib_buffer_main_t *bm = vm->buffer_main;
   vlib_physmem_main_t *vpm = &vm->physmem_main;
   struct rte_mempool *rmp;
 #if RTE_VERSION < RTE_VERSION_NUM(16, 7, 0, 0)
@@ -979,19 +986,19 @@ vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
   if (!rte_pktmbuf_pool_create)
     return clib_error_return (0, "not linked with DPDK");
 
-  vec_validate_aligned (bm->pktmbuf_pools, socket_id, CLIB_CACHE_LINE_BYTES);
+  vec_validate_aligned (*pools, socket_id, CLIB_CACHE_LINE_BYTES);
 
   /* pool already exists, nothing to do */
-  if (bm->pktmbuf_pools[socket_id])
+  if ((*pools)[socket_id])
     return 0;
 
-  u8 *pool_name = format (0, "mbuf_pool_socket%u%c", socket_id, 0);
+  u8 *pool_name = format (0, "%s_socket%u%c", prefix, socket_id, 0);
 
   rmp = rte_pktmbuf_pool_create ((char *) pool_name,	/* pool name */
 				 num_mbufs,	/* number of mbufs */
-				 512,	/* cache size */
+				 cache_size,	/* cache size */
 				 VLIB_BUFFER_HDR_SIZE,	/* priv size */
-				 VLIB_BUFFER_PRE_DATA_SIZE + VLIB_BUFFER_DATA_SIZE,	/* dataroom size */
+				 VLIB_BUFFER_PRE_DATA_SIZE + data_size,	/* dataroom size */
 				 socket_id);	/* cpu socket */
 
   if (rmp)
@@ -1058,7 +1065,7 @@ vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
       }
       if (rmp)
 	{
-	  bm->pktmbuf_pools[socket_id] = rmp;
+	  (*pools)[socket_id] = rmp;
 	  vec_free (pool_name);
 	  return 0;
 	}
@@ -1088,7 +1095,7 @@ vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
 
   if (rmp)
     {
-      bm->pktmbuf_pools[socket_id] = rmp;
+      (*pools)[socket_id] = rmp;
       vpm->virtual.start = new_start;
       vpm->virtual.size = new_size;
       vpm->virtual.end = new_start + new_size;
@@ -1100,15 +1107,15 @@ vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
   vec_free (pool_name);
 
   /* no usable pool for this socket, try to use pool from another one */
-  for (i = 0; i < vec_len (bm->pktmbuf_pools); i++)
+  for (i = 0; i < vec_len (*pools); i++)
     {
-      if (bm->pktmbuf_pools[i])
+      if ((*pools)[i])
 	{
 	  clib_warning
 	    ("WARNING: Failed to allocate mempool for CPU socket %u. "
 	     "Threads running on socket %u will use socket %u mempool.",
 	     socket_id, socket_id, i);
-	  bm->pktmbuf_pools[socket_id] = bm->pktmbuf_pools[i];
+	  (*pools)[socket_id] = (*pools)[i];
 	  return 0;
 	}
     }
@@ -1117,6 +1124,54 @@ vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
 			    socket_id);
 }
 
+clib_error_t *
+vlib_buffer_pool_create (vlib_main_t * vm, unsigned num_mbufs,
+			 unsigned socket_id)
+{
+  return buffer_pool_create (vm, &vm->buffer_main->pktmbuf_pools,
+			     "mbuf_pool", num_mbufs, 512, VLIB_BUFFER_DATA_SIZE,
+			     socket_id);
+}
+
+/*
+ * Give a free list a private mempool on a socket: its buffers no longer
+ * come from the shared pools, so the free list is bounded by num_mbufs
+ * per socket and can never exhaust the buffers of the other free lists.
+ * Must be called before the worker threads are started.
+ */
+clib_error_t *
+vlib_buffer_free_list_pool_create (vlib_main_t * vm, u32 free_list_index,
+				   unsigned num_mbufs, unsigned socket_id)
+{
+  vlib_buffer_free_list_t *fl;
+  clib_error_t *error;
+  u8 *prefix;
+
+  fl = vlib_buffer_get_free_list (vm, free_list_index);
+  prefix = format (0, "fl%u_pool%c", free_list_index, 0);
+
+  error = buffer_pool_create (vm, &fl->pktmbuf_pools, (char *) prefix,
+			      num_mbufs, clib_min (512, num_mbufs / 8),
+			      VLIB_BUFFER_DATA_SIZE, socket_id);
+  vec_free (prefix);
+  return error;
+}
+
+/*
+ * Create the jumbo buffer pool of a socket, holding a 9K frame per
+ * buffer. Jumbo buffers are not on any free list, they are taken from
+ * the pool directly, e.g. to linearize chained packets.
+ */
+clib_error_t *
+vlib_buffer_jumbo_pool_create (vlib_main_t * vm, unsigned num_mbufs,
+			       unsigned socket_id)
+{
+  return buffer_pool_create (vm, &vm->buffer_main->jumbo_pktmbuf_pools,
+			     "jumbo_pool", num_mbufs,
+			     clib_min (512, num_mbufs / 8),
+			     VLIB_BUFFER_JUMBO_DATA_SIZE, socket_id);
+}
+
 
 static void
 vlib_serialize_tx (serialize_main_header_t * m, serialize_stream_t * s)
@@ -67,6 +67,10 @@
 #define LOG2_BUFFER_HANDOFF_NEXT_VALID LOG2_VLIB_BUFFER_FLAG_USER(6)
 #define BUFFER_HANDOFF_NEXT_VALID (1 << LOG2_BUFFER_HANDOFF_NEXT_VALID)
 
+/* vnet_buffer2 (b)->l2_hdr_offset was set on input */
+#define LOG2_BUFFER_L2_HDR_OFFSET_VALID LOG2_VLIB_BUFFER_FLAG_USER(7)
+#define BUFFER_L2_HDR_OFFSET_VALID (1 << LOG2_BUFFER_L2_HDR_OFFSET_VALID)
+
 #define foreach_buffer_opaque_union_subtype     \
 _(ethernet)                                     \
 _(ip)                                           \
@@ -319,6 +323,14 @@ typedef struct
       u16 overlay_afi;
     } lisp;
 
+    /* SPAN mirrors, only valid on mirror buffers */
+    struct
+    {
+      u32 pad[4];		/* do not overlay w/ ip.adj_index[0,1] */
+      u32 orig_length;		/* length of the mirrored packet */
+      u16 frame_offset;		/* metadata bytes in front of the frame */
+    } span;
+
     u32 unused[6];
   };
 } vnet_buffer_opaque_t;
@@ -328,11 +340,16 @@ typedef struct
 /* Full cache line (64 bytes) of additional space */
 typedef struct
 {
+  /* Start of the L2 header in data[], kept when the packet moves on */
+  i16 l2_hdr_offset;
+
   union
   {
   };
 } vnet_buffer_opaque2_t;
 
+#define vnet_buffer2(b) ((vnet_buffer_opaque2_t *) vlib_get_buffer_opaque2 (b))
+
 
 
 #endif /* included_vnet_buffer_h */
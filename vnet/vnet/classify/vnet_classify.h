@@ -296,9 +296,9 @@ vnet_classify_entry_at_index (vnet_classify_table_t * t,
   return (vnet_classify_entry_t *) eu8;
 }
 
-static inline void
-vnet_classify_prefetch_entry (vnet_classify_table_t * t, 
-                              u64 hash)
+/* First entry of the page of a hash, 0 if its bucket is empty */
+static inline vnet_classify_entry_t *
+vnet_classify_get_page (vnet_classify_table_t * t, u64 hash)
 {
   u32 bucket_index;
   u32 value_index;
@@ -310,50 +310,47 @@ vnet_classify_prefetch_entry (vnet_classify_table_t * t,
   b = &t->buckets[bucket_index];
   
   if (b->offset == 0)
-    return;
+    return 0;
 
   hash >>= t->log2_nbuckets;
 
   e = vnet_classify_get_entry (t, b->offset);
   value_index = hash & ((1<<b->log2_pages)-1);
 
-  e = vnet_classify_entry_at_index (t, e, value_index);
+  return vnet_classify_entry_at_index (t, e, value_index);
+}
+
+static inline void
+vnet_classify_prefetch_entry (vnet_classify_table_t * t, 
+                              u64 hash)
+{
+  vnet_classify_entry_t * e;
+
+  e = vnet_classify_get_page (t, hash);
 
-  CLIB_PREFETCH(e, CLIB_CACHE_LINE_BYTES, LOAD);
+  if (e)
+    CLIB_PREFETCH(e, CLIB_CACHE_LINE_BYTES, LOAD);
 }
 
 vnet_classify_entry_t *
 vnet_classify_find_entry (vnet_classify_table_t * t,
                           u8 * h, u64 hash, f64 now);
 
+/* Compares a packet with the entries of the page starting at v */
 static inline vnet_classify_entry_t *
-vnet_classify_find_entry_inline (vnet_classify_table_t * t,
-                                 u8 * h, u64 hash, f64 now)
+vnet_classify_find_entry_in_page_inline (vnet_classify_table_t * t,
+                                         vnet_classify_entry_t * v,
+                                         u8 * h, f64 now)
   {
-  vnet_classify_entry_t * v;
   u32x4 *mask, *key;
   union {
     u32x4 as_u32x4;
     u64 as_u64[2];
   } result __attribute__((aligned(sizeof(u32x4))));
-  vnet_classify_bucket_t * b;
-  u32 value_index;
-  u32 bucket_index;
   int i;
 
-  bucket_index = hash & (t->nbuckets-1);
-  b = &t->buckets[bucket_index];
   mask = t->mask;
 
-  if (b->offset == 0)
-    return 0;
-
-  hash >>= t->log2_nbuckets;
-
-  v = vnet_classify_get_entry (t, b->offset);
-  value_index = hash & ((1<<b->log2_pages)-1);
-  v = vnet_classify_entry_at_index (t, v, value_index);
-
 #ifdef CLASSIFY_USE_SSE
   if (U32X4_ALIGNED(h)) {
     u32x4 *data = (u32x4 *) h;
@@ -437,6 +434,190 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
   return 0;
   }
 
+static inline vnet_classify_entry_t *
+vnet_classify_find_entry_inline (vnet_classify_table_t * t,
+                                 u8 * h, u64 hash, f64 now)
+{
+  vnet_classify_entry_t * v;
+
+  v = vnet_classify_get_page (t, hash);
+
+  if (v == 0)
+    return 0;
+
+  return vnet_classify_find_entry_in_page_inline (t, v, h, now);
+}
+
+/*
+ * Batch lookups of a frame of packets: packet i is h[i], classified in
+ * table t[i], or not at all when t[i] is 0.
+ */
+
+#ifdef CLASSIFY_USE_SSE
+/*
+ * Hashes two packets in tables of the same match_n_vectors, masking and
+ * xoring both keys in the two halves of a u32x8: one AVX2 operation per
+ * vector in the avx2 variants of the node functions.
+ */
+static inline void
+vnet_classify_hash_two_packets_inline (vnet_classify_table_t * t0,
+                                       vnet_classify_table_t * t1,
+                                       u8 * h0, u8 * h1,
+                                       u64 * hash0, u64 * hash1)
+{
+  u32x4 *data0 = (u32x4 *) h0 + t0->skip_n_vectors;
+  u32x4 *data1 = (u32x4 *) h1 + t1->skip_n_vectors;
+  union {
+    u32x8 as_u32x8;
+    u32x4 as_u32x4[2];
+    u64 as_u64[4];
+  } data, mask, xor_sum;
+  u32 i;
+
+  ASSERT (t0->match_n_vectors == t1->match_n_vectors);
+  ASSERT (t0->match_n_vectors >= 1 && t0->match_n_vectors <= 5);
+
+  xor_sum.as_u32x8 = (u32x8) { 0 };
+  for (i = 0; i < t0->match_n_vectors; i++)
+    {
+      /* Packets are not necessarily 16 byte aligned */
+      data.as_u32x4[0] = clib_mem_unaligned (data0 + i, u32x4);
+      data.as_u32x4[1] = clib_mem_unaligned (data1 + i, u32x4);
+      mask.as_u32x4[0] = t0->mask[i];
+      mask.as_u32x4[1] = t1->mask[i];
+      xor_sum.as_u32x8 ^= data.as_u32x8 & mask.as_u32x8;
+    }
+
+  *hash0 = clib_xxhash (xor_sum.as_u64[0] ^ xor_sum.as_u64[1]);
+  *hash1 = clib_xxhash (xor_sum.as_u64[2] ^ xor_sum.as_u64[3]);
+}
+#endif /* CLASSIFY_USE_SSE */
+
+/* Hashes n packets, and prefetches their buckets */
+static inline void
+vnet_classify_hash_packets_inline (vnet_classify_table_t ** t, u8 ** h,
+                                   u64 * hash, u32 n)
+{
+  u32 i = 0;
+
+#ifdef CLASSIFY_USE_SSE
+  for (; i + 1 < n; i += 2)
+    {
+      vnet_classify_table_t * t0 = t[i], * t1 = t[i + 1];
+
+      if (PREDICT_TRUE (t0 && t1
+                        && t0->match_n_vectors == t1->match_n_vectors))
+        {
+          vnet_classify_hash_two_packets_inline (t0, t1, h[i], h[i + 1],
+                                                 &hash[i], &hash[i + 1]);
+          vnet_classify_prefetch_bucket (t0, hash[i]);
+          vnet_classify_prefetch_bucket (t1, hash[i + 1]);
+          continue;
+        }
+
+      hash[i] = 0;
+      if (t0)
+        {
+          hash[i] = vnet_classify_hash_packet_inline (t0, h[i]);
+          vnet_classify_prefetch_bucket (t0, hash[i]);
+        }
+      hash[i + 1] = 0;
+      if (t1)
+        {
+          hash[i + 1] = vnet_classify_hash_packet_inline (t1, h[i + 1]);
+          vnet_classify_prefetch_bucket (t1, hash[i + 1]);
+        }
+    }
+#endif /* CLASSIFY_USE_SSE */
+
+  for (; i < n; i++)
+    {
+      hash[i] = 0;
+      if (t[i])
+        {
+          hash[i] = vnet_classify_hash_packet_inline (t[i], h[i]);
+          vnet_classify_prefetch_bucket (t[i], hash[i]);
+        }
+    }
+}
+
+/*
+ * Looks up n hashed packets, e[i] is 0 on a miss. The pages of all the
+ * packets are found and prefetched before the first key compare.
+ */
+static inline void
+vnet_classify_find_entries_inline (vnet_classify_table_t ** t, u8 ** h,
+                                   u64 * hash, vnet_classify_entry_t ** e,
+                                   u32 n, f64 now)
+{
+  u32 i;
+
+  for (i = 0; i < n; i++)
+    {
+      e[i] = t[i] ? vnet_classify_get_page (t[i], hash[i]) : 0;
+      if (e[i])
+        CLIB_PREFETCH (e[i], sizeof (vnet_classify_entry_t)
+                       + t[i]->match_n_vectors * sizeof (u32x4), LOAD);
+    }
+
+  for (i = 0; i < n; i++)
+    if (e[i])
+      e[i] = vnet_classify_find_entry_in_page_inline (t[i], e[i], h[i], now);
+}
+
+/*
+ * Continues the lookups that missed in the next tables of their chains,
+ * one batch per chain level. On return t[i] is the table of the hit, or
+ * the last table of the chain on a miss.
+ */
+static inline void
+vnet_classify_find_chain_entries_inline (vnet_classify_main_t * cm,
+                                         vnet_classify_table_t ** t,
+                                         u8 ** h,
+                                         vnet_classify_entry_t ** e,
+                                         u32 n, f64 now)
+{
+  vnet_classify_table_t * chain_t[VLIB_FRAME_SIZE];
+  u8 * chain_h[VLIB_FRAME_SIZE];
+  u64 chain_hash[VLIB_FRAME_SIZE];
+  vnet_classify_entry_t * chain_e[VLIB_FRAME_SIZE];
+  u32 chain_i[VLIB_FRAME_SIZE];
+  u32 i, j, n_chain, n_next;
+
+  ASSERT (n <= VLIB_FRAME_SIZE);
+
+  n_chain = 0;
+  for (i = 0; i < n; i++)
+    if (t[i] && e[i] == 0 && t[i]->next_table_index != ~0)
+      chain_i[n_chain++] = i;
+
+  while (n_chain > 0)
+    {
+      for (j = 0; j < n_chain; j++)
+        {
+          i = chain_i[j];
+          t[i] = chain_t[j] = pool_elt_at_index (cm->tables,
+                                                 t[i]->next_table_index);
+          chain_h[j] = h[i];
+        }
+
+      vnet_classify_hash_packets_inline (chain_t, chain_h, chain_hash,
+                                         n_chain);
+      vnet_classify_find_entries_inline (chain_t, chain_h, chain_hash,
+                                         chain_e, n_chain, now);
+
+      n_next = 0;
+      for (j = 0; j < n_chain; j++)
+        {
+          i = chain_i[j];
+          e[i] = chain_e[j];
+          if (e[i] == 0 && t[i]->next_table_index != ~0)
+            chain_i[n_next++] = i;
+        }
+      n_chain = n_next;
+    }
+}
+
 vnet_classify_table_t * 
 vnet_classify_new_table (vnet_classify_main_t *cm,
                          u8 * mask, u32 nbuckets, u32 memory_size,
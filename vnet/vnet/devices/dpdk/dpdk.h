@@ -313,6 +313,9 @@ typedef struct
 
   /* total input packet counter */
   u64 aggregate_rx_packets;
+
+  /* vector of SPAN mirrored buffers of the current rx burst */
+  u32 *span_buffers;
 } dpdk_worker_t;
 
 typedef struct
@@ -422,6 +425,7 @@ typedef struct
   u32 coremask;
   u32 nchannels;
   u32 num_mbufs;
+  u32 num_jumbo_mbufs;		/* per socket, 0 = no jumbo pools */
   u8 num_kni;			/* while kni_init allows u32, port_id in callback fn is only u8 */
 
   /*
@@ -1141,6 +1141,9 @@ dpdk_config (vlib_main_t * vm, unformat_input_t * input)
 	}
       else if (unformat (input, "num-mbufs %d", &conf->num_mbufs))
 	;
+      else if (unformat (input, "num-jumbo-mbufs %d",
+			 &conf->num_jumbo_mbufs))
+	;
       else if (unformat (input, "kni %d", &conf->num_kni))
 	;
       else if (unformat (input, "uio-driver %s", &conf->uio_driver_name))
@@ -1491,6 +1494,17 @@ dpdk_config (vlib_main_t * vm, unformat_input_t * input)
 	return error;
     }
 
+  /* jumbo pools, only on the sockets the shared pools were created on */
+  if (conf->num_jumbo_mbufs)
+    for (i = 0; i < vec_len (vm->buffer_main->pktmbuf_pools); i++)
+      if (vm->buffer_main->pktmbuf_pools[i])
+	{
+	  error = vlib_buffer_jumbo_pool_create (vm, conf->num_jumbo_mbufs,
+						 i);
+	  if (error)
+	    return error;
+	}
+
 done:
   return error;
 }
@@ -405,14 +405,16 @@ dpdk_device_input (dpdk_main_t * dm,
   vlib_buffer_free_list_t *fl;
   u8 efd_discard_burst = 0;
   u32 buffer_flags_template;
+  u32 save_l2_hdr_offset;
   vnet_main_t *vnm = vnet_get_main ();
-  u32 n_span_buffers;
+  dpdk_worker_t *dw = vec_elt_at_index (dm->workers, cpu_index);
+  span_session_t *span = 0;
+  span_per_thread_data_t *span_ptd = 0;
 
   if ((xd->flags & DPDK_DEVICE_FLAG_ADMIN_UP) == 0)
     return 0;
 
-  n_span_buffers =
-          n_buffers = dpdk_rx_burst (dm, xd, queue_id);
+  n_buffers = dpdk_rx_burst (dm, xd, queue_id);
 
   if (n_buffers == 0)
     {
@@ -428,11 +430,38 @@ dpdk_device_input (dpdk_main_t * dm,
 
   buffer_flags_template = dm->buffer_flags_template;
 
+  /* only the mirrors of dropped packets need it */
+  save_l2_hdr_offset = span_main.drop_session_index != ~0;
+
   vec_reset_length (xd->d_trace_buffers);
   trace_cnt = n_trace = vlib_get_trace_count (vm, node);
 
   fl = vlib_buffer_get_free_list (vm, VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
 
+  /* SPAN: mirror this burst to all destinations of the session */
+  if (PREDICT_FALSE (xd->flags & DPDK_DEVICE_FLAG_SPAN))
+    {
+      span = get_span_entry (xd->vlib_sw_if_index);
+      vec_reset_length (dw->span_buffers);
+
+      /*
+       * filter and sample the whole burst up front, only selected
+       * packets are mirrored
+       */
+      if (span != 0 && span_session_selects (span))
+	{
+	  span_ptd = vec_elt_at_index (span_main.per_thread_data, cpu_index);
+	  vec_validate (span_ptd->headers, n_buffers - 1);
+	  vec_validate (span_ptd->hashes, n_buffers - 1);
+	  vec_validate (span_ptd->match, n_buffers - 1);
+	  for (mb_index = 0; mb_index < n_buffers; mb_index++)
+	    span_ptd->headers[mb_index] =
+	      rte_pktmbuf_mtod (xd->rx_vectors[queue_id][mb_index], u8 *);
+	  span_select_packets (span, span_ptd, span_ptd->headers, n_buffers,
+			       vlib_time_now (vm));
+	}
+    }
+
   /* Check for congestion if EFD (Early-Fast-Discard) is enabled
    * in any mode (e.g. dpdk, monitor, or drop_all)
    */
@@ -564,6 +593,14 @@ dpdk_device_input (dpdk_main_t * dm,
 
 	  b0->flags = buffer_flags_template;
 
+	  /* ip4/ip6/mpls frames skip ethernet-input, which saves it too */
+	  if (PREDICT_FALSE (save_l2_hdr_offset))
+	    {
+	      b0->flags |= BUFFER_L2_HDR_OFFSET_VALID;
+	      vnet_buffer2 (b0)->l2_hdr_offset =
+		b0->current_data - l3_offset0;
+	    }
+
 	  if (VMWARE_LENGTH_BUG_WORKAROUND)
 	    b0->current_length -= 4;
 
@@ -600,6 +637,23 @@ dpdk_device_input (dpdk_main_t * dm,
 	      nb_seg++;
 	    }
 
+	  /*
+	   * SPAN: mirror the whole frame, starting at the ethernet header.
+	   * In clone mode the packet is re-headed, so fix up the speculative
+	   * enqueue with the new head buffer index.
+	   */
+	  if (PREDICT_FALSE (span != 0)
+	      && (span_ptd == 0
+		  || span_ptd->match[mb_index] == SPAN_SELECT_HIT))
+	    {
+	      vlib_buffer_advance (b0, -(word) l3_offset0);
+	      span_duplicate_buffer (vm, &bi0, span, SPAN_DIRECTION_RX,
+				     &dw->span_buffers);
+	      b0 = vlib_get_buffer (vm, bi0);
+	      vlib_buffer_advance (b0, l3_offset0);
+	      to_next[-1] = bi0;
+	    }
+
 	  /*
 	   * Turn this on if you run into
 	   * "bad monkey" contexts, and you want to know exactly
@@ -626,65 +680,19 @@ dpdk_device_input (dpdk_main_t * dm,
 			    n_trace - vec_len (xd->d_trace_buffers));
     }
 
-  // SPAN cloning
-  if (PREDICT_FALSE ((xd->flags & DPDK_DEVICE_FLAG_SPAN) &&
-          (xd->vlib_span_next_sw_if_index != ~0)))
-  {
-        vnet_sw_interface_t *sw_if = vnet_get_sw_interface (vnm, xd->vlib_span_next_sw_if_index);
-
-        if (PREDICT_TRUE ((sw_if != 0) &&
-                (sw_if->flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)))
-        {
-            vlib_trace_next_frame (vm, node, DPDK_RX_NEXT_SPAN_OUTPUT);
-
-            mb_index = 0;
-            while (n_span_buffers > 0)
-              {
-                vlib_buffer_t *b0;
-
-                vlib_get_next_frame (vm, node, DPDK_RX_NEXT_SPAN_OUTPUT, to_next, n_left_to_next);
-
-                while (n_span_buffers > 0 && n_left_to_next > 0)
-              {
-                struct rte_mbuf *mb = xd->rx_vectors[queue_id][mb_index];
-
-                if (PREDICT_TRUE (n_span_buffers > 2))
-                  {
-                    struct rte_mbuf *pfmb = xd->rx_vectors[queue_id][mb_index + 2];
-                    vlib_buffer_t *bp = vlib_buffer_from_rte_mbuf (pfmb);
-                    CLIB_PREFETCH (pfmb, CLIB_CACHE_LINE_BYTES, STORE);
-                    CLIB_PREFETCH (bp, CLIB_CACHE_LINE_BYTES, STORE);
-                  }
-
-                ASSERT (mb);
-
-                b0 = vlib_buffer_from_rte_mbuf (mb);
-
-                vlib_buffer_t *c0 = span_duplicate_buffer (vm, b0, xd->vlib_span_next_sw_if_index, 1);
-                if (c0 != 0)
-                   {
-                       u32 ci0 = vlib_get_buffer_index (vm, c0);
-
-                       to_next[0] = ci0;
-                       to_next++;
-                       n_left_to_next--;
-                   } else {
-                       clib_error ("span_duplicate_buffer failed");
-                   }
-
-                   n_span_buffers--;
-                   mb_index++;
-              }
-
-              vlib_put_next_frame (vm, node, DPDK_RX_NEXT_SPAN_OUTPUT, n_left_to_next);
-              }
-
-            // span per interface counter
-            vlib_increment_simple_counter
-                (vnm->interface_main.sw_if_counters
-                        + VNET_INTERFACE_COUNTER_SPAN,
-                        cpu_index, xd->vlib_sw_if_index, mb_index);
-        }
+  /* SPAN: hand the mirrored copies to interface-output */
+  if (PREDICT_FALSE (span != 0 && vec_len (dw->span_buffers) > 0))
+    {
+      vlib_trace_next_frame (vm, node, DPDK_RX_NEXT_SPAN_OUTPUT);
+      vlib_buffer_enqueue_to_single_next (vm, node, dw->span_buffers,
+					  DPDK_RX_NEXT_SPAN_OUTPUT,
+					  vec_len (dw->span_buffers));
+
+      /* span per interface counter */
+      vlib_increment_simple_counter
+	(vnm->interface_main.sw_if_counters
+	 + VNET_INTERFACE_COUNTER_SPAN,
+	 cpu_index, xd->vlib_sw_if_index, vec_len (dw->span_buffers));
     }
 
   vlib_increment_combined_counter
@@ -692,7 +700,6 @@ dpdk_device_input (dpdk_main_t * dm,
      + VNET_INTERFACE_COUNTER_RX,
      cpu_index, xd->vlib_sw_if_index, mb_index, n_rx_bytes);
 
-  dpdk_worker_t *dw = vec_elt_at_index (dm->workers, cpu_index);
   dw->aggregate_rx_packets += mb_index;
 
   return mb_index;
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/vnet.h>
+#include <vnet/devices/dpdk/dpdk.h>
+#include <vnet/dpdk_replication.h>
+
+/*
+ * vlib_dpdk_clone_buffer_to_pool unit tests: chains of 1 to n segments,
+ * of several segment sizes, are cloned into the shared pool and into the
+ * jumbo pool, if any, and the clones are checked byte by byte.
+ */
+
+#define CLONE_TEST_MAX_SEGS 64
+
+#define CLONE_TEST(_cond, _comment, _args...)				\
+  if (!(_cond))								\
+    return clib_error_return (0, "FAIL:%d: " _comment, __LINE__, ##_args);
+
+/* Byte k of a test packet of n_segs segments */
+always_inline u8
+clone_test_byte (u32 k, u32 n_segs)
+{
+  return k * 7 + n_segs;
+}
+
+/*
+ * Build a chain of n_segs buffers, not chained at the rte_mbuf level,
+ * segment i holding 1 to VLIB_BUFFER_DATA_SIZE bytes depending on
+ * seg_len and i. Returns the packet length, 0 if buffers ran out.
+ */
+static u32
+clone_test_chain (vlib_main_t * vm, u32 * bi, u32 n_segs, u32 seg_len)
+{
+  vlib_buffer_t *b, *p = 0;
+  u32 i, j, len = 0;
+  u8 *data;
+
+  if (vlib_buffer_alloc (vm, bi, n_segs) != n_segs)
+    {
+      vlib_buffer_free_no_next (vm, bi, n_segs);
+      return 0;
+    }
+
+  for (i = 0; i < n_segs; i++)
+    {
+      b = vlib_get_buffer (vm, bi[i]);
+      b->current_data = 0;
+      b->current_length = 1 + (seg_len + 97 * i) % VLIB_BUFFER_DATA_SIZE;
+      b->flags = 0;
+      data = vlib_buffer_get_current (b);
+      for (j = 0; j < b->current_length; j++)
+	data[j] = clone_test_byte (len + j, n_segs);
+      len += b->current_length;
+      if (p)
+	{
+	  p->flags |= VLIB_BUFFER_NEXT_PRESENT;
+	  p->next_buffer = bi[i];
+	}
+      p = b;
+    }
+
+  b = vlib_get_buffer (vm, bi[0]);
+  b->total_length_not_including_first_buffer = len - b->current_length;
+  b->flags |= VLIB_BUFFER_TOTAL_LENGTH_VALID;
+  vnet_buffer (b)->sw_if_index[VLIB_RX] = n_segs;
+
+  return len;
+}
+
+/* Check clone c of a len bytes, n_segs segments packet */
+static clib_error_t *
+clone_test_check (vlib_main_t * vm, vlib_buffer_t * c, u32 len, u32 n_segs,
+		  u32 room)
+{
+  struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (c);
+  struct rte_mbuf *first = mb;
+  u32 n_buffers = 0, k = 0, j;
+  u8 *data;
+
+  CLONE_TEST (vlib_buffer_length_in_chain (vm, c) == len,
+	      "%u segments: clone length %u, expected %u", n_segs,
+	      vlib_buffer_length_in_chain (vm, c), len);
+  CLONE_TEST (first->pkt_len == len, "%u segments: pkt_len %u", n_segs,
+	      first->pkt_len);
+  CLONE_TEST (vnet_buffer (c)->sw_if_index[VLIB_RX] == n_segs,
+	      "%u segments: opaque not copied", n_segs);
+
+  while (1)
+    {
+      n_buffers++;
+      CLONE_TEST (mb == rte_mbuf_from_vlib_buffer (c),
+		  "%u segments: rte_mbuf chain differs at buffer %u", n_segs,
+		  n_buffers);
+      CLONE_TEST (mb->data_len == c->current_length
+		  && mb->data_off ==
+		  VLIB_BUFFER_PRE_DATA_SIZE + c->current_data
+		  && rte_mbuf_refcnt_read (mb) == 1,
+		  "%u segments: rte_mbuf %u out of sync", n_segs, n_buffers);
+      data = vlib_buffer_get_current (c);
+      for (j = 0; j < c->current_length; j++, k++)
+	CLONE_TEST (data[j] == clone_test_byte (k, n_segs),
+		    "%u segments: byte %u differs", n_segs, k);
+
+      mb = mb->next;
+      if (!(c->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      /* all but the last buffer are full */
+      CLONE_TEST (c->current_data + c->current_length == room,
+		  "%u segments: buffer %u not full", n_segs, n_buffers);
+      c = vlib_get_buffer (vm, c->next_buffer);
+    }
+
+  CLONE_TEST (mb == 0, "%u segments: rte_mbuf chain too long", n_segs);
+  CLONE_TEST (n_buffers == (len + room - 1) / room
+	      && first->nb_segs == n_buffers,
+	      "%u segments: %u buffers, nb_segs %u, expected %u", n_segs,
+	      n_buffers, first->nb_segs, (len + room - 1) / room);
+
+  return 0;
+}
+
+static clib_error_t *
+clone_test_pool (vlib_main_t * vm, struct rte_mempool *rmp, u32 max_segs)
+{
+  u32 room = rte_pktmbuf_data_room_size (rmp) - VLIB_BUFFER_PRE_DATA_SIZE;
+  u32 seg_lens[] = { 64, 1500, VLIB_BUFFER_DATA_SIZE - 1 };
+  u32 bi[CLONE_TEST_MAX_SEGS], ci;
+  u32 n_segs, s, len, n_clones = 0;
+  clib_error_t *error;
+  vlib_buffer_t *c;
+
+  for (n_segs = 1; n_segs <= max_segs; n_segs++)
+    for (s = 0; s < ARRAY_LEN (seg_lens); s++)
+      {
+	len = clone_test_chain (vm, bi, n_segs, seg_lens[s]);
+	if (len == 0)
+	  return clib_error_return (0, "out of buffers");
+
+	c = vlib_dpdk_clone_buffer_to_pool (vm, vlib_get_buffer (vm, bi[0]),
+					    rmp);
+	vlib_buffer_free_no_next (vm, bi, n_segs);
+	CLONE_TEST (c != 0, "%u segments of %u bytes: clone failed", n_segs,
+		    seg_lens[s]);
+
+	error = clone_test_check (vm, c, len, n_segs, room);
+	ci = vlib_get_buffer_index (vm, c);
+	vlib_buffer_free (vm, &ci, 1);
+	if (error)
+	  return error;
+	n_clones++;
+      }
+
+  vlib_cli_output (vm, "%s: %u clones of 1 to %u segments PASS",
+		   rmp->name, n_clones, max_segs);
+  return 0;
+}
+
+static clib_error_t *
+test_dpdk_clone (vlib_main_t * vm, unformat_input_t * input,
+		 vlib_cli_command_t * cmd)
+{
+  vlib_buffer_main_t *bm = vm->buffer_main;
+  unsigned socket_id = rte_socket_id ();
+  u32 max_segs = 32;
+  clib_error_t *error;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "segments %u", &max_segs))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  if (max_segs == 0 || max_segs > CLONE_TEST_MAX_SEGS)
+    return clib_error_return (0, "segments must be 1 to %u",
+			      CLONE_TEST_MAX_SEGS);
+
+  error = clone_test_pool (vm, bm->pktmbuf_pools[socket_id], max_segs);
+  if (error)
+    return error;
+
+  if (socket_id < vec_len (bm->jumbo_pktmbuf_pools)
+      && bm->jumbo_pktmbuf_pools[socket_id])
+    error = clone_test_pool (vm, bm->jumbo_pktmbuf_pools[socket_id],
+			     max_segs);
+  else
+    vlib_cli_output (vm, "no jumbo pool, linearization not tested");
+
+  return error;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_test_dpdk_clone,static) = {
+    .path = "test dpdk clone",
+    .short_help = "test dpdk clone [segments <n>]",
+    .function = test_dpdk_clone,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -1021,7 +1021,7 @@ vhost_user_if_input (vlib_main_t * vm,
   uword n_left;
   u32 n_left_to_next, *to_next;
   u32 next_index = 0;
-  u32 next0;
+  u32 next0, next_input = VHOST_USER_RX_NEXT_ETHERNET_INPUT;
   uword n_trace = vlib_get_trace_count (vm, node);
   u16 qsz_mask;
   u32 cpu_index, rx_len, drops, flush;
@@ -1036,6 +1036,9 @@ vhost_user_if_input (vlib_main_t * vm,
   if (PREDICT_FALSE (!txvq->desc || !txvq->avail || !txvq->enabled))
     return 0;
 
+  if (PREDICT_FALSE (vui->per_interface_next_index != ~0))
+    next_input = vui->per_interface_next_index;
+
   /* do we have pending intterupts ? */
   if ((txvq->n_since_last_int) && (txvq->int_deadline < now))
     vhost_user_send_call (vm, txvq);
@@ -1283,7 +1286,7 @@ vhost_user_if_input (vlib_main_t * vm,
 		b_head->current_length +
 		b_head->total_length_not_including_first_buffer;
 	      n_rx_packets++;
-	      next0 = VHOST_USER_RX_NEXT_ETHERNET_INPUT;
+	      next0 = next_input;
 	    }
 
 	  to_next[0] = bi_head;
@@ -1702,6 +1705,27 @@ vhost_user_interface_admin_up_down (vnet_main_t * vnm, u32 hw_if_index,
   return /* no error */ 0;
 }
 
+static void
+vhost_user_set_interface_next_node (vnet_main_t * vnm, u32 hw_if_index,
+				    u32 node_index)
+{
+  vhost_user_main_t *vum = &vhost_user_main;
+  vnet_hw_interface_t *hw = vnet_get_hw_interface (vnm, hw_if_index);
+  vhost_user_intf_t *vui =
+    vec_elt_at_index (vum->vhost_user_interfaces, hw->dev_instance);
+
+  /* Shut off redirection */
+  if (node_index == ~0)
+    {
+      vui->per_interface_next_index = node_index;
+      return;
+    }
+
+  vui->per_interface_next_index =
+    vlib_node_add_next (vlib_get_main (), vhost_user_input_node.index,
+			node_index);
+}
+
 /* *INDENT-OFF* */
 VNET_DEVICE_CLASS (vhost_user_dev_class,static) = {
   .name = "vhost-user",
@@ -1711,6 +1735,7 @@ VNET_DEVICE_CLASS (vhost_user_dev_class,static) = {
   .format_device_name = format_vhost_user_interface_name,
   .name_renumber = vhost_user_name_renumber,
   .admin_up_down_function = vhost_user_interface_admin_up_down,
+  .rx_redirect_to_node = vhost_user_set_interface_next_node,
   .no_flatten_output_chains = 1,
 };
 
@@ -1977,6 +2002,7 @@ vhost_user_vui_init (vnet_main_t * vnm,
   vui->active = 1;
   vui->unix_file_index = ~0;
   vui->log_base_addr = 0;
+  vui->per_interface_next_index = ~0;
 
   for (q = 0; q < 2; q++)
     {
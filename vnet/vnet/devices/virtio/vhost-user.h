@@ -224,6 +224,7 @@ typedef struct
   u8 sock_is_server;
   u32 hw_if_index, sw_if_index;
   u8 active;
+  u32 per_interface_next_index;
 
   u32 nregions;
   u64 features;
@@ -2,108 +2,179 @@
 #define __included_dpdk_replication_h__
 #include <vnet/devices/dpdk/dpdk.h>
 
+/* Buffers of a clone, bounded by the u8 rte_mbuf nb_segs */
+#define VLIB_DPDK_CLONE_MAX_SEGS 255
+
 /*
- * vlib_dpdk_clone_buffer - clone a buffer
- * for port mirroring, lawful intercept, etc.
+ * vlib_dpdk_clone_buffer_to_pool - clone a buffer chain into buffers
+ * of mempool rmp, for port mirroring, lawful intercept, etc.
  * rte_pktmbuf_clone (...) requires that the forwarding path
  * not touch any of the cloned data. The hope is that we'll
  * figure out how to relax that restriction.
  *
- * For the moment, copy packet data.
+ * For the moment, copy packet data. The copy is repacked: its buffers
+ * are filled up to the data room of the pool, so the number of buffers
+ * follows from the packet length and all of them are taken with a single
+ * bulk get, whatever the number of source segments. A pool of jumbo
+ * buffers linearizes a packet of up to 9K into a single buffer.
+ * Source segment data is prefetched one segment ahead of the copy,
+ * segment headers two segments ahead.
  */
 
 static inline vlib_buffer_t *
-vlib_dpdk_clone_buffer (vlib_main_t * vm, vlib_buffer_t * b)
+vlib_dpdk_clone_buffer_to_pool (vlib_main_t * vm, vlib_buffer_t * b,
+				struct rte_mempool *rmp)
 {
-  u32 new_buffers_needed = 1;
-  unsigned socket_id = rte_socket_id ();
-  struct rte_mempool *rmp = vm->buffer_main->pktmbuf_pools[socket_id];
-  struct rte_mbuf *rte_mbufs[5];
+  struct rte_mbuf *rte_mbufs[VLIB_DPDK_CLONE_MAX_SEGS];
   vlib_buffer_free_list_t *fl;
-  vlib_buffer_t *rv;
-  u8 *copy_src, *copy_dst;
-  vlib_buffer_t *src_buf, *dst_buf;
+  vlib_buffer_t *s = b, *d, *rv;
+  word room = rte_pktmbuf_data_room_size (rmp) - VLIB_BUFFER_PRE_DATA_SIZE;
+  word first_room = room - b->current_data;
+  u32 len = vlib_buffer_length_in_chain (vm, b);
+  u32 n_buffers = 1, i = 0;
+  word d_room;
+
+  if (len > first_room)
+    n_buffers += (len - first_room + room - 1) / room;
+
+  if (PREDICT_FALSE (n_buffers > ARRAY_LEN (rte_mbufs)))
+    return 0;
+
+  if (rte_mempool_get_bulk (rmp, (void **) rte_mbufs, n_buffers) < 0)
+    return 0;
 
   fl = vlib_buffer_get_free_list (vm, VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
 
-  if (PREDICT_FALSE (b->flags & VLIB_BUFFER_NEXT_PRESENT))
+  rv = d = vlib_buffer_from_rte_mbuf (rte_mbufs[0]);
+  vlib_buffer_init_for_free_list (d, fl);
+  d->current_data = b->current_data;
+  d->current_length = 0;
+  d_room = first_room;
+
+  if (b->flags & VLIB_BUFFER_NEXT_PRESENT)
+    vlib_prefetch_buffer_header (vlib_get_buffer (vm, b->next_buffer), LOAD);
+
+  while (1)
     {
-      vlib_buffer_t *tmp = b;
-      int i;
+      u8 *src = vlib_buffer_get_current (s);
+      word src_left = s->current_length;
 
-      while (tmp->flags & VLIB_BUFFER_NEXT_PRESENT)
+      if (s->flags & VLIB_BUFFER_NEXT_PRESENT)
 	{
-	  new_buffers_needed++;
-	  tmp = vlib_get_buffer (vm, tmp->next_buffer);
-	}
+	  vlib_buffer_t *n = vlib_get_buffer (vm, s->next_buffer);
 
-      /* Should never happen... */
-      if (PREDICT_FALSE (new_buffers_needed > ARRAY_LEN (rte_mbufs)))
-	{
-	  clib_warning ("need %d buffers", new_buffers_needed);
-	  return 0;
+	  CLIB_PREFETCH (vlib_buffer_get_current (n), CLIB_CACHE_LINE_BYTES,
+			 LOAD);
+	  if (n->flags & VLIB_BUFFER_NEXT_PRESENT)
+	    vlib_prefetch_buffer_header (vlib_get_buffer (vm, n->next_buffer),
+					 LOAD);
 	}
 
-      if (rte_mempool_get_bulk (rmp, (void **) rte_mbufs,
-				new_buffers_needed) < 0)
-	return 0;
-
-      src_buf = b;
-      rv = dst_buf = vlib_buffer_from_rte_mbuf (rte_mbufs[0]);
-      vlib_buffer_init_for_free_list (dst_buf, fl);
-      copy_src = b->data + src_buf->current_data;
-      copy_dst = dst_buf->data + src_buf->current_data;
-
-      for (i = 0; i < new_buffers_needed; i++)
+      while (src_left > 0)
 	{
-	  clib_memcpy (copy_src, copy_dst, src_buf->current_length);
-	  dst_buf->current_data = src_buf->current_data;
-	  dst_buf->current_length = src_buf->current_length;
-	  dst_buf->flags = src_buf->flags;
+	  word n_copy;
 
-	  if (i == 0)
+	  if (d->current_length == d_room)
 	    {
-	      dst_buf->total_length_not_including_first_buffer =
-		src_buf->total_length_not_including_first_buffer;
-	      vnet_buffer (dst_buf)->sw_if_index[VLIB_RX] =
-		vnet_buffer (src_buf)->sw_if_index[VLIB_RX];
-	      vnet_buffer (dst_buf)->sw_if_index[VLIB_TX] =
-		vnet_buffer (src_buf)->sw_if_index[VLIB_TX];
-	      vnet_buffer (dst_buf)->l2 = vnet_buffer (b)->l2;
+	      /* stale total length, more data than buffers */
+	      if (PREDICT_FALSE (i + 1 == n_buffers))
+		{
+		  rte_mempool_put_bulk (rmp, (void **) rte_mbufs, n_buffers);
+		  return 0;
+		}
+	      d->flags |= VLIB_BUFFER_NEXT_PRESENT;
+	      d = vlib_buffer_from_rte_mbuf (rte_mbufs[++i]);
+	      vlib_buffer_init_for_free_list (d, fl);
+	      d->current_data = 0;
+	      d->current_length = 0;
+	      d_room = room;
+	      if (i + 1 < n_buffers)
+		vlib_prefetch_buffer_header
+		  (vlib_buffer_from_rte_mbuf (rte_mbufs[i + 1]), STORE);
 	    }
 
-	  if (i < new_buffers_needed - 1)
-	    {
-	      src_buf = vlib_get_buffer (vm, src_buf->next_buffer);
-	      dst_buf = vlib_buffer_from_rte_mbuf (rte_mbufs[i + 1]);
-	      vlib_buffer_init_for_free_list (dst_buf, fl);
-	      copy_src = src_buf->data;
-	      copy_dst = dst_buf->data;
-	    }
+	  n_copy = clib_min (src_left, d_room - d->current_length);
+	  clib_memcpy (vlib_buffer_get_current (d) + d->current_length, src,
+		       n_copy);
+	  d->current_length += n_copy;
+	  src += n_copy;
+	  src_left -= n_copy;
 	}
-      return rv;
+
+      if (!(s->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      s = vlib_get_buffer (vm, s->next_buffer);
     }
 
-  if (rte_mempool_get_bulk (rmp, (void **) rte_mbufs, 1) < 0)
-    return 0;
+  /* stale total length, fewer buffers used than taken */
+  if (PREDICT_FALSE (i + 1 < n_buffers))
+    {
+      rte_mempool_put_bulk (rmp, (void **) rte_mbufs + i + 1,
+			    n_buffers - i - 1);
+      n_buffers = i + 1;
+    }
 
-  rte_pktmbuf_refcnt_update (rte_mbufs[0], 1);
-  rv = vlib_buffer_from_rte_mbuf (rte_mbufs[0]);
-  vlib_buffer_init_for_free_list (rv, fl);
+  for (i = 0; i < n_buffers; i++)
+    {
+      struct rte_mbuf *mb = rte_mbufs[i];
+
+      d = vlib_buffer_from_rte_mbuf (mb);
+      if (i + 1 < n_buffers)
+	d->next_buffer =
+	  vlib_get_buffer_index (vm,
+				 vlib_buffer_from_rte_mbuf (rte_mbufs[i + 1]));
+      rte_mbuf_refcnt_set (mb, 1);
+      mb->next = i + 1 < n_buffers ? rte_mbufs[i + 1] : 0;
+      mb->nb_segs = 1;
+      mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + d->current_data;
+      mb->data_len = d->current_length;
+      mb->pkt_len = d->current_length;
+    }
 
-  clib_memcpy (rv->data + b->current_data, b->data + b->current_data,
-	       b->current_length);
-  rv->current_data = b->current_data;
-  rv->current_length = b->current_length;
-  vnet_buffer (rv)->sw_if_index[VLIB_RX] =
-    vnet_buffer (b)->sw_if_index[VLIB_RX];
-  vnet_buffer (rv)->sw_if_index[VLIB_TX] =
-    vnet_buffer (b)->sw_if_index[VLIB_TX];
-  vnet_buffer (rv)->l2 = vnet_buffer (b)->l2;
+  rv->flags |= (b->flags & VLIB_BUFFER_CLONE_FLAGS_MASK
+		& ~VLIB_BUFFER_NEXT_PRESENT) | VLIB_BUFFER_TOTAL_LENGTH_VALID;
+  rv->total_length_not_including_first_buffer = len - rv->current_length;
+  rv->trace_index = b->trace_index;
+  clib_memcpy (rv->opaque, b->opaque, sizeof (b->opaque));
+  rte_mbufs[0]->nb_segs = n_buffers;
+  rte_mbufs[0]->pkt_len = len;
 
   return (rv);
 }
 
+/*
+ * vlib_dpdk_clone_buffer - clone a buffer chain into buffers of the
+ * shared pool of the current socket, 2K buffers filled to the brim
+ */
+static inline vlib_buffer_t *
+vlib_dpdk_clone_buffer (vlib_main_t * vm, vlib_buffer_t * b)
+{
+  unsigned socket_id = rte_socket_id ();
+
+  return vlib_dpdk_clone_buffer_to_pool
+    (vm, b, vm->buffer_main->pktmbuf_pools[socket_id]);
+}
+
+/*
+ * vlib_dpdk_clone_buffer_linearize - clone a buffer chain into the 9K
+ * buffers of the jumbo pool of the current socket, so that a packet of up
+ * to 9K becomes a single buffer. Without jumbo pools, see "num-jumbo-mbufs"
+ * in the dpdk startup config, same as vlib_dpdk_clone_buffer.
+ */
+static inline vlib_buffer_t *
+vlib_dpdk_clone_buffer_linearize (vlib_main_t * vm, vlib_buffer_t * b)
+{
+  vlib_buffer_main_t *bm = vm->buffer_main;
+  unsigned socket_id = rte_socket_id ();
+
+  if (socket_id < vec_len (bm->jumbo_pktmbuf_pools)
+      && bm->jumbo_pktmbuf_pools[socket_id])
+    return vlib_dpdk_clone_buffer_to_pool
+      (vm, b, bm->jumbo_pktmbuf_pools[socket_id]);
+
+  return vlib_dpdk_clone_buffer (vm, b);
+}
+
 
 #endif /* __included_dpdk_replication_h__ */
 
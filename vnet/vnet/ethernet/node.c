@@ -42,6 +42,7 @@
 #include <vnet/ethernet/ethernet.h>
 #include <vppinfra/sparse_vec.h>
 #include <vnet/l2/l2_bvi.h>
+#include <vnet/span/span.h>
 
 
 #define foreach_ethernet_input_next		\
@@ -103,6 +104,13 @@ parse_header (ethernet_input_variant_t variant,
 
       vnet_buffer (b0)->ethernet.start_of_ethernet_header = b0->current_data;
 
+      /* only the mirrors of dropped packets need it */
+      if (PREDICT_FALSE (span_main.drop_session_index != ~0))
+	{
+	  vnet_buffer2 (b0)->l2_hdr_offset = b0->current_data;
+	  b0->flags |= BUFFER_L2_HDR_OFFSET_VALID;
+	}
+
       vlib_buffer_advance (b0, sizeof (e0[0]));
 
       *type = clib_net_to_host_u16 (e0->type);
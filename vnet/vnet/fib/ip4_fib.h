@@ -61,6 +61,8 @@ extern void ip4_fib_table_fwding_dpo_remove(ip4_fib_t *fib,
 					    const ip4_address_t *addr,
 					    u32 len,
 					    const dpo_id_t *dpo);
+extern void ip4_fib_table_set_mtrie_stride(ip4_fib_t *fib,
+					   ip4_fib_mtrie_stride_t stride);
 extern u32 ip4_fib_table_lookup_lb (ip4_fib_t *fib,
 				    const ip4_address_t * dst);
 
@@ -239,6 +239,7 @@ ip6_fib_table_destroy (u32 fib_index)
     {
 	hash_unset (ip6_main.fib_index_by_table_id, fib_table->ft_table_id);
     }
+    ip6_fib_mtrie_free(&fib_table->v6.mtrie);
     pool_put(ip6_main.fibs, fib_table);
 }
 
@@ -394,11 +395,16 @@ ip6_fib_table_fwding_lookup (ip6_main_t * im,
                              const ip6_address_t * dst)
 {
     const ip6_fib_table_instance_t *table;
+    ip6_fib_mtrie_t *m;
     int i, len;
     int rv;
     BVT(clib_bihash_kv) kv, value;
     u64 fib;
 
+    m = &ip6_fib_get(fib_index)->mtrie;
+    if (ip6_fib_mtrie_is_enabled(m))
+	return (ip6_fib_mtrie_lookup(m, dst));
+
     table = &ip6_main.ip6_table[IP6_FIB_TABLE_FWDING];
     len = vec_len (table->prefix_lengths_in_search_order);
 
@@ -464,6 +470,7 @@ ip6_fib_table_fwding_dpo_update (u32 fib_index,
     ip6_fib_table_instance_t *table;
     BVT(clib_bihash_kv) kv;
     ip6_address_t *mask;
+    ip6_fib_mtrie_t *m;
     u64 fib;
 
     table = &ip6_main.ip6_table[IP6_FIB_TABLE_FWDING];
@@ -483,6 +490,60 @@ ip6_fib_table_fwding_dpo_update (u32 fib_index,
         clib_bitmap_set (table->non_empty_dst_address_length_bitmap, 
 			 128 - len, 1);
     compute_prefix_lengths_in_search_order (table);
+
+    m = &ip6_fib_get(fib_index)->mtrie;
+    if (ip6_fib_mtrie_is_enabled(m))
+	ip6_fib_mtrie_add_del_route(m, addr, len, dpo->dpoi_index, 0);
+}
+
+/*
+ * ip6_fib_table_mtrie_add_less_specific
+ *
+ * Once a route is deleted from the mtrie, add back the next less specific
+ * route of the forwarding table, which covered the deleted one.
+ */
+static void
+ip6_fib_table_mtrie_add_less_specific (u32 fib_index,
+				       ip6_fib_mtrie_t *m,
+				       const ip6_address_t *addr,
+				       u32 len)
+{
+    const ip6_fib_table_instance_t *table;
+    BVT(clib_bihash_kv) kv, value;
+    int i;
+    u64 fib;
+
+    table = &ip6_main.ip6_table[IP6_FIB_TABLE_FWDING];
+    fib = ((u64)((fib_index))<<32);
+
+    kv.key[0] = addr->as_u64[0];
+    kv.key[1] = addr->as_u64[1];
+
+    for (i = 0; i < vec_len (table->prefix_lengths_in_search_order); i++)
+    {
+	int dst_address_length = table->prefix_lengths_in_search_order[i];
+	ip6_address_t * mask = &ip6_main.fib_masks[dst_address_length];
+
+	if (dst_address_length >= len)
+	    continue;
+
+	kv.key[0] &= mask->as_u64[0];
+	kv.key[1] &= mask->as_u64[1];
+	kv.key[2] = fib | dst_address_length;
+
+	if (0 == BV(clib_bihash_search_inline_2)(&table->ip6_hash, &kv, &value))
+	{
+	    ip6_address_t key = {
+		.as_u64 = {
+		    [0] = kv.key[0],
+		    [1] = kv.key[1],
+		},
+	    };
+	    ip6_fib_mtrie_add_del_route(m, &key, dst_address_length,
+					value.value, 0);
+	    return;
+	}
+    }
 }
 
 void
@@ -494,6 +555,7 @@ ip6_fib_table_fwding_dpo_remove (u32 fib_index,
     ip6_fib_table_instance_t *table;
     BVT(clib_bihash_kv) kv;
     ip6_address_t *mask;
+    ip6_fib_mtrie_t *m;
     u64 fib;
 
     table = &ip6_main.ip6_table[IP6_FIB_TABLE_FWDING];
@@ -516,6 +578,74 @@ ip6_fib_table_fwding_dpo_remove (u32 fib_index,
                              128 - len, 0);
 	compute_prefix_lengths_in_search_order (table);
     }
+
+    m = &ip6_fib_get(fib_index)->mtrie;
+    if (ip6_fib_mtrie_is_enabled(m))
+    {
+	ip6_fib_mtrie_add_del_route(m, addr, len, dpo->dpoi_index, 1);
+	ip6_fib_table_mtrie_add_less_specific(fib_index, m, addr, len);
+    }
+}
+
+typedef struct ip6_fib_mtrie_build_ctx_t_ {
+    u32 fib_index;
+    ip6_fib_mtrie_t *mtrie;
+} ip6_fib_mtrie_build_ctx_t;
+
+static void
+ip6_fib_table_mtrie_add_entry (clib_bihash_kv_24_8_t * kvp,
+			       void *arg)
+{
+    ip6_fib_mtrie_build_ctx_t *ctx = arg;
+    ip6_address_t addr;
+
+    if ((kvp->key[2] >> 32) == ctx->fib_index)
+    {
+	addr.as_u64[0] = kvp->key[0];
+	addr.as_u64[1] = kvp->key[1];
+	ip6_fib_mtrie_add_del_route(ctx->mtrie, &addr, kvp->key[2] & 0xFF,
+				    kvp->value, 0);
+    }
+}
+
+/*
+ * ip6_fib_table_enable_disable_mtrie
+ *
+ * Look the table up in an mtrie, or in the forwarding hash. The mtrie is
+ * built aside from the forwarding hash, the workers only wait for the
+ * swap.
+ */
+void
+ip6_fib_table_enable_disable_mtrie (u32 fib_index,
+				    int is_enable)
+{
+    vlib_main_t *vm = vlib_get_main();
+    ip6_fib_t *fib = ip6_fib_get(fib_index);
+    ip6_fib_mtrie_t old, new;
+
+    if (is_enable == ip6_fib_mtrie_is_enabled(&fib->mtrie))
+	return;
+
+    memset(&new, 0, sizeof(new));
+    if (is_enable)
+    {
+	ip6_fib_mtrie_build_ctx_t ctx = {
+	    .fib_index = fib_index,
+	    .mtrie = &new,
+	};
+
+	ip6_fib_mtrie_init(&new);
+	BV(clib_bihash_foreach_key_value_pair)
+	    (&ip6_main.ip6_table[IP6_FIB_TABLE_FWDING].ip6_hash,
+	     ip6_fib_table_mtrie_add_entry, &ctx);
+    }
+
+    vlib_worker_thread_barrier_sync(vm);
+    old = fib->mtrie;
+    fib->mtrie = new;
+    vlib_worker_thread_barrier_release(vm);
+
+    ip6_fib_mtrie_free(&old);
 }
 
 typedef struct ip6_fib_show_ctx_t_ {
@@ -603,13 +733,14 @@ ip6_show_fib (vlib_main_t * vm,
     ip6_main_t * im6 = &ip6_main;
     fib_table_t *fib_table;
     ip6_fib_t * fib;
-    int verbose, matching;
+    int verbose, matching, mtrie;
     ip6_address_t matching_address;
     u32 mask_len  = 128;
     int table_id = -1, fib_index = ~0;
 
     verbose = 1;
     matching = 0;
+    mtrie = 0;
 
     while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
@@ -618,6 +749,9 @@ ip6_show_fib (vlib_main_t * vm,
 	    unformat (input, "sum"))
 	    verbose = 0;
 
+	else if (unformat (input, "mtrie"))
+	    mtrie = 1;
+
 	else if (unformat (input, "%U/%d",
 			   unformat_ip6_address, &matching_address, &mask_len))
 	    matching = 1;
@@ -645,6 +779,9 @@ ip6_show_fib (vlib_main_t * vm,
 			 fib_table->ft_desc, fib->index,
 			 format_ip_flow_hash_config, fib->flow_hash_config);
 
+	if (mtrie)
+	    vlib_cli_output (vm, "%U", format_ip6_fib_mtrie, &fib->mtrie);
+
 	/* Show summary? */
 	if (! verbose)
 	{
@@ -693,6 +830,58 @@ ip6_show_fib (vlib_main_t * vm,
  ?*/
 VLIB_CLI_COMMAND (ip6_show_fib_command, static) = {
     .path = "show ip6 fib",
-    .short_help = "show ip6 fib [summary] [table <n>] [<ip6-addr>] [verboase]",
+    .short_help = "show ip6 fib [mtrie] [summary] [table <n>] [<ip6-addr>] [verboase]",
     .function = ip6_show_fib,
 };
+
+static clib_error_t *
+ip6_set_fib_mtrie (vlib_main_t * vm,
+		   unformat_input_t * input,
+		   vlib_cli_command_t * cmd)
+{
+    u32 table_id = 0, fib_index;
+    int is_enable = -1;
+
+    while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+	if (unformat (input, "table %d", &table_id))
+	    ;
+	else if (unformat (input, "enable"))
+	    is_enable = 1;
+	else if (unformat (input, "disable"))
+	    is_enable = 0;
+	else
+	    return clib_error_return (0, "unknown input `%U'",
+				      format_unformat_error, input);
+    }
+
+    if (-1 == is_enable)
+	return clib_error_return (0, "enable or disable required");
+
+    fib_index = ip6_fib_index_from_table_id(table_id);
+    if (~0 == fib_index)
+	return clib_error_return (0, "no such table %d", table_id);
+
+    ip6_fib_table_enable_disable_mtrie(fib_index, is_enable);
+
+    return 0;
+}
+
+/*?
+ * Look up an IPv6 FIB table in a 16-8-...-8 mtrie rather than in the
+ * forwarding hash. The hash takes one probe per prefix length present in
+ * the FIBs, the mtrie one memory read per 8 bits of the matching prefix
+ * beyond /16. The mtrie is built from the table's routes and costs 320KB,
+ * plus about 1.3KB per ply.
+ *
+ * @cliexpar
+ * @cliexstart{set ip6 fib mtrie}
+ *   vpp# set ip6 fib mtrie table 0 enable
+ *   vpp# sh ip6 fib table 0 mtrie summary
+ * @cliexend
+ ?*/
+VLIB_CLI_COMMAND (ip6_set_fib_mtrie_command, static) = {
+    .path = "set ip6 fib mtrie",
+    .short_help = "set ip6 fib mtrie [table <n>] enable|disable",
+    .function = ip6_set_fib_mtrie,
+};
@@ -711,6 +711,7 @@ vnet_register_interface (vnet_main_t * vnm,
   hw->per_packet_overhead_bytes = 0;
   hw->max_l3_packet_bytes[VLIB_RX] = ~0;
   hw->max_l3_packet_bytes[VLIB_TX] = ~0;
+  hw->rx_redirect_node_index = ~0;
 
   tx_node_name = (char *) format (0, "%v-tx", hw->name);
   output_node_name = (char *) format (0, "%v-output", hw->name);
@@ -1003,6 +1004,7 @@ vnet_hw_interface_rx_redirect_to_node_helper (vnet_main_t * vnm,
   if (dev_class->rx_redirect_to_node)
     {
       dev_class->rx_redirect_to_node (vnm, hw_if_index, node_index);
+      hi->rx_redirect_node_index = node_index;
       return 0;
     }
 
@@ -1126,6 +1128,23 @@ vnet_interface_init (vlib_main_t * vm)
       }
   }
 
+  /* Resolved once here, the output feature path runs per packet. */
+  {
+    u8 *node_names[] = {
+#define _(sym, str) (u8 *) str,
+      foreach_intf_output_feat
+#undef _
+    };
+    vlib_node_t *n;
+    int i;
+
+    for (i = 0; i < ARRAY_LEN (node_names); i++)
+      {
+	n = vlib_get_node_by_name (vm, node_names[i]);
+	vec_add1 (im->output_feature_node_index, n ? n->index : ~0);
+      }
+  }
+
   {
     clib_error_t *error;
 
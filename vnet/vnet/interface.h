@@ -349,6 +349,9 @@ typedef struct vnet_hw_interface_t
   /* Largest packet size for this interface. */
   u32 max_packet_bytes;
 
+  /* Node the device input is redirected to, ~0 if none. */
+  u32 rx_redirect_node_index;
+
   /* Number of extra bytes that go on the wire.
      Packet length on wire
      = max (length + per_packet_overhead_bytes, min_packet_bytes). */
@@ -517,6 +520,9 @@ typedef struct
 
   vnet_hw_interface_nodes_t *deleted_hw_interface_nodes;
 
+  /* Output feature node indices, by intf_output_feat_t. */
+  u32 *output_feature_node_index;
+
   /* pcap drop tracing */
   int drop_pcap_enable;
   pcap_main_t pcap_main;
@@ -552,7 +558,8 @@ int vnet_interface_name_renumber (u32 sw_if_index, u32 new_show_dev_instance);
  */
 
 #define foreach_intf_output_feat \
- _(IPSEC, "ipsec-output")
+ _(IPSEC, "ipsec-output")        \
+ _(SPAN, "span-output")
 
 /* Feature bitmap positions */
 typedef enum
@@ -241,6 +241,35 @@ u8 *format_vnet_interface_output_trace (u8 * s, va_list * va);
 serialize_function_t serialize_vnet_interface_state,
   unserialize_vnet_interface_state;
 
+/*
+ * Next node of a packet on the output feature path: the next output
+ * feature set in its bitmap, or the output node of its TX interface once
+ * all features are done.
+ */
+static_always_inline u32
+get_next_output_feature_node_index (vnet_main_t * vnm, vlib_buffer_t * b)
+{
+  u32 r;
+  intf_output_feat_t next_feature;
+
+  count_trailing_zeros (next_feature,
+			vnet_buffer (b)->output_features.bitmap);
+
+  if (next_feature >= INTF_OUTPUT_FEAT_DONE)
+    {
+      u32 sw_if_index = vnet_buffer (b)->sw_if_index[VLIB_TX];
+      vnet_hw_interface_t *hw = vnet_get_sup_hw_interface (vnm, sw_if_index);
+      r = hw->output_node_index;
+    }
+  else
+    {
+      vnet_buffer (b)->output_features.bitmap &= ~(1 << next_feature);
+      r = vnm->interface_main.output_feature_node_index[next_feature];
+    }
+
+  return r;
+}
+
 #endif /* included_vnet_interface_funcs_h */
 
 /*
@@ -38,6 +38,7 @@
  */
 
 #include <vnet/vnet.h>
+#include <vnet/span/span.h>
 
 typedef struct
 {
@@ -211,6 +212,12 @@ incr_output_stats (vnet_main_t * vnm,
 }
 
 
+always_inline uword
+vnet_interface_output_node_no_flatten_inline (vlib_main_t * vm,
+					      vlib_node_runtime_t * node,
+					      vlib_frame_t * frame,
+					      int with_features);
+
 /* Interface output functions. */
 uword
 vnet_interface_output_node (vlib_main_t * vm,
@@ -225,6 +232,21 @@ vnet_interface_output_node (vlib_main_t * vm,
   u32 last_sw_if_index;
   u32 cpu_index = vm->cpu_index;
 
+  /*
+   * output features see the packets first, the chains of the frames
+   * coming back from them are flattened
+   */
+  si = vnet_get_sw_interface (vnm, rt->sw_if_index);
+  if (PREDICT_FALSE (si->output_feature_bitmap))
+    {
+      u32 *first = vlib_frame_args (frame);
+      vlib_buffer_t *b = vlib_get_buffer (vm, first[0]);
+
+      if ((b->flags & BUFFER_OUTPUT_FEAT_DONE) == 0)
+	return vnet_interface_output_node_no_flatten_inline (vm, node, frame,
+							     1);
+    }
+
   n_buffers = frame->n_vectors;
 
   if (node->flags & VLIB_NODE_FLAG_TRACE)
@@ -608,11 +630,12 @@ vnet_interface_output_node_no_flatten_inline (vlib_main_t * vm,
       vlib_put_next_frame (vm, node, next_index, n_left_to_tx);
     }
 
-  /* Update main interface stats. */
-  vlib_increment_combined_counter (im->combined_sw_if_counters
-				   + VNET_INTERFACE_COUNTER_TX,
-				   cpu_index,
-				   rt->sw_if_index, n_packets, n_bytes);
+  /* Update main interface stats, once packets are back from the features */
+  if (!with_features)
+    vlib_increment_combined_counter (im->combined_sw_if_counters
+				     + VNET_INTERFACE_COUNTER_TX,
+				     cpu_index,
+				     rt->sw_if_index, n_packets, n_bytes);
   return n_buffers;
 }
 
@@ -1151,6 +1174,9 @@ process_drop (vlib_main_t * vm,
   if (PREDICT_FALSE (im->drop_pcap_enable))
     pcap_drop_trace (vm, im, frame);
 
+  if (PREDICT_FALSE (span_main.drop_session_index != ~0))
+    span_mirror_drops (vm, node, frame);
+
   return process_drop_punt (vm, node, frame, VNET_ERROR_DISPOSITION_DROP);
 }
 
@@ -562,14 +562,8 @@ ip6_icmp_error (vlib_main_t * vm,
            * within the minimum MTU. We cheat "a little" here by keeping whatever fits
            * in the first buffer, to be more efficient */
           if (PREDICT_FALSE(p0->total_length_not_including_first_buffer))
-            { /* clear current_length of all other buffers in chain */
-              vlib_buffer_t *b = p0;
-              p0->total_length_not_including_first_buffer = 0;
-              while (b->flags & VLIB_BUFFER_NEXT_PRESENT)
-                {
-                  b = vlib_get_buffer (vm, b->next_buffer);
-                  b->current_length = 0;
-                }                  
+            { /* drop all other buffers in chain, they may be shared with clones */
+              vlib_buffer_free_chain_tail (vm, p0);
             }
 	  p0->current_length = p0->current_length > 1280 ? 1280 : p0->current_length;
 
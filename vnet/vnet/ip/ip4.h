@@ -159,6 +159,13 @@ typedef struct ip4_main_t {
   /** Seed for Jenkins hash used to compute ip4 flow hash. */
   u32 flow_hash_seed;
 
+  /** Mtrie stride of FIBs created from now on. */
+  ip4_fib_mtrie_stride_t mtrie_stride;
+
+  /** Packets per iteration of the ip4-lookup and ip4-rewrite main loops,
+      2, 4 or 8. */
+  u32 forward_loop_width;
+
   /** @brief Template information for VPP generated packets */
   struct {
     /** TTL to use for host generated packets. */
@@ -331,6 +338,9 @@ serialize_function_t serialize_vnet_ip4_main, unserialize_vnet_ip4_main;
 int vnet_set_ip4_flow_hash (u32 table_id, flow_hash_config_t flow_hash_config);
 
 void ip4_mtrie_init (ip4_fib_mtrie_t * m);
+void ip4_mtrie_init_with_stride (ip4_fib_mtrie_t * m,
+				 ip4_fib_mtrie_stride_t stride);
+void ip4_mtrie_free (ip4_fib_mtrie_t * m);
 
 int vnet_set_ip4_classify_intfc (vlib_main_t * vm, u32 sw_if_index, 
                                  u32 table_index);
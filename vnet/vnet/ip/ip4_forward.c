@@ -57,6 +57,150 @@ ip4_forward_next_trace (vlib_main_t * vm,
                         vlib_frame_t * frame,
                         vlib_rx_or_tx_t which_adj_index);
 
+/* Default packets per iteration of the ip4-lookup and ip4-rewrite main
+   loops, see "set ip forward loop-width". */
+#ifndef IP4_FORWARD_LOOP_WIDTH
+#define IP4_FORWARD_LOOP_WIDTH 2
+#endif
+
+#if IP4_FORWARD_LOOP_WIDTH != 2 && IP4_FORWARD_LOOP_WIDTH != 4 \
+  && IP4_FORWARD_LOOP_WIDTH != 8
+#error IP4_FORWARD_LOOP_WIDTH must be 2, 4 or 8
+#endif
+
+#define IP4_FORWARD_LOOP_MAX_WIDTH 8
+
+/* Enqueues n buffers to their next nodes, n > 0 and n_left_to_next >= 1. */
+always_inline void
+ip4_forward_enqueue_x_n (vlib_main_t * vm,
+			 vlib_node_runtime_t * node,
+			 u32 * from, u32 * nexts, u32 n,
+			 u32 * next_index, u32 ** to_next, u32 * n_left_to_next)
+{
+  u32 next = *next_index, * to = *to_next, n_left = *n_left_to_next;
+  u32 i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (PREDICT_FALSE (n_left == 0))
+	{
+	  vlib_put_next_frame (vm, node, next, 0);
+	  vlib_get_next_frame (vm, node, next, to, n_left);
+	}
+
+      to[0] = from[i];
+      to += 1;
+      n_left -= 1;
+
+      vlib_validate_buffer_enqueue_x1 (vm, node, next, to, n_left,
+				       from[i], nexts[i]);
+    }
+
+  *next_index = next;
+  *to_next = to;
+  *n_left_to_next = n_left;
+}
+
+/*
+ * Looks up n packets, n a constant up to IP4_FORWARD_LOOP_MAX_WIDTH, one
+ * stage at a time for all of them so that their cache misses overlap:
+ * prefetch of the next n packets, prefetch of the root mtrie plies, ply
+ * walk, prefetch of the load balances, then flow hash and bucket. The
+ * next nodes are returned in nexts.
+ */
+always_inline void
+ip4_lookup_x_n (vlib_main_t * vm,
+		u32 * from, u32 * nexts, u32 n, u32 cpu_index,
+		int lookup_for_responses_to_locally_received_packets)
+{
+  ip4_main_t * im = &ip4_main;
+  vlib_combined_counter_main_t * cm = &load_balance_main.lbm_to_counters;
+  vlib_buffer_t * p[IP4_FORWARD_LOOP_MAX_WIDTH];
+  ip4_header_t * ip[IP4_FORWARD_LOOP_MAX_WIDTH];
+  ip4_fib_mtrie_t * mtrie[IP4_FORWARD_LOOP_MAX_WIDTH];
+  ip4_fib_mtrie_leaf_t leaf[IP4_FORWARD_LOOP_MAX_WIDTH];
+  u32 lb_index[IP4_FORWARD_LOOP_MAX_WIDTH];
+  const load_balance_t * lb;
+  const dpo_id_t * dpo;
+  u32 i, b, fib_index, hash_c;
+
+  /* Prefetch next iteration. */
+  for (i = 0; i < n; i++)
+    {
+      vlib_buffer_t * pf = vlib_get_buffer (vm, from[n + i]);
+
+      vlib_prefetch_buffer_header (pf, LOAD);
+      CLIB_PREFETCH (pf->data, sizeof (ip[0][0]), LOAD);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      p[i] = vlib_get_buffer (vm, from[i]);
+      ip[i] = vlib_buffer_get_current (p[i]);
+    }
+
+  if (lookup_for_responses_to_locally_received_packets)
+    {
+      for (i = 0; i < n; i++)
+	lb_index[i] = vnet_buffer (p[i])->ip.adj_index[VLIB_RX];
+    }
+  else
+    {
+      for (i = 0; i < n; i++)
+	{
+	  fib_index = vec_elt (im->fib_index_by_sw_if_index,
+			       vnet_buffer (p[i])->sw_if_index[VLIB_RX]);
+	  fib_index = (vnet_buffer (p[i])->sw_if_index[VLIB_TX] == (u32)~0) ?
+	    fib_index : vnet_buffer (p[i])->sw_if_index[VLIB_TX];
+
+	  mtrie[i] = &ip4_fib_get (fib_index)->mtrie;
+	  ip4_fib_mtrie_prefetch_root (mtrie[i], &ip[i]->dst_address);
+	  leaf[i] = IP4_FIB_MTRIE_LEAF_ROOT;
+	}
+
+      for (b = 0; b < 4; b++)
+	for (i = 0; i < n; i++)
+	  leaf[i] = ip4_fib_mtrie_lookup_step (mtrie[i], leaf[i],
+					       &ip[i]->dst_address, b);
+
+      for (i = 0; i < n; i++)
+	{
+	  /* Handle default route. */
+	  leaf[i] = (leaf[i] == IP4_FIB_MTRIE_LEAF_EMPTY ?
+		     mtrie[i]->default_leaf : leaf[i]);
+	  lb_index[i] = ip4_fib_mtrie_leaf_get_adj_index (leaf[i]);
+	}
+    }
+
+  for (i = 0; i < n; i++)
+    CLIB_PREFETCH (load_balance_get (lb_index[i]),
+		   CLIB_CACHE_LINE_BYTES, LOAD);
+
+  for (i = 0; i < n; i++)
+    {
+      lb = load_balance_get (lb_index[i]);
+
+      /* Use flow hash to compute multipath adjacency. */
+      hash_c = vnet_buffer (p[i])->ip.flow_hash = 0;
+      if (PREDICT_FALSE (lb->lb_n_buckets > 1))
+	hash_c = vnet_buffer (p[i])->ip.flow_hash =
+	  ip4_compute_flow_hash (ip[i], lb->lb_hash_config);
+
+      ASSERT (lb->lb_n_buckets > 0);
+      ASSERT (is_pow2 (lb->lb_n_buckets));
+
+      dpo = load_balance_get_bucket_i (lb, hash_c & lb->lb_n_buckets_minus_1);
+
+      nexts[i] = dpo->dpoi_next_node;
+      vnet_buffer (p[i])->ip.adj_index[VLIB_TX] = dpo->dpoi_index;
+
+      vlib_increment_combined_counter
+	(cm, cpu_index, lb_index[i], 1,
+	 vlib_buffer_length_in_chain (vm, p[i])
+	 + sizeof(ethernet_header_t));
+    }
+}
+
 always_inline uword
 ip4_lookup_inline (vlib_main_t * vm,
 		   vlib_node_runtime_t * node,
@@ -66,7 +210,7 @@ ip4_lookup_inline (vlib_main_t * vm,
   ip4_main_t * im = &ip4_main;
   vlib_combined_counter_main_t * cm = &load_balance_main.lbm_to_counters;
   u32 n_left_from, n_left_to_next, * from, * to_next;
-  ip_lookup_next_t next;
+  u32 next, nexts[IP4_FORWARD_LOOP_MAX_WIDTH];
   u32 cpu_index = os_get_cpu_number();
 
   from = vlib_frame_vector_args (frame);
@@ -78,6 +222,28 @@ ip4_lookup_inline (vlib_main_t * vm,
       vlib_get_next_frame (vm, node, next,
 			   to_next, n_left_to_next);
 
+      if (im->forward_loop_width >= 8)
+	while (n_left_from >= 16 && n_left_to_next >= 8)
+	  {
+	    ip4_lookup_x_n (vm, from, nexts, 8, cpu_index,
+			    lookup_for_responses_to_locally_received_packets);
+	    ip4_forward_enqueue_x_n (vm, node, from, nexts, 8,
+				     &next, &to_next, &n_left_to_next);
+	    from += 8;
+	    n_left_from -= 8;
+	  }
+
+      if (im->forward_loop_width >= 4)
+	while (n_left_from >= 8 && n_left_to_next >= 4)
+	  {
+	    ip4_lookup_x_n (vm, from, nexts, 4, cpu_index,
+			    lookup_for_responses_to_locally_received_packets);
+	    ip4_forward_enqueue_x_n (vm, node, from, nexts, 4,
+				     &next, &to_next, &n_left_to_next);
+	    from += 4;
+	    n_left_from -= 4;
+	  }
+
       while (n_left_from >= 4 && n_left_to_next >= 2)
       	{
       	  vlib_buffer_t * p0, * p1;
@@ -193,7 +359,7 @@ ip4_lookup_inline (vlib_main_t * vm,
               hash_c0 = vnet_buffer (p0)->ip.flow_hash =
                 ip4_compute_flow_hash (ip0, flow_hash_config0);
             }
-          if (PREDICT_FALSE(lb0->lb_n_buckets > 1))
+          if (PREDICT_FALSE(lb1->lb_n_buckets > 1))
             {
 	      flow_hash_config1 = lb1->lb_hash_config;
               hash_c1 = vnet_buffer (p1)->ip.flow_hash =
@@ -210,7 +376,7 @@ ip4_lookup_inline (vlib_main_t * vm,
                                             (lb0->lb_n_buckets_minus_1)));
 	  dpo1 = load_balance_get_bucket_i(lb1,
                                            (hash_c1 &
-                                            (lb0->lb_n_buckets_minus_1)));
+                                            (lb1->lb_n_buckets_minus_1)));
 
 	  next0 = dpo0->dpoi_next_node;
 	  vnet_buffer (p0)->ip.adj_index[VLIB_TX] = dpo0->dpoi_index;
@@ -1022,6 +1188,8 @@ ip4_lookup_init (vlib_main_t * vm)
 
   ip_lookup_init (&im->lookup_main, /* is_ip6 */ 0);
 
+  im->forward_loop_width = IP4_FORWARD_LOOP_WIDTH;
+
   /* Create FIB with index 0 and table id of 0. */
   fib_table_find_or_create_and_lock(FIB_PROTOCOL_IP4, 0);
 
@@ -2098,6 +2266,163 @@ typedef enum {
   IP4_REWRITE_NEXT_ICMP_ERROR,
 } ip4_rewrite_next_t;
 
+/*
+ * Rewrites n packets, n a constant up to IP4_FORWARD_LOOP_MAX_WIDTH, one
+ * stage at a time for all of them: prefetch of the next n packets,
+ * prefetch of the adjacencies, ttl and checksum update while they load,
+ * then rewrite. The next nodes are returned in nexts.
+ */
+always_inline void
+ip4_rewrite_x_n (vlib_main_t * vm,
+		 vlib_node_runtime_t * error_node,
+		 u32 * from, u32 * nexts, u32 n, u32 cpu_index,
+		 int rewrite_for_locally_received_packets,
+		 int is_midchain)
+{
+  ip_lookup_main_t * lm = &ip4_main.lookup_main;
+  ip_config_main_t * cm = &lm->feature_config_mains[VNET_IP_TX_FEAT];
+  vlib_rx_or_tx_t adj_rx_tx = rewrite_for_locally_received_packets ? VLIB_RX : VLIB_TX;
+  vlib_buffer_t * p[IP4_FORWARD_LOOP_MAX_WIDTH];
+  ip4_header_t * ip[IP4_FORWARD_LOOP_MAX_WIDTH];
+  ip_adjacency_t * adj[IP4_FORWARD_LOOP_MAX_WIDTH];
+  u32 adj_index[IP4_FORWARD_LOOP_MAX_WIDTH];
+  u32 error[IP4_FORWARD_LOOP_MAX_WIDTH];
+  u32 i, rw_len, checksum, next_override, tx_sw_if_index;
+
+  /* Prefetch next iteration. */
+  for (i = 0; i < n; i++)
+    {
+      vlib_buffer_t * pf = vlib_get_buffer (vm, from[n + i]);
+
+      vlib_prefetch_buffer_header (pf, STORE);
+      CLIB_PREFETCH (pf->data, sizeof (ip[0][0]), STORE);
+    }
+
+  /* Prefetch the rewrite strings, and the first cache line of the
+     adjacencies when it is used. */
+  for (i = 0; i < n; i++)
+    {
+      p[i] = vlib_get_buffer (vm, from[i]);
+      ip[i] = vlib_buffer_get_current (p[i]);
+
+      adj_index[i] = vnet_buffer (p[i])->ip.adj_index[adj_rx_tx];
+
+      /* We should never rewrite a pkt using the MISS adjacency */
+      ASSERT (adj_index[i]);
+
+      adj[i] = ip_get_adjacency (lm, adj_index[i]);
+      CLIB_PREFETCH (&adj[i]->rewrite_header, VLIB_BUFFER_PRE_DATA_SIZE,
+		     LOAD);
+      if (rewrite_for_locally_received_packets || is_midchain)
+	CLIB_PREFETCH (adj[i], CLIB_CACHE_LINE_BYTES, LOAD);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      error[i] = IP4_ERROR_NONE;
+      nexts[i] = IP4_REWRITE_NEXT_DROP;
+
+      /* Decrement TTL & update checksum. */
+      if (! rewrite_for_locally_received_packets)
+	{
+	  i32 ttl = ip[i]->ttl;
+
+	  /* Input node should have reject packets with ttl 0. */
+	  ASSERT (ip[i]->ttl > 0);
+
+	  checksum = ip[i]->checksum + clib_host_to_net_u16 (0x0100);
+	  checksum += checksum >= 0xffff;
+	  ip[i]->checksum = checksum;
+
+	  ttl -= 1;
+	  ip[i]->ttl = ttl;
+
+	  ASSERT (ip[i]->checksum == ip4_header_checksum (ip[i]));
+
+	  /*
+	   * If the ttl drops below 1 when forwarding, generate
+	   * an ICMP response.
+	   */
+	  if (PREDICT_FALSE (ttl <= 0))
+	    {
+	      error[i] = IP4_ERROR_TIME_EXPIRED;
+	      nexts[i] = IP4_REWRITE_NEXT_ICMP_ERROR;
+	      vnet_buffer (p[i])->sw_if_index[VLIB_TX] = (u32)~0;
+	      icmp4_error_set_vnet_buffer (p[i], ICMP4_time_exceeded,
+					   ICMP4_time_exceeded_ttl_exceeded_in_transit,
+					   0);
+	    }
+	}
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      next_override = 0;
+
+      /*
+       * We have to override the next_index in ARP adjacencies,
+       * because they're set up for ip4-arp, not this node...
+       */
+      if (rewrite_for_locally_received_packets
+	  && PREDICT_FALSE (adj[i]->lookup_next_index == IP_LOOKUP_NEXT_ARP))
+	next_override = IP4_REWRITE_NEXT_ARP;
+
+      /* Guess we are only writing on simple Ethernet header. */
+      vnet_rewrite_one_header (adj[i][0], ip[i], sizeof (ethernet_header_t));
+
+      /* Update packet buffer attributes/set output interface. */
+      rw_len = adj[i][0].rewrite_header.data_bytes;
+      vnet_buffer (p[i])->ip.save_rewrite_length = rw_len;
+
+      if (PREDICT_FALSE (rw_len > sizeof (ethernet_header_t)))
+	vlib_increment_combined_counter
+	  (&adjacency_counters,
+	   cpu_index, adj_index[i],
+	   /* packet increment */ 0,
+	   /* byte increment */ rw_len - sizeof (ethernet_header_t));
+
+      /* Check MTU of outgoing interface. */
+      error[i] = (vlib_buffer_length_in_chain (vm, p[i])
+		  > adj[i][0].rewrite_header.max_l3_packet_bytes
+		  ? IP4_ERROR_MTU_EXCEEDED
+		  : error[i]);
+
+      p[i]->error = error_node->errors[error[i]];
+
+      if (PREDICT_TRUE (error[i] == IP4_ERROR_NONE))
+	nexts[i] = adj[i][0].rewrite_header.next_index;
+
+      if (rewrite_for_locally_received_packets)
+	nexts[i] = nexts[i] && next_override ? next_override : nexts[i];
+
+      /* Don't adjust the buffer for ttl issue; icmp-error node wants
+       * to see the IP headerr */
+      if (PREDICT_TRUE (error[i] == IP4_ERROR_NONE))
+	{
+	  p[i]->current_data -= rw_len;
+	  p[i]->current_length += rw_len;
+	  tx_sw_if_index = adj[i][0].rewrite_header.sw_if_index;
+
+	  vnet_buffer (p[i])->sw_if_index[VLIB_TX] = tx_sw_if_index;
+
+	  if (PREDICT_FALSE
+	      (clib_bitmap_get (lm->tx_sw_if_has_ip_output_features,
+				tx_sw_if_index)))
+	    {
+	      p[i]->current_config_index =
+		vec_elt (cm->config_index_by_sw_if_index, tx_sw_if_index);
+	      vnet_get_config_data (&cm->config_main,
+				    &p[i]->current_config_index,
+				    &nexts[i],
+				    /* # bytes of config data */ 0);
+	    }
+	}
+
+      if (is_midchain)
+	adj[i]->sub_type.midchain.fixup_func (vm, adj[i], p[i]);
+    }
+}
+
 always_inline uword
 ip4_rewrite_inline (vlib_main_t * vm,
 		    vlib_node_runtime_t * node,
@@ -2108,6 +2433,7 @@ ip4_rewrite_inline (vlib_main_t * vm,
   ip_lookup_main_t * lm = &ip4_main.lookup_main;
   u32 * from = vlib_frame_vector_args (frame);
   u32 n_left_from, n_left_to_next, * to_next, next_index;
+  u32 nexts[IP4_FORWARD_LOOP_MAX_WIDTH];
   vlib_node_runtime_t * error_node = vlib_node_get_runtime (vm, ip4_input_node.index);
   vlib_rx_or_tx_t adj_rx_tx = rewrite_for_locally_received_packets ? VLIB_RX : VLIB_TX;
   ip_config_main_t * cm = &lm->feature_config_mains[VNET_IP_TX_FEAT];
@@ -2120,6 +2446,28 @@ ip4_rewrite_inline (vlib_main_t * vm,
     {
       vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
 
+      if (ip4_main.forward_loop_width >= 8)
+	while (n_left_from >= 16 && n_left_to_next >= 8)
+	  {
+	    ip4_rewrite_x_n (vm, error_node, from, nexts, 8, cpu_index,
+			     rewrite_for_locally_received_packets, is_midchain);
+	    ip4_forward_enqueue_x_n (vm, node, from, nexts, 8,
+				     &next_index, &to_next, &n_left_to_next);
+	    from += 8;
+	    n_left_from -= 8;
+	  }
+
+      if (ip4_main.forward_loop_width >= 4)
+	while (n_left_from >= 8 && n_left_to_next >= 4)
+	  {
+	    ip4_rewrite_x_n (vm, error_node, from, nexts, 4, cpu_index,
+			     rewrite_for_locally_received_packets, is_midchain);
+	    ip4_forward_enqueue_x_n (vm, node, from, nexts, 4,
+				     &next_index, &to_next, &n_left_to_next);
+	    from += 4;
+	    n_left_from -= 4;
+	  }
+
       while (n_left_from >= 4 && n_left_to_next >= 2)
 	{
 	  ip_adjacency_t * adj0, * adj1;
@@ -3066,6 +3414,47 @@ VLIB_CLI_COMMAND (set_ip_flow_hash_command, static) = {
   "set ip table flow-hash table <fib-id> src dst sport dport proto reverse",
   .function = set_ip_flow_hash_command_fn,
 };
+
+static clib_error_t *
+set_ip_forward_loop_width_command_fn (vlib_main_t * vm,
+                                      unformat_input_t * input,
+                                      vlib_cli_command_t * cmd)
+{
+  u32 width;
+
+  if (! unformat (input, "%d", &width))
+    {
+      vlib_cli_output (vm, "ip4 forward loop width %d",
+                       ip4_main.forward_loop_width);
+      return 0;
+    }
+
+  if (width != 2 && width != 4 && width != 8)
+    return clib_error_return (0, "loop width must be 2, 4 or 8");
+
+  ip4_main.forward_loop_width = width;
+  return 0;
+}
+
+/*?
+ * Set the number of packets per iteration of the main loops of the
+ * ip4-lookup and ip4-rewrite nodes. Wider loops issue the prefetches of
+ * the mtrie plies, load balances and adjacency rewrite strings of more
+ * packets at once, and prefetch further ahead. Compare the clocks/vector
+ * of the nodes in 'show runtime' to pick the width for a platform. The
+ * default is 2, or IP4_FORWARD_LOOP_WIDTH at build time. Without a width,
+ * shows the current one.
+ *
+ * @cliexpar
+ * @cliexcmd{set ip forward loop-width 4}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_ip_forward_loop_width_command, static) = {
+  .path = "set ip forward loop-width",
+  .short_help = "set ip forward loop-width [2|4|8]",
+  .function = set_ip_forward_loop_width_command_fn,
+};
+/* *INDENT-ON* */
  
 int vnet_set_ip4_classify_intfc (vlib_main_t * vm, u32 sw_if_index, 
                                  u32 table_index)
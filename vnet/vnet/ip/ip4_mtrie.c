@@ -128,17 +128,62 @@ ply_free (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
     pool_put (m->ply_pool, p);
 }
 
+static void
+root_16_init (ip4_fib_mtrie_16_ply_t * p)
+{
+  uword i;
+
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    p->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
+  memset (p->dst_address_bits_of_leaves, 0, sizeof (p->dst_address_bits_of_leaves));
+}
+
+static void
+root_16_free (ip4_fib_mtrie_t * m)
+{
+  ip4_fib_mtrie_16_ply_t * p = m->root_16;
+  uword i;
+
+  for (i = 0 ; i < ARRAY_LEN (p->leaves); i++)
+    {
+      ip4_fib_mtrie_leaf_t l = p->leaves[i];
+      if (ip4_fib_mtrie_leaf_is_next_ply (l))
+	ply_free (m, get_next_ply_for_leaf (m, l));
+    }
+
+  root_16_init (p);
+}
+
 void ip4_fib_free (ip4_fib_mtrie_t * m)
 {
   ip4_fib_mtrie_ply_t * root_ply = pool_elt_at_index (m->ply_pool, 0);
+  if (m->root_16)
+    root_16_free (m);
   ply_free (m, root_ply);
 }
 
+/* Releases all memory of the mtrie. */
+void ip4_mtrie_free (ip4_fib_mtrie_t * m)
+{
+  pool_free (m->ply_pool);
+  if (m->root_16)
+    clib_mem_free (m->root_16);
+  memset (m, 0, sizeof (m[0]));
+}
+
 u32 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst)
 {
   ip4_fib_mtrie_ply_t * p = pool_elt_at_index (m->ply_pool, 0);
   ip4_fib_mtrie_leaf_t l;
 
+  if (m->root_16)
+    {
+      l = m->root_16->leaves[(dst.as_u8[0] << 8) | dst.as_u8[1]];
+      if (ip4_fib_mtrie_leaf_is_terminal (l))
+	return ip4_fib_mtrie_leaf_get_adj_index (l);
+      goto byte_2;
+    }
+
   l = p->leaves[dst.as_u8[0]];
   if (ip4_fib_mtrie_leaf_is_terminal (l))
     return ip4_fib_mtrie_leaf_get_adj_index (l);
@@ -148,6 +193,8 @@ u32 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst)
   if (ip4_fib_mtrie_leaf_is_terminal (l))
     return ip4_fib_mtrie_leaf_get_adj_index (l);
 
+ byte_2:
+
   p = get_next_ply_for_leaf (m, l);
   l = p->leaves[dst.as_u8[2]];
   if (ip4_fib_mtrie_leaf_is_terminal (l))
@@ -160,8 +207,11 @@ u32 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst)
   return ip4_fib_mtrie_leaf_get_adj_index (l);
 }
 
+/* Route to set or unset.  The ip4 and ip6 mtries share this code:
+   only the first n_address_bytes of dst_address are used. */
 typedef struct {
-  ip4_address_t dst_address;
+  u8 dst_address[16];
+  u32 n_address_bytes;
   u32 dst_address_length;
   u32 adj_index;
 } ip4_fib_mtrie_set_unset_leaf_args_t;
@@ -210,12 +260,13 @@ set_leaf (ip4_fib_mtrie_t * m,
   i32 n_dst_bits_next_plies;
   u8 dst_byte;
 
-  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
-  ASSERT (dst_address_byte_index < ARRAY_LEN (a->dst_address.as_u8));
+  ASSERT (a->dst_address_length > 0
+	  && a->dst_address_length <= BITS (u8) * a->n_address_bytes);
+  ASSERT (dst_address_byte_index < a->n_address_bytes);
 
   n_dst_bits_next_plies = a->dst_address_length - BITS (u8) * (dst_address_byte_index + 1);
 
-  dst_byte = a->dst_address.as_u8[dst_address_byte_index];
+  dst_byte = a->dst_address[dst_address_byte_index];
 
   /* Number of bits next plies <= 0 => insert leaves this ply. */
   if (n_dst_bits_next_plies <= 0)
@@ -223,7 +274,7 @@ set_leaf (ip4_fib_mtrie_t * m,
       uword i, n_dst_bits_this_ply, old_leaf_is_terminal;
 
       n_dst_bits_this_ply = -n_dst_bits_next_plies;
-      ASSERT ((a->dst_address.as_u8[dst_address_byte_index] & pow2_mask (n_dst_bits_this_ply)) == 0);
+      ASSERT ((a->dst_address[dst_address_byte_index] & pow2_mask (n_dst_bits_this_ply)) == 0);
 
       for (i = dst_byte; i < dst_byte + (1 << n_dst_bits_this_ply); i++)
 	{
@@ -307,14 +358,15 @@ unset_leaf (ip4_fib_mtrie_t * m,
   i32 i, n_dst_bits_this_ply, old_leaf_is_terminal;
   u8 dst_byte;
 
-  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
-  ASSERT (dst_address_byte_index < ARRAY_LEN (a->dst_address.as_u8));
+  ASSERT (a->dst_address_length > 0
+	  && a->dst_address_length <= BITS (u8) * a->n_address_bytes);
+  ASSERT (dst_address_byte_index < a->n_address_bytes);
 
   n_dst_bits_next_plies = a->dst_address_length - BITS (u8) * (dst_address_byte_index + 1);
 
-  dst_byte = a->dst_address.as_u8[dst_address_byte_index];
+  dst_byte = a->dst_address[dst_address_byte_index];
   if (n_dst_bits_next_plies < 0)
-    dst_byte &= ~pow2_mask (-n_dst_bits_next_plies);
+    dst_byte &= ~pow2_mask (clib_min (8, -n_dst_bits_next_plies));
 
   n_dst_bits_this_ply = n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
   n_dst_bits_this_ply = clib_min (8, n_dst_bits_this_ply);
@@ -351,13 +403,182 @@ unset_leaf (ip4_fib_mtrie_t * m,
   return 0;
 }
 
-void ip4_mtrie_init (ip4_fib_mtrie_t * m)
+/* Root ply of the 16-8-8 mtrie: same as set_leaf for the first 16 bits.
+   The root ply is never freed, so it doesn't count its non-empty leaves. */
+static void
+set_root_16_leaf (ip4_fib_mtrie_t * m,
+		  ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip4_fib_mtrie_16_ply_t * root = m->root_16;
+  ip4_fib_mtrie_leaf_t old_leaf, new_leaf;
+  i32 n_dst_bits_next_plies;
+  u32 dst_slot;
+
+  ASSERT (a->dst_address_length > 0
+	  && a->dst_address_length <= BITS (u8) * a->n_address_bytes);
+
+  n_dst_bits_next_plies = a->dst_address_length - 16;
+
+  dst_slot = (a->dst_address[0] << 8) | a->dst_address[1];
+
+  /* Number of bits next plies <= 0 => insert leaves this ply. */
+  if (n_dst_bits_next_plies <= 0)
+    {
+      uword i, n_dst_bits_this_ply;
+
+      n_dst_bits_this_ply = -n_dst_bits_next_plies;
+      ASSERT ((dst_slot & pow2_mask (n_dst_bits_this_ply)) == 0);
+
+      for (i = dst_slot; i < dst_slot + (1 << n_dst_bits_this_ply); i++)
+	{
+	  old_leaf = root->leaves[i];
+
+	  /* Plies hold more specific routes only; see set_leaf. */
+	  if (! ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	    {
+	      new_leaf = ip4_fib_mtrie_leaf_set_adj_index (a->adj_index);
+	      set_ply_with_more_specific_leaf (m, get_next_ply_for_leaf (m, old_leaf),
+					       new_leaf, a->dst_address_length);
+	    }
+
+	  /* Is leaf to be inserted more specific? */
+	  else if (a->dst_address_length >= root->dst_address_bits_of_leaves[i])
+	    {
+	      new_leaf = ip4_fib_mtrie_leaf_set_adj_index (a->adj_index);
+	      root->dst_address_bits_of_leaves[i] = a->dst_address_length;
+	      __sync_val_compare_and_swap (&root->leaves[i], old_leaf, new_leaf);
+	      ASSERT (root->leaves[i] == new_leaf);
+	    }
+	}
+    }
+  else
+    {
+      ip4_fib_mtrie_ply_t * new_ply;
+
+      old_leaf = root->leaves[dst_slot];
+      if (ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  new_leaf = ply_create (m, old_leaf, root->dst_address_bits_of_leaves[dst_slot]);
+	  new_ply = get_next_ply_for_leaf (m, new_leaf);
+
+	  __sync_val_compare_and_swap (&root->leaves[dst_slot], old_leaf, new_leaf);
+	  ASSERT (root->leaves[dst_slot] == new_leaf);
+	  root->dst_address_bits_of_leaves[dst_slot] = 0;
+	}
+      else
+	new_ply = get_next_ply_for_leaf (m, old_leaf);
+
+      set_leaf (m, a, new_ply - m->ply_pool, /* dst_address_byte_index */ 2);
+    }
+}
+
+static void
+unset_root_16_leaf (ip4_fib_mtrie_t * m,
+		    ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip4_fib_mtrie_16_ply_t * root = m->root_16;
+  ip4_fib_mtrie_leaf_t old_leaf, del_leaf;
+  i32 i, n_dst_bits_next_plies, n_dst_bits_this_ply;
+  u32 dst_slot;
+
+  ASSERT (a->dst_address_length > 0
+	  && a->dst_address_length <= BITS (u8) * a->n_address_bytes);
+
+  n_dst_bits_next_plies = a->dst_address_length - 16;
+
+  dst_slot = (a->dst_address[0] << 8) | a->dst_address[1];
+  if (n_dst_bits_next_plies < 0)
+    dst_slot &= ~pow2_mask (-n_dst_bits_next_plies);
+
+  n_dst_bits_this_ply = n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
+
+  del_leaf = ip4_fib_mtrie_leaf_set_adj_index (a->adj_index);
+
+  for (i = dst_slot; i < dst_slot + (1 << n_dst_bits_this_ply); i++)
+    {
+      old_leaf = root->leaves[i];
+
+      if (old_leaf == del_leaf
+	  || (! ip4_fib_mtrie_leaf_is_terminal (old_leaf)
+	      && unset_leaf (m, a, get_next_ply_for_leaf (m, old_leaf), 2)))
+	{
+	  root->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
+	  root->dst_address_bits_of_leaves[i] = 0;
+	}
+    }
+}
+
+static void
+set_root_leaf (ip4_fib_mtrie_t * m,
+	       ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  if (m->root_16)
+    set_root_16_leaf (m, a);
+  else
+    set_leaf (m, a, /* ply_index */ 0, /* dst_address_byte_index */ 0);
+}
+
+static void
+unset_root_leaf (ip4_fib_mtrie_t * m,
+		 ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  if (m->root_16)
+    unset_root_16_leaf (m, a);
+  else
+    unset_leaf (m, a, pool_elt_at_index (m->ply_pool, 0), 0);
+}
+
+void ip4_mtrie_init_with_stride (ip4_fib_mtrie_t * m,
+				 ip4_fib_mtrie_stride_t stride)
 {
   ip4_fib_mtrie_leaf_t root;
   memset (m, 0, sizeof (m[0]));
   m->default_leaf = IP4_FIB_MTRIE_LEAF_EMPTY;
   root = ply_create (m, IP4_FIB_MTRIE_LEAF_EMPTY, /* dst_address_bits_of_leaves */ 0);
   ASSERT (ip4_fib_mtrie_leaf_get_next_ply_index (root) == 0);
+
+  if (stride == IP4_FIB_MTRIE_STRIDE_16_8_8)
+    {
+      m->root_16 = clib_mem_alloc_aligned (sizeof (m->root_16[0]),
+					   CLIB_CACHE_LINE_BYTES);
+      root_16_init (m->root_16);
+    }
+}
+
+void ip4_mtrie_init (ip4_fib_mtrie_t * m)
+{
+  ip4_mtrie_init_with_stride (m, IP4_FIB_MTRIE_STRIDE_8_8_8_8);
+}
+
+void
+ip_fib_mtrie_add_del_route (ip4_fib_mtrie_t * m,
+			    const u8 * dst_address,
+			    u32 n_address_bytes,
+			    u32 dst_address_length,
+			    u32 adj_index,
+			    u32 is_del)
+{
+  ip4_fib_mtrie_set_unset_leaf_args_t a;
+
+  ASSERT (n_address_bytes <= ARRAY_LEN (a.dst_address));
+
+  if (dst_address_length == 0)
+    {
+      m->default_leaf = (is_del
+			 ? IP4_FIB_MTRIE_LEAF_EMPTY
+			 : ip4_fib_mtrie_leaf_set_adj_index (adj_index));
+      return;
+    }
+
+  clib_memcpy (a.dst_address, dst_address, n_address_bytes);
+  a.n_address_bytes = n_address_bytes;
+  a.dst_address_length = dst_address_length;
+  a.adj_index = adj_index;
+
+  if (is_del)
+    unset_root_leaf (m, &a);
+  else
+    set_root_leaf (m, &a);
 }
 
 void
@@ -368,65 +589,42 @@ ip4_fib_mtrie_add_del_route (ip4_fib_t * fib,
 			     u32 is_del)
 {
   ip4_fib_mtrie_t * m = &fib->mtrie;
-  ip4_fib_mtrie_ply_t * root_ply;
-  ip4_fib_mtrie_set_unset_leaf_args_t a;
   ip4_main_t * im = &ip4_main;
+  uword i;
 
   ASSERT(m->ply_pool != 0);
 
-  root_ply = pool_elt_at_index (m->ply_pool, 0);
-
   /* Honor dst_address_length. Fib masks are in network byte order */
   dst_address.as_u32 &= im->fib_masks[dst_address_length];
-  a.dst_address = dst_address;
-  a.dst_address_length = dst_address_length;
-  a.adj_index = adj_index;
-
-  if (! is_del)
-    {
-      if (dst_address_length == 0)
-	m->default_leaf = ip4_fib_mtrie_leaf_set_adj_index (adj_index);
-      else
-	set_leaf (m, &a, /* ply_index */ 0, /* dst_address_byte_index */ 0);
-    }
-  else
-    {
-      if (dst_address_length == 0)
-	m->default_leaf = IP4_FIB_MTRIE_LEAF_EMPTY;
 
-      else
-	{
-	  ip4_main_t * im = &ip4_main;
-	  uword i;
+  ip_fib_mtrie_add_del_route (m, dst_address.as_u8, sizeof (dst_address),
+			      dst_address_length, adj_index, is_del);
 
-	  unset_leaf (m, &a, root_ply, 0);
+  if (! is_del || dst_address_length == 0)
+    return;
 
-	  /* Find next less specific route and insert into mtrie. */
-	  for (i = dst_address_length - 1; i >= 1; i--)
-	    {
-	      uword * p;
-              index_t lbi;
-	      ip4_address_t key;
-
-	      if (! fib->fib_entry_by_dst_address[i])
-		continue;
-	      
-	      key.as_u32 = dst_address.as_u32 & im->fib_masks[i];
-	      p = hash_get (fib->fib_entry_by_dst_address[i], key.as_u32);
-	      if (p)
-		{
-		  lbi = fib_entry_contribute_ip_forwarding(p[0])->dpoi_index;
-		  if (INDEX_INVALID == lbi)
- 		    continue;
+  /* Find next less specific route and insert into mtrie. */
+  for (i = dst_address_length - 1; i >= 1; i--)
+    {
+      uword * p;
+      index_t lbi;
+      ip4_address_t key;
 
-		  a.dst_address = key;
-		  a.adj_index = lbi;
-		  a.dst_address_length = i;
+      if (! fib->fib_entry_by_dst_address[i])
+	continue;
 
-		  set_leaf (m, &a, /* ply_index */ 0, /* dst_address_byte_index */ 0);
-		  break;
-		}
-	    }
+      key.as_u32 = dst_address.as_u32 & im->fib_masks[i];
+      p = hash_get (fib->fib_entry_by_dst_address[i], key.as_u32);
+      if (p)
+	{
+	  lbi = fib_entry_contribute_ip_forwarding(p[0])->dpoi_index;
+	  if (INDEX_INVALID == lbi)
+	    continue;
+
+	  ip_fib_mtrie_add_del_route (m, key.as_u8, sizeof (key),
+				      /* dst_address_length */ i, lbi,
+				      /* is_del */ 0);
+	  break;
 	}
     }
 }
@@ -441,6 +639,18 @@ static uword mtrie_memory_usage (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
       if (pool_is_free_index (m->ply_pool, 0))
 	return 0;
       p = pool_elt_at_index (m->ply_pool, 0);
+
+      if (m->root_16)
+	{
+	  bytes = sizeof (p[0]) + sizeof (m->root_16[0]);
+	  for (i = 0 ; i < ARRAY_LEN (m->root_16->leaves); i++)
+	    {
+	      ip4_fib_mtrie_leaf_t l = m->root_16->leaves[i];
+	      if (ip4_fib_mtrie_leaf_is_next_ply (l))
+		bytes += mtrie_memory_usage (m, get_next_ply_for_leaf (m, l));
+	    }
+	  return bytes;
+	}
     }
 
   bytes = sizeof (p[0]);
@@ -454,7 +664,7 @@ static uword mtrie_memory_usage (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
   return bytes;
 }
 
-static u8 * format_ip4_fib_mtrie_leaf (u8 * s, va_list * va)
+u8 * format_ip4_fib_mtrie_leaf (u8 * s, va_list * va)
 {
   ip4_fib_mtrie_leaf_t l = va_arg (*va, ip4_fib_mtrie_leaf_t);
 
@@ -511,15 +721,58 @@ static u8 * format_ip4_fib_mtrie_ply (u8 * s, va_list * va)
   return s;
 }
 
+static u8 * format_ip4_fib_mtrie_16_ply (u8 * s, va_list * va)
+{
+  ip4_fib_mtrie_t * m = va_arg (*va, ip4_fib_mtrie_t *);
+  ip4_fib_mtrie_16_ply_t * p = m->root_16;
+  uword i, indent;
+
+  indent = format_get_indent (s);
+  s = format (s, "root ply");
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    {
+      ip4_fib_mtrie_leaf_t l = p->leaves[i];
+
+      if (! ip4_fib_mtrie_leaf_is_empty (l))
+	{
+	  u32 a, ia_length;
+	  ip4_address_t ia;
+
+	  a = i << 16;
+	  ia.as_u32 = clib_host_to_net_u32 (a);
+	  if (ip4_fib_mtrie_leaf_is_terminal (l))
+	    ia_length = p->dst_address_bits_of_leaves[i];
+	  else
+	    ia_length = 16;
+	  s = format (s, "\n%U%20U %U",
+		      format_white_space, indent + 2,
+		      format_ip4_address_and_length, &ia, ia_length,
+		      format_ip4_fib_mtrie_leaf, l);
+
+	  if (ip4_fib_mtrie_leaf_is_next_ply (l))
+	    s = format (s, "\n%U%U",
+			format_white_space, indent + 2,
+			format_ip4_fib_mtrie_ply, m, a,
+			ip4_fib_mtrie_leaf_get_next_ply_index (l),
+			/* dst_address_byte_index */ 2);
+	}
+    }
+
+  return s;
+}
+
 u8 * format_ip4_fib_mtrie (u8 * s, va_list * va)
 {
   ip4_fib_mtrie_t * m = va_arg (*va, ip4_fib_mtrie_t *);
 
-  s = format (s, "%d plies, memory usage %U",
+  s = format (s, "%U stride, %d plies, memory usage %U",
+	      format_ip4_fib_mtrie_stride, ip4_fib_mtrie_get_stride (m),
 	      pool_elts (m->ply_pool),
 	      format_memory_size, mtrie_memory_usage (m, 0));
 
-  if (pool_elts (m->ply_pool) > 0)
+  if (m->root_16)
+    s = format (s, "\n  %U", format_ip4_fib_mtrie_16_ply, m);
+  else if (pool_elts (m->ply_pool) > 0)
     {
       ip4_address_t base_address;
       base_address.as_u32 = 0;
@@ -528,3 +781,34 @@ u8 * format_ip4_fib_mtrie (u8 * s, va_list * va)
 
   return s;
 }
+
+u8 * format_ip4_fib_mtrie_stride (u8 * s, va_list * va)
+{
+  ip4_fib_mtrie_stride_t stride = va_arg (*va, ip4_fib_mtrie_stride_t);
+  char * t = 0;
+
+  switch (stride)
+    {
+#define _(n,f) case IP4_FIB_MTRIE_STRIDE_##n: t = f; break;
+      foreach_ip4_fib_mtrie_stride
+#undef _
+    default:
+      return format (s, "unknown %d", stride);
+    }
+
+  return format (s, "%s", t);
+}
+
+uword unformat_ip4_fib_mtrie_stride (unformat_input_t * input, va_list * va)
+{
+  ip4_fib_mtrie_stride_t * stride = va_arg (*va, ip4_fib_mtrie_stride_t *);
+
+  if (0) ;
+#define _(n,f) else if (unformat (input, f)) *stride = IP4_FIB_MTRIE_STRIDE_##n;
+  foreach_ip4_fib_mtrie_stride
+#undef _
+  else
+    return 0;
+
+  return 1;
+}
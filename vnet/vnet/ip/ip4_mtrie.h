@@ -45,7 +45,7 @@
 #include <vnet/ip/lookup.h>
 #include <vnet/ip/ip4_packet.h>	/* for ip4_address_t */
 
-/* ip4 fib leafs: 4 ply 8-8-8-8 mtrie.
+/* ip4 fib leafs: 4 ply 8-8-8-8 mtrie, or 3 ply 16-8-8 mtrie.
    1 + 2*adj_index for terminal leaves.
    0 + 2*next_ply_index for non-terminals.
    1 => empty (adjacency index of zero is special miss adjacency). */
@@ -118,15 +118,42 @@ typedef struct {
 _Static_assert(0  == sizeof(ip4_fib_mtrie_ply_t) % CLIB_CACHE_LINE_BYTES,
 	       "IP4 Mtrie ply cache line");
 
+/* Root ply of the 16-8-8 mtrie, indexed by the first 2 address bytes
+   in host byte order.  Its sub plies are 8 bit plies for byte 2. */
 typedef struct {
-  /* Pool of plies.  Index zero is root ply. */
+  ip4_fib_mtrie_leaf_t leaves[1 << 16];
+
+  /* Prefix length for terminal leaves. */
+  u8 dst_address_bits_of_leaves[1 << 16];
+} ip4_fib_mtrie_16_ply_t;
+
+#define foreach_ip4_fib_mtrie_stride		\
+  _ (8_8_8_8, "8-8-8-8")			\
+  _ (16_8_8, "16-8-8")
+
+typedef enum {
+#define _(n,s) IP4_FIB_MTRIE_STRIDE_##n,
+  foreach_ip4_fib_mtrie_stride
+#undef _
+} ip4_fib_mtrie_stride_t;
+
+typedef struct {
+  /* Pool of plies.  Index zero is root ply of the 8-8-8-8 mtrie;
+     it stays allocated, but empty, in the 16-8-8 mtrie. */
   ip4_fib_mtrie_ply_t * ply_pool;
 
+  /* Root ply of the 16-8-8 mtrie, zero for the 8-8-8-8 mtrie. */
+  ip4_fib_mtrie_16_ply_t * root_16;
+
   /* Special case leaf for default route 0.0.0.0/0. */
   ip4_fib_mtrie_leaf_t default_leaf;
 } ip4_fib_mtrie_t;
 
-void ip4_fib_mtrie_init (ip4_fib_mtrie_t * m);
+always_inline ip4_fib_mtrie_stride_t
+ip4_fib_mtrie_get_stride (ip4_fib_mtrie_t * m)
+{
+  return m->root_16 ? IP4_FIB_MTRIE_STRIDE_16_8_8 : IP4_FIB_MTRIE_STRIDE_8_8_8_8;
+}
 
 struct ip4_fib_t;
 
@@ -136,12 +163,29 @@ void ip4_fib_mtrie_add_del_route (struct ip4_fib_t * f,
 				  u32 adj_index,
 				  u32 is_del);
 
+/* Sets or unsets a route of dst_address_length bits, dst_address is
+   n_address_bytes long and masked, in network byte order.  Used by the ip4
+   and ip6 mtries.  Unset only clears the leaves of the route, the caller
+   re-adds the next less specific route, if any. */
+void ip_fib_mtrie_add_del_route (ip4_fib_mtrie_t * m,
+				 const u8 * dst_address,
+				 u32 n_address_bytes,
+				 u32 dst_address_length,
+				 u32 adj_index,
+				 u32 is_del);
+
 /* Returns adjacency index. */
 u32 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst);
 
 format_function_t format_ip4_fib_mtrie;
-
-/* Lookup step.  Processes 1 byte of 4 byte ip4 address. */
+format_function_t format_ip4_fib_mtrie_leaf;
+format_function_t format_ip4_fib_mtrie_stride;
+unformat_function_t unformat_ip4_fib_mtrie_stride;
+
+/* Lookup step.  Processes 1 byte of 4 byte ip4 address.
+   The 16-8-8 mtrie processes bytes 0 and 1 in step 0, step 1 is a no-op.
+   Callers pass constant byte indices, so the stride check costs a single
+   test of m->root_16 in steps 0 and 1. */
 always_inline ip4_fib_mtrie_leaf_t
 ip4_fib_mtrie_lookup_step (ip4_fib_mtrie_t * m,
 			   ip4_fib_mtrie_leaf_t current_leaf,
@@ -150,7 +194,16 @@ ip4_fib_mtrie_lookup_step (ip4_fib_mtrie_t * m,
 {
   ip4_fib_mtrie_leaf_t next_leaf;
   ip4_fib_mtrie_ply_t * ply;
-  uword current_is_terminal = ip4_fib_mtrie_leaf_is_terminal (current_leaf);
+  uword current_is_terminal;
+
+  if (dst_address_byte_index < 2 && m->root_16)
+    {
+      if (dst_address_byte_index == 1)
+	return current_leaf;
+      return m->root_16->leaves[clib_net_to_host_u32 (dst_address->as_u32) >> 16];
+    }
+
+  current_is_terminal = ip4_fib_mtrie_leaf_is_terminal (current_leaf);
 
   ply = m->ply_pool + (current_is_terminal ? 0 : (current_leaf >> 1));
   next_leaf = ply->leaves[dst_address->as_u8[dst_address_byte_index]];
@@ -159,4 +212,18 @@ ip4_fib_mtrie_lookup_step (ip4_fib_mtrie_t * m,
   return next_leaf;
 }
 
+/* Prefetch the root ply leaf of a lookup, ahead of ip4_fib_mtrie_lookup_step
+   at byte 0. */
+always_inline void
+ip4_fib_mtrie_prefetch_root (ip4_fib_mtrie_t * m,
+			     const ip4_address_t * dst_address)
+{
+  if (m->root_16)
+    CLIB_PREFETCH (&m->root_16->leaves[clib_net_to_host_u32 (dst_address->as_u32) >> 16],
+		   sizeof (ip4_fib_mtrie_leaf_t), LOAD);
+  else
+    CLIB_PREFETCH (&m->ply_pool[0].leaves[dst_address->as_u8[0]],
+		   sizeof (ip4_fib_mtrie_leaf_t), LOAD);
+}
+
 #endif /* included_ip_ip4_fib_h */
@@ -14,6 +14,7 @@
  */
 #include <vnet/ip/ip.h>
 #include <vnet/ethernet/ethernet.h>
+#include <vnet/fib/ip4_fib.h>
 
 /* 
  * ip4 FIB tester. Add, probe, delete a bunch of
@@ -142,7 +143,7 @@ thrash (vlib_main_t * vm,
     }
 
   /* Find or create FIB table 11 */
-  fib = ip4_fib_find_or_create_fib_by_table_id (table_id);
+  fib = ip4_fib_get (ip4_fib_table_find_or_create_and_lock (table_id));
 
   for (i = tm->test_interfaces_created; i < ninterfaces; i++)
     {
@@ -164,7 +165,7 @@ thrash (vlib_main_t * vm,
       hw = vnet_get_hw_interface (vnm, hw_if_index);
       vec_validate (im->fib_index_by_sw_if_index, hw->sw_if_index);
       im->fib_index_by_sw_if_index[hw->sw_if_index] = fib->index;
-      ip4_sw_interface_enable_disable(sw_if_index, 1);
+      ip4_sw_interface_enable_disable(hw->sw_if_index, 1);
     }
 
   tm->test_interfaces_created = ninterfaces;
@@ -304,6 +305,170 @@ VLIB_CLI_COMMAND (test_route_command, static) = {
     .function = thrash,
 };
 
+/*
+ * mtrie lookup benchmark. Fills an 8-8-8-8 and a 16-8-8 mtrie with the
+ * same random routes, mostly /24s like an Internet table, checks that
+ * both return the same adjacencies for random destinations, before and
+ * after deleting half of the routes, and times the lookups.
+ *
+ * The mtries belong to scratch FIBs without prefix hash tables: deletes
+ * don't restore less specific routes, in both mtries alike.
+ */
+static u64
+test_mtrie_lookups (ip4_fib_mtrie_t * m, ip4_address_t * dsts, u32 * adjs)
+{
+  ip4_fib_mtrie_leaf_t leaf0, leaf1;
+  u64 t;
+  u32 i;
+
+  t = clib_cpu_time_now ();
+
+  /* Two at a time, like ip4_lookup_inline */
+  for (i = 0; i + 1 < vec_len (dsts); i += 2)
+    {
+      leaf0 = leaf1 = IP4_FIB_MTRIE_LEAF_ROOT;
+
+      leaf0 = ip4_fib_mtrie_lookup_step (m, leaf0, &dsts[i], 0);
+      leaf1 = ip4_fib_mtrie_lookup_step (m, leaf1, &dsts[i+1], 0);
+
+      leaf0 = ip4_fib_mtrie_lookup_step (m, leaf0, &dsts[i], 1);
+      leaf1 = ip4_fib_mtrie_lookup_step (m, leaf1, &dsts[i+1], 1);
+
+      leaf0 = ip4_fib_mtrie_lookup_step (m, leaf0, &dsts[i], 2);
+      leaf1 = ip4_fib_mtrie_lookup_step (m, leaf1, &dsts[i+1], 2);
+
+      leaf0 = ip4_fib_mtrie_lookup_step (m, leaf0, &dsts[i], 3);
+      leaf1 = ip4_fib_mtrie_lookup_step (m, leaf1, &dsts[i+1], 3);
+
+      leaf0 = (leaf0 == IP4_FIB_MTRIE_LEAF_EMPTY ? m->default_leaf : leaf0);
+      leaf1 = (leaf1 == IP4_FIB_MTRIE_LEAF_EMPTY ? m->default_leaf : leaf1);
+
+      adjs[i] = leaf0;
+      adjs[i+1] = leaf1;
+    }
+
+  return clib_cpu_time_now () - t;
+}
+
+static clib_error_t *
+test_mtrie (vlib_main_t * vm,
+            unformat_input_t * input, vlib_cli_command_t * cmd_arg)
+{
+  u32 seed = 0xdeaddabe;
+  u32 nroutes = 500000;
+  u32 nlookups = 1 << 22;
+  ip4_fib_t fibs[2];
+  ip4_address_t *dsts = 0, *addresses = 0;
+  u32 *widths = 0, *adjs[2] = { 0 };
+  u32 i, pass, s, tmp, n_bad = 0;
+  u64 clocks;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "seed %d", &seed))
+        ;
+      else if (unformat (input, "nroutes %d", &nroutes))
+        ;
+      else if (unformat (input, "nlookups %d", &nlookups))
+        ;
+      else
+        return clib_error_return (0, "unknown input `%U'",
+                                  format_unformat_error, input);
+    }
+
+  if (nroutes == 0 || nlookups < 2)
+    return clib_error_return (0, "nroutes and nlookups must be > 0");
+
+  vec_validate (addresses, nroutes - 1);
+  vec_validate (widths, nroutes - 1);
+  for (i = 0; i < nroutes; i++)
+    {
+      if (random_f64 (&seed) < 0.6)
+        widths[i] = 24;
+      else
+        widths[i] = 8 + random_u32 (&seed) % 25;
+      tmp = random_u32 (&seed) & clib_net_to_host_u32 (ip4_main.fib_masks[widths[i]]);
+      addresses[i].as_u32 = clib_host_to_net_u32 (tmp);
+    }
+
+  /* Destinations inside random routes, so all mtrie levels get used */
+  vec_validate (dsts, nlookups - 1);
+  for (i = 0; i < nlookups; i++)
+    {
+      u32 r = random_u32 (&seed) % nroutes;
+      tmp = random_u32 (&seed) & ~ip4_main.fib_masks[widths[r]];
+      dsts[i].as_u32 = addresses[r].as_u32 | tmp;
+    }
+
+  for (s = 0; s < ARRAY_LEN (fibs); s++)
+    {
+      memset (&fibs[s], 0, sizeof (fibs[s]));
+      ip4_mtrie_init_with_stride (&fibs[s].mtrie, s == 0 ?
+                                  IP4_FIB_MTRIE_STRIDE_8_8_8_8 :
+                                  IP4_FIB_MTRIE_STRIDE_16_8_8);
+      vec_validate (adjs[s], nlookups - 1);
+      for (i = 0; i < nroutes; i++)
+        ip4_fib_mtrie_add_del_route (&fibs[s], addresses[i], widths[i],
+                                     1 + i, /* is_del */ 0);
+    }
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (s = 0; s < ARRAY_LEN (fibs); s++)
+        {
+          /* Warm up the caches, then time */
+          test_mtrie_lookups (&fibs[s].mtrie, dsts, adjs[s]);
+          clocks = test_mtrie_lookups (&fibs[s].mtrie, dsts, adjs[s]);
+
+          vlib_cli_output (vm, "%U: %d routes, %d plies, %.2f clocks/lookup",
+                           format_ip4_fib_mtrie_stride,
+                           ip4_fib_mtrie_get_stride (&fibs[s].mtrie),
+                           pass ? nroutes - (nroutes + 1) / 2 : nroutes,
+                           pool_elts (fibs[s].mtrie.ply_pool),
+                           (f64) clocks / (nlookups & ~1));
+        }
+
+      for (i = 0; i < (nlookups & ~1); i++)
+        if (adjs[0][i] != adjs[1][i]
+            || (ip4_fib_mtrie_leaf_is_terminal (adjs[0][i])
+                && ip4_mtrie_lookup_address (&fibs[1].mtrie, dsts[i])
+                != ip4_fib_mtrie_leaf_get_adj_index (adjs[0][i])))
+          {
+            if (n_bad++ < 10)
+              vlib_cli_output (vm, "FAIL: %U: 8-8-8-8 %U, 16-8-8 %U",
+                               format_ip4_address, &dsts[i],
+                               format_ip4_fib_mtrie_leaf, adjs[0][i],
+                               format_ip4_fib_mtrie_leaf, adjs[1][i]);
+          }
+
+      /* Delete every other route for the second pass */
+      for (s = 0; pass == 0 && s < ARRAY_LEN (fibs); s++)
+        for (i = 0; i < nroutes; i += 2)
+          ip4_fib_mtrie_add_del_route (&fibs[s], addresses[i], widths[i],
+                                       1 + i, /* is_del */ 1);
+    }
+
+  if (n_bad == 0)
+    vlib_cli_output (vm, "PASS");
+
+  for (s = 0; s < ARRAY_LEN (fibs); s++)
+    {
+      ip4_mtrie_free (&fibs[s].mtrie);
+      vec_free (adjs[s]);
+    }
+  vec_free (addresses);
+  vec_free (widths);
+  vec_free (dsts);
+
+  return 0;
+}
+
+VLIB_CLI_COMMAND (test_mtrie_command, static) = {
+    .path = "test ip4 mtrie",
+    .short_help = "test ip4 mtrie [seed <n>] [nroutes <n>] [nlookups <n>]",
+    .function = test_mtrie,
+};
+
 clib_error_t *test_route_init (vlib_main_t *vm)
 {
   return 0;
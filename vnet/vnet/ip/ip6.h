@@ -44,6 +44,7 @@
 #include <vlib/buffer.h>
 #include <vnet/ethernet/packet.h>
 #include <vnet/ip/ip6_packet.h>
+#include <vnet/ip/ip6_mtrie.h>
 #include <vnet/ip/ip6_hop_by_hop_packet.h>
 #include <vnet/ip/lookup.h>
 #include <vnet/ip/ip_feature_registration.h>
@@ -72,6 +73,9 @@ typedef struct {
 
   /* flow hash configuration */
   flow_hash_config_t flow_hash_config;
+
+  /* Optional mtrie for fast lookups, shadowing the forwarding hash */
+  ip6_fib_mtrie_t mtrie;
 } ip6_fib_t;
 
 struct ip6_main_t;
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ip6 mtrie: the ip4 16-8-8 mtrie with 16 byte addresses. The plies are
+ * set and unset by ip4_mtrie.c.
+ */
+
+#include <vnet/ip/ip.h>
+#include <vnet/ip/ip6_mtrie.h>
+
+void
+ip6_fib_mtrie_add_del_route (ip6_fib_mtrie_t * m,
+			     const ip6_address_t * dst_address,
+			     u32 dst_address_length, u32 adj_index, u32 is_del)
+{
+  ip6_address_t *mask = &ip6_main.fib_masks[dst_address_length];
+  ip6_address_t masked;
+
+  ASSERT (dst_address_length <= 128);
+
+  /* Honor dst_address_length. Fib masks are in network byte order */
+  masked.as_u64[0] = dst_address->as_u64[0] & mask->as_u64[0];
+  masked.as_u64[1] = dst_address->as_u64[1] & mask->as_u64[1];
+
+  ip_fib_mtrie_add_del_route (m, masked.as_u8, sizeof (masked),
+			      dst_address_length, adj_index, is_del);
+}
+
+void
+ip6_fib_mtrie_init (ip6_fib_mtrie_t * m)
+{
+  ip4_mtrie_init_with_stride (m, IP4_FIB_MTRIE_STRIDE_16_8_8);
+}
+
+void
+ip6_fib_mtrie_free (ip6_fib_mtrie_t * m)
+{
+  ip4_mtrie_free (m);
+}
+
+u8 *
+format_ip6_fib_mtrie (u8 * s, va_list * va)
+{
+  ip6_fib_mtrie_t *m = va_arg (*va, ip6_fib_mtrie_t *);
+  uword i, n_root_leaves = 0;
+
+  if (!ip6_fib_mtrie_is_enabled (m))
+    return format (s, "mtrie not in use");
+
+  for (i = 0; i < ARRAY_LEN (m->root_16->leaves); i++)
+    n_root_leaves += !ip4_fib_mtrie_leaf_is_empty (m->root_16->leaves[i]);
+
+  return format (s, "mtrie: %d non-empty root leaves, %d plies, "
+		 "memory usage %U", n_root_leaves, pool_elts (m->ply_pool),
+		 format_memory_size,
+		 sizeof (m->root_16[0]) + pool_elts (m->ply_pool) *
+		 sizeof (m->ply_pool[0]));
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_ip_ip6_mtrie_h
+#define included_ip_ip6_mtrie_h
+
+#include <vnet/ip/ip4_mtrie.h>
+#include <vnet/ip/ip6_packet.h>
+
+/*
+ * ip6 16-8-8-...-8 mtrie: a 64K entry root ply for the first 2 address
+ * bytes, then one 8 bit ply per byte. A lookup takes 1 read per 8 bits of
+ * the longest matching prefix beyond /16: 5 reads for a /48, against one
+ * hash probe per prefix length present in the hash tables.
+ *
+ * This is the ip4 16-8-8 mtrie, used with 16 byte addresses. Ply 0 stays
+ * allocated and empty, as in the ip4 one. The mtrie is an optional
+ * forwarding structure of an ip6 FIB table, next to the forwarding hash
+ * table which stays the reference.
+ */
+typedef ip4_fib_mtrie_leaf_t ip6_fib_mtrie_leaf_t;
+
+/* root_16 is zero when the mtrie is not in use */
+typedef ip4_fib_mtrie_t ip6_fib_mtrie_t;
+
+always_inline int
+ip6_fib_mtrie_is_enabled (ip6_fib_mtrie_t * m)
+{
+  return m->root_16 != 0;
+}
+
+void ip6_fib_mtrie_init (ip6_fib_mtrie_t * m);
+void ip6_fib_mtrie_free (ip6_fib_mtrie_t * m);
+
+/*
+ * Delete only clears the leaves of the route, the caller re-adds the next
+ * less specific route, if any.
+ */
+void ip6_fib_mtrie_add_del_route (ip6_fib_mtrie_t * m,
+				  const ip6_address_t * dst_address,
+				  u32 dst_address_length,
+				  u32 adj_index, u32 is_del);
+
+format_function_t format_ip6_fib_mtrie;
+
+/* Returns the adjacency (load balance) index, 0 on a miss */
+always_inline u32
+ip6_fib_mtrie_lookup (ip6_fib_mtrie_t * m, const ip6_address_t * dst)
+{
+  ip6_fib_mtrie_leaf_t leaf;
+  u32 i;
+
+  leaf = m->root_16->leaves[clib_net_to_host_u16 (dst->as_u16[0])];
+
+  /* plies of the last byte only have terminal leaves */
+  for (i = 2; !ip4_fib_mtrie_leaf_is_terminal (leaf); i++)
+    leaf = m->ply_pool[leaf >> 1].leaves[dst->as_u8[i]];
+
+  leaf = (leaf == IP4_FIB_MTRIE_LEAF_EMPTY ? m->default_leaf : leaf);
+
+  return ip4_fib_mtrie_leaf_get_adj_index (leaf);
+}
+
+#endif /* included_ip_ip6_mtrie_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/ip/ip.h>
+#include <vnet/fib/ip6_fib.h>
+
+/*
+ * ip6 FIB lookup benchmark. Fills a scratch table with a synthetic BGP
+ * table, then times lookups of random destinations inside its routes, in
+ * the forwarding hash and in the mtrie. Half of the routes are added
+ * before the mtrie is built, the other half after, then half of them are
+ * deleted, and each time the mtrie has to agree with the hash.
+ *
+ * The routes go straight into the forwarding table, there are no FIB
+ * entries behind them.
+ */
+
+/* Prefix length distribution of a synthetic BGP table, in per mille */
+/* *INDENT-OFF* */
+static const struct
+{
+  u8 length;
+  u16 per_mille;
+} ip6_test_lengths[] = {
+  { 19, 2 }, { 20, 3 }, { 22, 3 }, { 24, 5 }, { 28, 10 }, { 29, 45 },
+  { 30, 5 }, { 31, 3 }, { 32, 120 }, { 33, 8 }, { 34, 8 }, { 35, 5 },
+  { 36, 40 }, { 38, 10 }, { 40, 60 }, { 42, 15 }, { 44, 70 }, { 45, 10 },
+  { 46, 25 }, { 47, 25 }, { 48, 500 }, { 56, 10 }, { 64, 18 },
+};
+/* *INDENT-ON* */
+
+typedef struct
+{
+  ip6_address_t address;
+  u32 length;
+  u32 pad;
+} ip6_test_route_t;
+
+static u32
+ip6_test_random_length (u32 * seed)
+{
+  u32 i, r = random_u32 (seed) % 1000;
+
+  for (i = 0; i < ARRAY_LEN (ip6_test_lengths) - 1; i++)
+    {
+      if (r < ip6_test_lengths[i].per_mille)
+	break;
+      r -= ip6_test_lengths[i].per_mille;
+    }
+  return ip6_test_lengths[i].length;
+}
+
+static void
+ip6_test_add_del (u32 fib_index, ip6_test_route_t * r, u32 lbi, int is_add)
+{
+  dpo_id_t dpo = DPO_NULL;
+
+  dpo.dpoi_index = lbi;
+  if (is_add)
+    ip6_fib_table_fwding_dpo_update (fib_index, &r->address, r->length,
+				     &dpo);
+  else
+    ip6_fib_table_fwding_dpo_remove (fib_index, &r->address, r->length,
+				     &dpo);
+}
+
+static u64
+ip6_test_random_u64 (u32 * seed)
+{
+  return ((u64) random_u32 (seed) << 32) | random_u32 (seed);
+}
+
+static u64
+ip6_test_lookups (u32 fib_index, ip6_address_t * dsts, u32 * lbis)
+{
+  ip6_main_t *im = &ip6_main;
+  u64 t;
+  u32 i;
+
+  t = clib_cpu_time_now ();
+
+  /* Two at a time, like ip6_lookup_inline */
+  for (i = 0; i + 1 < vec_len (dsts); i += 2)
+    {
+      lbis[i] = ip6_fib_table_fwding_lookup (im, fib_index, &dsts[i]);
+      lbis[i + 1] = ip6_fib_table_fwding_lookup (im, fib_index, &dsts[i + 1]);
+    }
+
+  return clib_cpu_time_now () - t;
+}
+
+/*
+ * Times the lookups in the mtrie, as it is, then in the hash. Returns the
+ * number of mismatches. The mtrie is disabled on return.
+ */
+static u32
+ip6_test_compare (vlib_main_t * vm, u32 fib_index, ip6_address_t * dsts,
+		  u32 ** lbis, u32 n_routes)
+{
+  ip6_fib_t *fib = ip6_fib_get (fib_index);
+  u32 i, s, n_bad = 0;
+  u64 clocks[2];
+
+  vlib_cli_output (vm, "%d routes, %U", n_routes,
+		   format_ip6_fib_mtrie, &fib->mtrie);
+
+  /* lbis[0] from the hash, lbis[1] from the mtrie */
+  for (s = 2; s-- > 0;)
+    {
+      /* Warm up the caches, then time */
+      ip6_test_lookups (fib_index, dsts, lbis[s]);
+      clocks[s] = ip6_test_lookups (fib_index, dsts, lbis[s]);
+
+      ip6_fib_table_enable_disable_mtrie (fib_index, 0);
+    }
+
+  vlib_cli_output (vm, "  hash %.2f, mtrie %.2f clocks/lookup",
+		   (f64) clocks[0] / (vec_len (dsts) & ~1),
+		   (f64) clocks[1] / (vec_len (dsts) & ~1));
+
+  for (i = 0; i < (vec_len (dsts) & ~1); i++)
+    if (lbis[0][i] != lbis[1][i] && n_bad++ < 10)
+      vlib_cli_output (vm, "FAIL: %U: hash %d, mtrie %d",
+		       format_ip6_address, &dsts[i], lbis[0][i], lbis[1][i]);
+
+  return n_bad;
+}
+
+static clib_error_t *
+test_ip6_mtrie (vlib_main_t * vm,
+		unformat_input_t * input, vlib_cli_command_t * cmd_arg)
+{
+  ip6_main_t *im = &ip6_main;
+  u32 seed = 0xdeaddabe;
+  u32 nroutes = 200000;
+  u32 nlookups = 1 << 21;
+  u32 table_id = 11;
+  ip6_test_route_t *routes = 0, *r;
+  ip6_address_t *dsts = 0, *mask;
+  u32 *lbis[2] = { 0 }, *short_routes = 0;
+  u32 fib_index, i, n_bad = 0;
+  uword *unique;
+  u64 t;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "seed %d", &seed))
+	;
+      else if (unformat (input, "nroutes %d", &nroutes))
+	;
+      else if (unformat (input, "nlookups %d", &nlookups))
+	;
+      else if (unformat (input, "table %d", &table_id))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  if (nroutes < 2 || nlookups < 2)
+    return clib_error_return (0, "nroutes and nlookups must be > 1");
+
+  if (~0 != ip6_fib_index_from_table_id (table_id))
+    return clib_error_return (0, "table %d exists, use another table",
+			      table_id);
+
+  /* Routes in 2000::/3, longer routes mostly inside shorter ones */
+  vec_validate (routes, nroutes - 1);
+  unique = hash_create_mem (nroutes, sizeof (routes[0]), sizeof (uword));
+  for (i = 0; i < nroutes; i++)
+    {
+      r = &routes[i];
+      r->length = ip6_test_random_length (&seed);
+      r->address.as_u64[0] = ip6_test_random_u64 (&seed);
+      r->address.as_u64[1] = ip6_test_random_u64 (&seed);
+      r->address.as_u8[0] = 0x20 | (r->address.as_u8[0] & 0x1f);
+
+      if (r->length > 32 && vec_len (short_routes) && random_u32 (&seed) & 3)
+	{
+	  ip6_test_route_t *parent;
+
+	  parent = &routes[short_routes[random_u32 (&seed)
+					% vec_len (short_routes)]];
+	  mask = &im->fib_masks[parent->length];
+	  r->address.as_u64[0] = (parent->address.as_u64[0]
+				  | (r->address.as_u64[0] & ~mask->as_u64[0]));
+	}
+
+      mask = &im->fib_masks[r->length];
+      r->address.as_u64[0] &= mask->as_u64[0];
+      r->address.as_u64[1] &= mask->as_u64[1];
+
+      if (hash_get_mem (unique, r))
+	{
+	  i--;
+	  continue;
+	}
+      hash_set_mem (unique, r, i);
+      if (r->length <= 32)
+	vec_add1 (short_routes, i);
+    }
+  hash_free (unique);
+  vec_free (short_routes);
+
+  /* Destinations inside random routes */
+  vec_validate (dsts, nlookups - 1);
+  for (i = 0; i < nlookups; i++)
+    {
+      r = &routes[random_u32 (&seed) % nroutes];
+      mask = &im->fib_masks[r->length];
+      dsts[i].as_u64[0] = (r->address.as_u64[0]
+			   | (ip6_test_random_u64 (&seed) & ~mask->as_u64[0]));
+      dsts[i].as_u64[1] = (r->address.as_u64[1]
+			   | (ip6_test_random_u64 (&seed) & ~mask->as_u64[1]));
+    }
+  vec_validate (lbis[0], nlookups - 1);
+  vec_validate (lbis[1], nlookups - 1);
+
+  fib_index = ip6_fib_table_find_or_create_and_lock (table_id);
+
+  /* First half in the hash only, then build the mtrie */
+  for (i = 0; i < nroutes / 2; i++)
+    ip6_test_add_del (fib_index, &routes[i], 1 + i, /* is_add */ 1);
+
+  t = clib_cpu_time_now ();
+  ip6_fib_table_enable_disable_mtrie (fib_index, 1);
+  vlib_cli_output (vm, "mtrie of %d routes built in %.3f seconds",
+		   nroutes / 2, (clib_cpu_time_now () - t)
+		   * vm->clib_time.seconds_per_clock);
+
+  /* Second half in both */
+  for (; i < nroutes; i++)
+    ip6_test_add_del (fib_index, &routes[i], 1 + i, /* is_add */ 1);
+
+  n_bad += ip6_test_compare (vm, fib_index, dsts, lbis, nroutes);
+
+  /* Rebuild the mtrie, then delete every other route from both */
+  ip6_fib_table_enable_disable_mtrie (fib_index, 1);
+  for (i = 0; i < nroutes; i += 2)
+    ip6_test_add_del (fib_index, &routes[i], 1 + i, /* is_add */ 0);
+
+  n_bad += ip6_test_compare (vm, fib_index, dsts, lbis, nroutes / 2);
+
+  if (n_bad == 0)
+    vlib_cli_output (vm, "PASS");
+
+  for (i = 1; i < nroutes; i += 2)
+    ip6_test_add_del (fib_index, &routes[i], 1 + i, /* is_add */ 0);
+  fib_table_unlock (fib_index, FIB_PROTOCOL_IP6);
+
+  vec_free (routes);
+  vec_free (dsts);
+  vec_free (lbis[0]);
+  vec_free (lbis[1]);
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_ip6_mtrie_command, static) = {
+  .path = "test ip6 mtrie",
+  .short_help = "test ip6 mtrie [seed <n>] [nroutes <n>] [nlookups <n>] "
+                "[table <n>]",
+  .function = test_ip6_mtrie,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
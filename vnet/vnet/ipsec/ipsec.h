@@ -307,40 +307,6 @@ ipsec_alloc_empty_buffers (vlib_main_t * vm, ipsec_main_t * im)
     }
 }
 
-static_always_inline u32	/* FIXME move to interface???.h */
-get_next_output_feature_node_index (vnet_main_t * vnm, vlib_buffer_t * b)
-{
-  vlib_main_t *vm = vlib_get_main ();
-  vlib_node_t *node;
-  u32 r;
-  intf_output_feat_t next_feature;
-
-  u8 *node_names[] = {
-#define _(sym, str) (u8 *) str,
-    foreach_intf_output_feat
-#undef _
-  };
-
-  count_trailing_zeros (next_feature,
-			vnet_buffer (b)->output_features.bitmap);
-
-  if (next_feature >= INTF_OUTPUT_FEAT_DONE)
-    {
-      u32 sw_if_index = vnet_buffer (b)->sw_if_index[VLIB_TX];
-      vnet_hw_interface_t *hw = vnet_get_sup_hw_interface (vnm, sw_if_index);
-      r = hw->output_node_index;
-    }
-  else
-    {
-      vnet_buffer (b)->output_features.bitmap &= ~(1 << next_feature);
-      /* FIXME */
-      node = vlib_get_node_by_name (vm, node_names[next_feature]);
-      r = node->index;
-    }
-
-  return r;
-}
-
 /*
  * fd.io coding-style-patch-verification: ON
  *
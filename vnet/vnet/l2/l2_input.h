@@ -114,7 +114,7 @@ l2input_bd_config_from_index (l2input_main_t * l2im, u32 bd_index)
  _(ACL,           "l2-input-acl")               \
  _(QOS,           "feature-bitmap-drop")        \
  _(CFM,           "feature-bitmap-drop")        \
- _(SPAN,          "feature-bitmap-drop")        \
+ _(SPAN,          "span-l2-input")              \
  _(POLICER_CLAS,  "l2-policer-classify")	\
  _(INPUT_CLASSIFY, "l2-input-classify")
 
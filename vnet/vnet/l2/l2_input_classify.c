@@ -158,6 +158,11 @@ l2_input_classify_node_fn (vlib_main_t * vm,
   u32 chain_hits = 0;
   f64 now;
   u32 n_next_nodes;
+  vnet_classify_table_t *tables[VLIB_FRAME_SIZE];
+  u8 *headers[VLIB_FRAME_SIZE];
+  u64 hashes[VLIB_FRAME_SIZE];
+  vnet_classify_entry_t *entries[VLIB_FRAME_SIZE];
+  u32 i;
 
   n_next_nodes = node->n_next_nodes;
 
@@ -166,112 +171,33 @@ l2_input_classify_node_fn (vlib_main_t * vm,
   n_left_from = frame->n_vectors;
   from = vlib_frame_vector_args (frame);
 
-  /* First pass: compute hash */
+  /* First pass: gather the tables, then hash and probe the whole frame */
 
-  while (n_left_from > 2)
-    {
-      vlib_buffer_t *b0, *b1;
-      u32 bi0, bi1;
-      ethernet_header_t *h0, *h1;
-      u32 sw_if_index0, sw_if_index1;
-      u16 type0, type1;
-      int type_index0, type_index1;
-      vnet_classify_table_t *t0, *t1;
-      u32 table_index0, table_index1;
-      u64 hash0, hash1;
-
-
-      /* prefetch next iteration */
-      {
-	vlib_buffer_t *p1, *p2;
-
-	p1 = vlib_get_buffer (vm, from[1]);
-	p2 = vlib_get_buffer (vm, from[2]);
-
-	vlib_prefetch_buffer_header (p1, STORE);
-	CLIB_PREFETCH (p1->data, CLIB_CACHE_LINE_BYTES, STORE);
-	vlib_prefetch_buffer_header (p2, STORE);
-	CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
-      }
-
-      bi0 = from[0];
-      b0 = vlib_get_buffer (vm, bi0);
-      h0 = vlib_buffer_get_current (b0);
-
-      bi1 = from[1];
-      b1 = vlib_get_buffer (vm, bi1);
-      h1 = vlib_buffer_get_current (b1);
-
-      sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
-      vnet_buffer (b0)->l2_classify.table_index = ~0;
-
-      sw_if_index1 = vnet_buffer (b1)->sw_if_index[VLIB_RX];
-      vnet_buffer (b1)->l2_classify.table_index = ~0;
-
-      /* Select classifier table based on ethertype */
-      type0 = clib_net_to_host_u16 (h0->type);
-      type1 = clib_net_to_host_u16 (h1->type);
-
-      type_index0 = (type0 == ETHERNET_TYPE_IP4)
-	? L2_INPUT_CLASSIFY_TABLE_IP4 : L2_INPUT_CLASSIFY_TABLE_OTHER;
-      type_index0 = (type0 == ETHERNET_TYPE_IP6)
-	? L2_INPUT_CLASSIFY_TABLE_IP6 : type_index0;
-
-      type_index1 = (type1 == ETHERNET_TYPE_IP4)
-	? L2_INPUT_CLASSIFY_TABLE_IP4 : L2_INPUT_CLASSIFY_TABLE_OTHER;
-      type_index1 = (type1 == ETHERNET_TYPE_IP6)
-	? L2_INPUT_CLASSIFY_TABLE_IP6 : type_index1;
-
-      vnet_buffer (b0)->l2_classify.table_index =
-	table_index0 =
-	rt->l2cm->classify_table_index_by_sw_if_index
-	[type_index0][sw_if_index0];
-
-      if (table_index0 != ~0)
-	{
-	  t0 = pool_elt_at_index (vcm->tables, table_index0);
-
-	  vnet_buffer (b0)->l2_classify.hash = hash0 =
-	    vnet_classify_hash_packet (t0, (u8 *) h0);
-	  vnet_classify_prefetch_bucket (t0, hash0);
-	}
-
-      vnet_buffer (b1)->l2_classify.table_index =
-	table_index1 =
-	rt->l2cm->classify_table_index_by_sw_if_index
-	[type_index1][sw_if_index1];
-
-      if (table_index1 != ~0)
-	{
-	  t1 = pool_elt_at_index (vcm->tables, table_index1);
-
-	  vnet_buffer (b1)->l2_classify.hash = hash1 =
-	    vnet_classify_hash_packet (t1, (u8 *) h1);
-	  vnet_classify_prefetch_bucket (t1, hash1);
-	}
-
-      from += 2;
-      n_left_from -= 2;
-    }
-
-  while (n_left_from > 0)
+  for (i = 0; i < n_left_from; i++)
     {
       vlib_buffer_t *b0;
-      u32 bi0;
       ethernet_header_t *h0;
       u32 sw_if_index0;
       u16 type0;
       u32 type_index0;
-      vnet_classify_table_t *t0;
       u32 table_index0;
-      u64 hash0;
 
-      bi0 = from[0];
-      b0 = vlib_get_buffer (vm, bi0);
+      /* prefetch next iteration */
+      if (PREDICT_TRUE (i + 2 < n_left_from))
+	{
+	  vlib_buffer_t *p2;
+
+	  p2 = vlib_get_buffer (vm, from[i + 2]);
+
+	  vlib_prefetch_buffer_header (p2, STORE);
+	  CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
+	}
+
+      b0 = vlib_get_buffer (vm, from[i]);
       h0 = vlib_buffer_get_current (b0);
+      headers[i] = (u8 *) h0;
 
       sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
-      vnet_buffer (b0)->l2_classify.table_index = ~0;
 
       /* Select classifier table based on ethertype */
       type0 = clib_net_to_host_u16 (h0->type);
@@ -285,21 +211,25 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	table_index0 = rt->l2cm->classify_table_index_by_sw_if_index
 	[type_index0][sw_if_index0];
 
-      if (table_index0 != ~0)
-	{
-	  t0 = pool_elt_at_index (vcm->tables, table_index0);
-
-	  vnet_buffer (b0)->l2_classify.hash = hash0 =
-	    vnet_classify_hash_packet (t0, (u8 *) h0);
-	  vnet_classify_prefetch_bucket (t0, hash0);
-	}
-      from++;
-      n_left_from--;
+      tables[i] = (table_index0 != ~0)
+	? pool_elt_at_index (vcm->tables, table_index0) : 0;
     }
 
+  vnet_classify_hash_packets_inline (tables, headers, hashes, n_left_from);
+
+  for (i = 0; i < n_left_from; i++)
+    if (tables[i])
+      vnet_buffer (vlib_get_buffer (vm, from[i]))->l2_classify.hash =
+	hashes[i];
+
+  vnet_classify_find_entries_inline (tables, headers, hashes, entries,
+				     n_left_from, now);
+  vnet_classify_find_chain_entries_inline (vcm, tables, headers, entries,
+					   n_left_from, now);
+
   next_index = node->cached_next_index;
-  from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
+  i = 0;
 
   while (n_left_from > 0)
     {
@@ -313,33 +243,10 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  u32 bi0;
 	  vlib_buffer_t *b0;
 	  u32 next0 = ~0;	/* next l2 input feature, please... */
-	  ethernet_header_t *h0;
 	  u32 table_index0;
-	  u64 hash0;
 	  vnet_classify_table_t *t0;
 	  vnet_classify_entry_t *e0;
 
-	  if (PREDICT_TRUE (n_left_from > 2))
-	    {
-	      vlib_buffer_t *p2 = vlib_get_buffer (vm, from[2]);
-	      u64 phash2;
-	      u32 table_index2;
-	      vnet_classify_table_t *tp2;
-
-	      /*
-	       * Prefetch table entry two ahead. Buffer / data
-	       * were prefetched above...
-	       */
-	      table_index2 = vnet_buffer (p2)->l2_classify.table_index;
-
-	      if (PREDICT_TRUE (table_index2 != ~0))
-		{
-		  tp2 = pool_elt_at_index (vcm->tables, table_index2);
-		  phash2 = vnet_buffer (p2)->l2_classify.hash;
-		  vnet_classify_prefetch_entry (tp2, phash2);
-		}
-	    }
-
 	  /* speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
 	  to_next[0] = bi0;
@@ -349,9 +256,10 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  n_left_to_next -= 1;
 
 	  b0 = vlib_get_buffer (vm, bi0);
-	  h0 = vlib_buffer_get_current (b0);
 	  table_index0 = vnet_buffer (b0)->l2_classify.table_index;
-	  e0 = 0;
+	  t0 = tables[i];
+	  e0 = entries[i];
+	  i++;
 	  vnet_buffer (b0)->l2_classify.opaque_index = ~0;
 
 	  /* Remove ourself from the feature bitmap */
@@ -361,52 +269,21 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  /* save for next feature graph nodes */
 	  vnet_buffer (b0)->l2.feature_bitmap = feature_bitmap;
 
-	  if (PREDICT_TRUE (table_index0 != ~0))
+	  if (e0)
+	    {
+	      vnet_buffer (b0)->l2_classify.opaque_index = e0->opaque_index;
+	      vlib_buffer_advance (b0, e0->advance);
+	      next0 = (e0->next_index < n_next_nodes) ?
+		e0->next_index : next0;
+	      hits++;
+	      if (t0 - vcm->tables != table_index0)
+		chain_hits++;
+	    }
+	  else if (PREDICT_TRUE (t0 != 0))
 	    {
-	      hash0 = vnet_buffer (b0)->l2_classify.hash;
-	      t0 = pool_elt_at_index (vcm->tables, table_index0);
-
-	      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-	      if (e0)
-		{
-		  vnet_buffer (b0)->l2_classify.opaque_index
-		    = e0->opaque_index;
-		  vlib_buffer_advance (b0, e0->advance);
-		  next0 = (e0->next_index < n_next_nodes) ?
-		    e0->next_index : next0;
-		  hits++;
-		}
-	      else
-		{
-		  while (1)
-		    {
-		      if (t0->next_table_index != ~0)
-			t0 = pool_elt_at_index (vcm->tables,
-						t0->next_table_index);
-		      else
-			{
-			  next0 = (t0->miss_next_index < n_next_nodes) ?
-			    t0->miss_next_index : next0;
-			  misses++;
-			  break;
-			}
-
-		      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-		      e0 =
-			vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-		      if (e0)
-			{
-			  vnet_buffer (b0)->l2_classify.opaque_index
-			    = e0->opaque_index;
-			  vlib_buffer_advance (b0, e0->advance);
-			  next0 = (e0->next_index < n_next_nodes) ?
-			    e0->next_index : next0;
-			  hits++;
-			  chain_hits++;
-			  break;
-			}
-		    }
-		}
+	      next0 = (t0->miss_next_index < n_next_nodes) ?
+		t0->miss_next_index : next0;
+	      misses++;
 	    }
 
 	  if (PREDICT_FALSE (next0 == 0))
@@ -569,6 +569,11 @@ policer_classify_inline (vlib_main_t * vm,
   u32 chain_hits = 0;
   u32 drop = 0;
   u32 n_next_nodes;
+  vnet_classify_table_t * tables[VLIB_FRAME_SIZE];
+  u8 * headers[VLIB_FRAME_SIZE];
+  u64 hashes[VLIB_FRAME_SIZE];
+  vnet_classify_entry_t * entries[VLIB_FRAME_SIZE];
+  u32 i;
   u64 time_in_policer_periods;
 
   time_in_policer_periods =
@@ -579,95 +584,48 @@ policer_classify_inline (vlib_main_t * vm,
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
 
-  /* First pass: compute hashes */
-  while (n_left_from > 2)
+  /* First pass: gather the tables, then hash and probe the whole frame */
+  for (i = 0; i < n_left_from; i++)
     {
-      vlib_buffer_t * b0, * b1;
-      u32 bi0, bi1;
-      u8 * h0, * h1;
-      u32 sw_if_index0, sw_if_index1;
-      u32 table_index0, table_index1;
-      vnet_classify_table_t * t0, * t1;
+      vlib_buffer_t * b0;
+      u32 sw_if_index0;
+      u32 table_index0;
 
       /* Prefetch next iteration */
-      {
-        vlib_buffer_t * p1, * p2;
-
-        p1 = vlib_get_buffer (vm, from[1]);
-        p2 = vlib_get_buffer (vm, from[2]);
+      if (PREDICT_TRUE (i + 2 < n_left_from))
+        {
+          vlib_buffer_t * p2;
 
-        vlib_prefetch_buffer_header (p1, STORE);
-        CLIB_PREFETCH (p1->data, CLIB_CACHE_LINE_BYTES, STORE);
-        vlib_prefetch_buffer_header (p2, STORE);
-        CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
-      }
+          p2 = vlib_get_buffer (vm, from[i + 2]);
 
-      bi0 = from[0];
-      b0 = vlib_get_buffer (vm, bi0);
-      h0 = b0->data;
+          vlib_prefetch_buffer_header (p2, STORE);
+          CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
+        }
 
-      bi1 = from[1];
-      b1 = vlib_get_buffer (vm, bi1);
-      h1 = b1->data;
+      b0 = vlib_get_buffer (vm, from[i]);
+      headers[i] = b0->data;
 
       sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
       table_index0 = pcm->classify_table_index_by_sw_if_index[tid][sw_if_index0];
 
-      sw_if_index1 = vnet_buffer (b1)->sw_if_index[VLIB_RX];
-      table_index1 = pcm->classify_table_index_by_sw_if_index[tid][sw_if_index1];
-
-      t0 = pool_elt_at_index (vcm->tables, table_index0);
-
-      t1 = pool_elt_at_index (vcm->tables, table_index1);
-
-      vnet_buffer(b0)->l2_classify.hash =
-        vnet_classify_hash_packet (t0, (u8 *) h0);
-
-      vnet_classify_prefetch_bucket (t0, vnet_buffer(b0)->l2_classify.hash);
-
-      vnet_buffer(b1)->l2_classify.hash =
-        vnet_classify_hash_packet (t1, (u8 *) h1);
-
-      vnet_classify_prefetch_bucket (t1, vnet_buffer(b1)->l2_classify.hash);
-
+      tables[i] = (table_index0 != ~0)
+        ? pool_elt_at_index (vcm->tables, table_index0) : 0;
       vnet_buffer(b0)->l2_classify.table_index = table_index0;
-
-      vnet_buffer(b1)->l2_classify.table_index = table_index1;
-
-      from += 2;
-      n_left_from -= 2;
     }
 
-  while (n_left_from > 0)
-    {
-      vlib_buffer_t * b0;
-      u32 bi0;
-      u8 * h0;
-      u32 sw_if_index0;
-      u32 table_index0;
-      vnet_classify_table_t * t0;
-
-      bi0 = from[0];
-      b0 = vlib_get_buffer (vm, bi0);
-      h0 = b0->data;
-
-      sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
-      table_index0 = pcm->classify_table_index_by_sw_if_index[tid][sw_if_index0];
-
-      t0 = pool_elt_at_index (vcm->tables, table_index0);
-      vnet_buffer(b0)->l2_classify.hash =
-        vnet_classify_hash_packet (t0, (u8 *) h0);
+  vnet_classify_hash_packets_inline (tables, headers, hashes, n_left_from);
 
-      vnet_buffer(b0)->l2_classify.table_index = table_index0;
-      vnet_classify_prefetch_bucket (t0, vnet_buffer(b0)->l2_classify.hash);
+  for (i = 0; i < n_left_from; i++)
+    vnet_buffer(vlib_get_buffer (vm, from[i]))->l2_classify.hash = hashes[i];
 
-      from++;
-      n_left_from--;
-    }
+  vnet_classify_find_entries_inline (tables, headers, hashes, entries,
+                                     n_left_from, now);
+  vnet_classify_find_chain_entries_inline (vcm, tables, headers, entries,
+                                           n_left_from, now);
 
   next_index = node->cached_next_index;
-  from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
+  i = 0;
 
   while (n_left_from > 0)
     {
@@ -681,31 +639,10 @@ policer_classify_inline (vlib_main_t * vm,
           u32 bi0;
           vlib_buffer_t * b0;
           u32 next0 = POLICER_CLASSIFY_NEXT_INDEX_DROP;
-          u32 table_index0;
           vnet_classify_table_t * t0;
           vnet_classify_entry_t * e0;
-          u64 hash0;
-          u8 * h0;
           u8 act0;
 
-          /* Stride 3 seems to work best */
-          if (PREDICT_TRUE (n_left_from > 3))
-            {
-              vlib_buffer_t * p1 = vlib_get_buffer(vm, from[3]);
-              vnet_classify_table_t * tp1;
-              u32 table_index1;
-              u64 phash1;
-
-              table_index1 = vnet_buffer(p1)->l2_classify.table_index;
-
-              if (PREDICT_TRUE (table_index1 != ~0))
-                {
-                  tp1 = pool_elt_at_index (vcm->tables, table_index1);
-                  phash1 = vnet_buffer(p1)->l2_classify.hash;
-                  vnet_classify_prefetch_entry (tp1, phash1);
-                }
-            }
-
           /* Speculatively enqueue b0 to the current next frame */
           bi0 = from[0];
           to_next[0] = bi0;
@@ -715,10 +652,9 @@ policer_classify_inline (vlib_main_t * vm,
           n_left_to_next -= 1;
 
           b0 = vlib_get_buffer (vm, bi0);
-          h0 = b0->data;
-          table_index0 = vnet_buffer(b0)->l2_classify.table_index;
-          e0 = 0;
-          t0 = 0;
+          t0 = tables[i];
+          e0 = entries[i];
+          i++;
 
           if (tid == POLICER_CLASSIFY_TABLE_L2)
             {
@@ -736,65 +672,28 @@ policer_classify_inline (vlib_main_t * vm,
 
           vnet_buffer(b0)->l2_classify.opaque_index = ~0;
 
-          if (PREDICT_TRUE(table_index0 != ~0))
+          if (e0)
             {
-              hash0 = vnet_buffer(b0)->l2_classify.hash;
-              t0 = pool_elt_at_index (vcm->tables, table_index0);
-              e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-
-              if (e0)
-                {
-                  act0 = vnet_policer_police(vm,
-                                             b0,
-                                             e0->next_index,
-                                             time_in_policer_periods,
-                                             e0->opaque_index);
-                  if (PREDICT_FALSE(act0 == SSE2_QOS_ACTION_DROP))
-                    {
-                      next0 = POLICER_CLASSIFY_NEXT_INDEX_DROP;
-                      b0->error = node->errors[POLICER_CLASSIFY_ERROR_DROP];
-                      drop++;
-                    }
-                  hits++;
-                }
-              else
+              act0 = vnet_policer_police(vm,
+                                         b0,
+                                         e0->next_index,
+                                         time_in_policer_periods,
+                                         e0->opaque_index);
+              if (PREDICT_FALSE(act0 == SSE2_QOS_ACTION_DROP))
                 {
-                  while (1)
-                    {
-                      if (PREDICT_TRUE(t0->next_table_index != ~0))
-                        {
-                          t0 = pool_elt_at_index (vcm->tables,
-                                                  t0->next_table_index);
-                        }
-                      else
-                        {
-                          next0 = (t0->miss_next_index < n_next_nodes)?
-                                   t0->miss_next_index:next0;
-                          misses++;
-                          break;
-                        }
-
-                      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-                      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-                      if (e0)
-                        {
-                          act0 = vnet_policer_police(vm,
-                                                     b0,
-                                                     e0->next_index,
-                                                     time_in_policer_periods,
-                                                     e0->opaque_index);
-                          if (PREDICT_FALSE(act0 == SSE2_QOS_ACTION_DROP))
-                            {
-                              next0 = POLICER_CLASSIFY_NEXT_INDEX_DROP;
-                              b0->error = node->errors[POLICER_CLASSIFY_ERROR_DROP];
-                              drop++;
-                            }
-                          hits++;
-                          chain_hits++;
-                          break;
-                        }
-                    }
+                  next0 = POLICER_CLASSIFY_NEXT_INDEX_DROP;
+                  b0->error = node->errors[POLICER_CLASSIFY_ERROR_DROP];
+                  drop++;
                 }
+              hits++;
+              if (t0 - vcm->tables != vnet_buffer(b0)->l2_classify.table_index)
+                chain_hits++;
+            }
+          else if (PREDICT_TRUE(t0 != 0))
+            {
+              next0 = (t0->miss_next_index < n_next_nodes)?
+                       t0->miss_next_index:next0;
+              misses++;
             }
           if (PREDICT_FALSE((node->flags & VLIB_NODE_FLAG_TRACE)
                             && (b0->flags & VLIB_BUFFER_IS_TRACED)))
@@ -117,8 +117,6 @@
 /* End of constants copied from sse_ipe_desc_fmt.h */
 
 /* Misc Policer specific definitions */
-#define SSE2_QOS_POLICER_FIXED_PKT_SIZE    256
-
 // TODO check what can be provided by hw macro based on ASIC
 #define SSE2_QOS_POL_TICKS_PER_SEC     1000LL /* 1 tick = 1 ms */
 
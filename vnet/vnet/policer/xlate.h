@@ -47,6 +47,9 @@ typedef enum {
     SSE2_QOS_ROUND_INVALID
 } sse2_qos_round_type_en;
 
+/* Packet size used to translate pps rates to byte rates */
+#define SSE2_QOS_POLICER_FIXED_PKT_SIZE    256
+
 /*
  * edt: * enum
  *  Enum used to define type of rate for configuration, either pps or kbps.
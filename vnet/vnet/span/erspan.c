@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vppinfra/error.h>
+#include <vnet/fib/ip4_fib.h>
+
+#include <vnet/span/span.h>
+#include <vnet/span/erspan.h>
+
+#define foreach_erspan_tx_error                     \
+_(ENCAPSULATED, "good packets encapsulated")        \
+_(DELETED, "tunnel deleted, mirrors dropped")
+
+typedef enum
+{
+#define _(sym,str) ERSPAN_TX_ERROR_##sym,
+  foreach_erspan_tx_error
+#undef _
+    ERSPAN_TX_N_ERROR,
+} erspan_tx_error_t;
+
+static char *erspan_tx_error_strings[] = {
+#define _(sym,string) string,
+  foreach_erspan_tx_error
+#undef _
+};
+
+typedef struct
+{
+  u32 tunnel_index;
+  u32 session_id;
+  u32 sequence;
+} erspan_encap_trace_t;
+
+static u8 *
+format_erspan_encap_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  erspan_encap_trace_t *t = va_arg (*args, erspan_encap_trace_t *);
+
+  s = format (s, "ERSPAN-ENCAP: tunnel %d session-id %d sequence %u",
+	      t->tunnel_index, t->session_id, t->sequence);
+  return s;
+}
+
+u8 *
+format_erspan_tunnel (u8 * s, va_list * args)
+{
+  erspan_tunnel_t *t = va_arg (*args, erspan_tunnel_t *);
+  erspan_main_t *em = &erspan_main;
+
+  s = format (s, "[%d] %U (src) %U (dst) type %d session-id %d "
+	      "encap_fib_index %d sequence %u",
+	      t - em->tunnels,
+	      format_ip4_address, &t->src,
+	      format_ip4_address, &t->dst,
+	      t->type, t->session_id, t->encap_fib_index, t->sequence);
+  return s;
+}
+
+static u8 *
+format_erspan_name (u8 * s, va_list * args)
+{
+  u32 dev_instance = va_arg (*args, u32);
+  return format (s, "erspan_tunnel%d", dev_instance);
+}
+
+static clib_error_t *
+erspan_interface_admin_up_down (vnet_main_t * vnm, u32 hw_if_index,
+				u32 flags)
+{
+  if (flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)
+    vnet_hw_interface_set_flags (vnm, hw_if_index,
+				 VNET_HW_INTERFACE_FLAG_LINK_UP);
+  else
+    vnet_hw_interface_set_flags (vnm, hw_if_index, 0);
+
+  return /* no error */ 0;
+}
+
+/* *INDENT-OFF* */
+VNET_HW_INTERFACE_CLASS (erspan_hw_class) = {
+  .name = "ERSPAN",
+};
+/* *INDENT-ON* */
+
+/*
+ * Precompute the outer IPv4, GRE and ERSPAN headers of a tunnel.
+ * The IPv4 length is left 0, the encap node adds the packet length to
+ * it and updates the checksum incrementally.
+ */
+static void
+erspan_rewrite (erspan_tunnel_t * t)
+{
+  u8 *rw = 0;
+  ip4_header_t *ip0;
+  erspan_gre_header_t *gre0;
+  int len = t->type == ERSPAN_TYPE_II ?
+    sizeof (ip4_erspan2_header_t) : sizeof (ip4_erspan3_header_t);
+
+  vec_validate_aligned (rw, len - 1, CLIB_CACHE_LINE_BYTES);
+
+  ip0 = (ip4_header_t *) rw;
+  ip0->ip_version_and_header_length = 0x45;
+  ip0->ttl = 254;
+  ip0->protocol = IP_PROTOCOL_GRE;
+  ip0->src_address.as_u32 = t->src.as_u32;
+  ip0->dst_address.as_u32 = t->dst.as_u32;
+  ip0->checksum = ip4_header_checksum (ip0);
+
+  gre0 = (erspan_gre_header_t *) (ip0 + 1);
+  gre0->flags_and_version = clib_host_to_net_u16 (GRE_FLAGS_SEQUENCE);
+
+  switch (t->type)
+    {
+#define _(n,sym,proto) case ERSPAN_TYPE_##sym:                  \
+      gre0->protocol = clib_host_to_net_u16 (proto);            \
+      break;
+      foreach_erspan_type
+#undef _
+    }
+
+  if (t->type == ERSPAN_TYPE_II)
+    {
+      erspan2_header_t *e0 = (erspan2_header_t *) (gre0 + 1);
+      e0->ver_vlan = clib_host_to_net_u16 (ERSPAN_VERSION_II << 12);
+      e0->cos_en_t_session_id =
+	clib_host_to_net_u16 (ERSPAN_EN_VLAN_PRESERVED | t->session_id);
+    }
+  else
+    {
+      /* timestamp granularity 0, 100 microseconds */
+      erspan3_header_t *e0 = (erspan3_header_t *) (gre0 + 1);
+      e0->ver_vlan = clib_host_to_net_u16 (ERSPAN_VERSION_III << 12);
+      e0->cos_bso_t_session_id = clib_host_to_net_u16 (t->session_id);
+    }
+
+  t->rewrite = rw;
+}
+
+/*
+ * Wrap one packet in the outer headers of its tunnel: a single copy of
+ * the precomputed rewrite, then the per packet fields.
+ */
+static_always_inline void
+erspan_encap_one (vlib_main_t * vm, vlib_node_runtime_t * node,
+		  erspan_main_t * em, erspan_tunnel_t * t0,
+		  vlib_buffer_t * b0, u32 timestamp)
+{
+  u32 len0 = vlib_buffer_length_in_chain (vm, b0);
+  u32 rw_len0 = vec_len (t0->rewrite);
+  ip4_header_t *ip0;
+  erspan_gre_header_t *gre0;
+  erspan2_header_t *e0;
+  ip_csum_t sum0;
+  u16 new_l0;
+  u32 seq0;
+
+  vlib_buffer_advance (b0, -(word) rw_len0);
+  ip0 = vlib_buffer_get_current (b0);
+  clib_memcpy (ip0, t0->rewrite, rw_len0);
+
+  /* old length always 0, see the rewrite setup */
+  new_l0 = clib_host_to_net_u16 (len0 + rw_len0);
+  sum0 = ip_csum_update (ip0->checksum, 0, new_l0, ip4_header_t,
+			 length /* changed member */ );
+  ip0->checksum = ip_csum_fold (sum0);
+  ip0->length = new_l0;
+
+  /* sequence numbers are per tunnel, whichever thread mirrors */
+  gre0 = (erspan_gre_header_t *) (ip0 + 1);
+  seq0 = __sync_fetch_and_add (&t0->sequence, 1);
+  gre0->sequence = clib_host_to_net_u32 (seq0);
+
+  /* the truncated bit is at the same place in type II and III headers */
+  e0 = (erspan2_header_t *) (gre0 + 1);
+  if (PREDICT_FALSE ((b0->flags & VLIB_NODE_FLAG_IS_SPAN)
+		     && vnet_buffer (b0)->span.orig_length > len0))
+    e0->cos_en_t_session_id |= clib_host_to_net_u16 (ERSPAN_TRUNCATED);
+
+  if (t0->type == ERSPAN_TYPE_III)
+    ((erspan3_header_t *) e0)->timestamp = clib_host_to_net_u32 (timestamp);
+
+  /* look the analyzer up in the encap FIB */
+  vnet_buffer (b0)->sw_if_index[VLIB_TX] = t0->encap_fib_index;
+
+  if (PREDICT_FALSE (b0->flags & VLIB_BUFFER_IS_TRACED))
+    {
+      erspan_encap_trace_t *tr = vlib_add_trace (vm, node, b0, sizeof (*tr));
+      tr->tunnel_index = t0 - em->tunnels;
+      tr->session_id = t0->session_id;
+      tr->sequence = seq0;
+    }
+}
+
+/*
+ * TX function of the erspan_tunnel interfaces: encapsulate the frame
+ * and hand it to ip4-lookup.
+ */
+static uword
+erspan_interface_tx (vlib_main_t * vm,
+		     vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  erspan_main_t *em = &erspan_main;
+  vnet_interface_output_runtime_t *rd = (void *) node->runtime_data;
+  /* hw interfaces are reused, so their dev_instance may have changed */
+  vnet_hw_interface_t *hi = vnet_get_hw_interface (em->vnet_main,
+						   rd->hw_if_index);
+  u32 n_left_from, *from, *to_next;
+  erspan_tunnel_t *t;
+  vlib_frame_t *f;
+  u32 timestamp;
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+
+  /* frames still pending when the tunnel was deleted */
+  if (PREDICT_FALSE (pool_is_free_index (em->tunnels, hi->dev_instance)))
+    {
+      vlib_buffer_free (vm, from, n_left_from);
+      vlib_error_count (vm, node->node_index, ERSPAN_TX_ERROR_DELETED,
+			n_left_from);
+      return n_left_from;
+    }
+
+  t = pool_elt_at_index (em->tunnels, hi->dev_instance);
+
+  /* one timestamp per frame is well within the 100us granularity */
+  timestamp = (u32) (vlib_time_now (vm) * 1e4);
+
+  while (n_left_from >= 4)
+    {
+      vlib_buffer_t *b0, *b1;
+
+      /* Prefetch next iteration. */
+      {
+	vlib_buffer_t *p2, *p3;
+
+	p2 = vlib_get_buffer (vm, from[2]);
+	p3 = vlib_get_buffer (vm, from[3]);
+
+	vlib_prefetch_buffer_header (p2, LOAD);
+	vlib_prefetch_buffer_header (p3, LOAD);
+
+	CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
+	CLIB_PREFETCH (p3->data, CLIB_CACHE_LINE_BYTES, STORE);
+      }
+
+      b0 = vlib_get_buffer (vm, from[0]);
+      b1 = vlib_get_buffer (vm, from[1]);
+
+      erspan_encap_one (vm, node, em, t, b0, timestamp);
+      erspan_encap_one (vm, node, em, t, b1, timestamp);
+
+      from += 2;
+      n_left_from -= 2;
+    }
+
+  while (n_left_from > 0)
+    {
+      vlib_buffer_t *b0;
+
+      b0 = vlib_get_buffer (vm, from[0]);
+      erspan_encap_one (vm, node, em, t, b0, timestamp);
+
+      from += 1;
+      n_left_from -= 1;
+    }
+
+  f = vlib_get_frame_to_node (vm, ip4_lookup_node.index);
+  to_next = vlib_frame_vector_args (f);
+  clib_memcpy (to_next, vlib_frame_vector_args (frame),
+	       frame->n_vectors * sizeof (u32));
+  f->n_vectors = frame->n_vectors;
+  vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       ERSPAN_TX_ERROR_ENCAPSULATED,
+			       frame->n_vectors);
+
+  return frame->n_vectors;
+}
+
+/* *INDENT-OFF* */
+VNET_DEVICE_CLASS (erspan_device_class,static) = {
+  .name = "ERSPAN",
+  .format_device_name = format_erspan_name,
+  .format_tx_trace = format_erspan_encap_trace,
+  .tx_function = erspan_interface_tx,
+  .tx_function_n_errors = ERSPAN_TX_N_ERROR,
+  .tx_function_error_strings = erspan_tx_error_strings,
+  .admin_up_down_function = erspan_interface_admin_up_down,
+};
+/* *INDENT-ON* */
+
+int
+vnet_erspan_add_del_tunnel (vnet_erspan_add_del_tunnel_args_t * a,
+			    u32 * sw_if_indexp)
+{
+  erspan_main_t *em = &erspan_main;
+  vnet_main_t *vnm = em->vnet_main;
+  erspan_tunnel_t *t;
+  vnet_hw_interface_t *hi;
+  u32 hw_if_index, sw_if_index;
+  uword *p;
+  u64 key;
+
+  key = ((u64) a->dst.as_u32 << 32) | a->session_id;
+  p = hash_get (em->tunnel_index_by_key, key);
+
+  if (a->is_add)
+    {
+      /* adding a tunnel: tunnel must not already exist */
+      if (p)
+	return VNET_API_ERROR_TUNNEL_EXIST;
+
+      if (a->session_id > ERSPAN_MAX_SESSION_ID)
+	return VNET_API_ERROR_INVALID_VALUE;
+
+      if (a->type != ERSPAN_TYPE_II && a->type != ERSPAN_TYPE_III)
+	return VNET_API_ERROR_INVALID_VALUE_2;
+
+      pool_get_aligned (em->tunnels, t, CLIB_CACHE_LINE_BYTES);
+      memset (t, 0, sizeof (*t));
+
+      t->type = a->type;
+      t->session_id = a->session_id;
+      t->src = a->src;
+      t->dst = a->dst;
+      t->encap_fib_index = a->encap_fib_index;
+      erspan_rewrite (t);
+
+      hash_set (em->tunnel_index_by_key, key, t - em->tunnels);
+
+      if (vec_len (em->free_tunnel_hw_if_indices) > 0)
+	{
+	  vnet_interface_main_t *im = &vnm->interface_main;
+	  hw_if_index = vec_pop (em->free_tunnel_hw_if_indices);
+
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	  hi->dev_instance = t - em->tunnels;
+	  hi->hw_instance = hi->dev_instance;
+
+	  /* clear old stats of freed tunnel before reuse */
+	  sw_if_index = hi->sw_if_index;
+	  vnet_interface_counter_lock (im);
+	  vlib_zero_combined_counter
+	    (&im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_TX],
+	     sw_if_index);
+	  vlib_zero_simple_counter
+	    (&im->sw_if_counters[VNET_INTERFACE_COUNTER_DROP], sw_if_index);
+	  vnet_interface_counter_unlock (im);
+	}
+      else
+	{
+	  hw_if_index = vnet_register_interface
+	    (vnm, erspan_device_class.index, t - em->tunnels,
+	     erspan_hw_class.index, t - em->tunnels);
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	}
+
+      t->hw_if_index = hw_if_index;
+      t->sw_if_index = sw_if_index = hi->sw_if_index;
+
+      vnet_sw_interface_set_flags (vnm, sw_if_index,
+				   VNET_SW_INTERFACE_FLAG_ADMIN_UP);
+    }
+  else
+    {
+      /* deleting a tunnel: tunnel must exist */
+      if (!p)
+	return VNET_API_ERROR_NO_SUCH_ENTRY;
+
+      t = pool_elt_at_index (em->tunnels, p[0]);
+      sw_if_index = t->sw_if_index;
+
+      /* the hw interface is reused by the next tunnel */
+      if (span_dst_in_use (sw_if_index))
+	return VNET_API_ERROR_SPAN_DESTINATION_IN_USE;
+
+      vnet_sw_interface_set_flags (vnm, t->sw_if_index, 0 /* down */ );
+      vec_add1 (em->free_tunnel_hw_if_indices, t->hw_if_index);
+
+      hash_unset (em->tunnel_index_by_key, key);
+
+      /*
+       * Free the tunnel while workers are stopped. Frames still pending
+       * to the TX node then find it freed and drop their mirrors.
+       */
+      vlib_worker_thread_barrier_sync (vlib_get_main ());
+      vec_free (t->rewrite);
+      pool_put (em->tunnels, t);
+      vlib_worker_thread_barrier_release (vlib_get_main ());
+    }
+
+  if (sw_if_indexp)
+    *sw_if_indexp = sw_if_index;
+
+  return 0;
+}
+
+static clib_error_t *
+erspan_add_del_tunnel_command_fn (vlib_main_t * vm,
+				  unformat_input_t * input,
+				  vlib_cli_command_t * cmd)
+{
+  erspan_main_t *em = &erspan_main;
+  vnet_erspan_add_del_tunnel_args_t _a, *a = &_a;
+  u8 src_set = 0, dst_set = 0;
+  u32 session_id = ~0;
+  u32 type = ERSPAN_TYPE_II;
+  u32 encap_vrf_id = 0;
+  u32 sw_if_index;
+  int rv;
+
+  memset (a, 0, sizeof (*a));
+  a->is_add = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "src %U", unformat_ip4_address, &a->src))
+	src_set = 1;
+      else if (unformat (input, "dst %U", unformat_ip4_address, &a->dst))
+	dst_set = 1;
+      else if (unformat (input, "session-id %u", &session_id))
+	;
+      else if (unformat (input, "type %u", &type))
+	;
+      else if (unformat (input, "encap-vrf-id %u", &encap_vrf_id))
+	;
+      else if (unformat (input, "del"))
+	a->is_add = 0;
+      else
+	return clib_error_return (0, "parse error: '%U'",
+				  format_unformat_error, input);
+    }
+
+  if (!dst_set)
+    return clib_error_return (0, "tunnel dst address not specified");
+  if (session_id == ~0)
+    return clib_error_return (0, "session-id not specified");
+  if (a->is_add && !src_set)
+    return clib_error_return (0, "tunnel src address not specified");
+
+  a->session_id = session_id > 0xffff ? 0xffff : session_id;
+  a->type = type > 0xff ? 0xff : type;
+  a->encap_fib_index = ip4_fib_index_from_table_id (encap_vrf_id);
+  if (a->encap_fib_index == ~0)
+    return clib_error_return (0, "nonexistent encap-vrf-id %d",
+			      encap_vrf_id);
+
+  rv = vnet_erspan_add_del_tunnel (a, &sw_if_index);
+
+  switch (rv)
+    {
+    case 0:
+      if (a->is_add)
+	vlib_cli_output (vm, "%U\n", format_vnet_sw_if_index_name,
+			 em->vnet_main, sw_if_index);
+      break;
+    case VNET_API_ERROR_TUNNEL_EXIST:
+      return clib_error_return (0, "tunnel already exists...");
+    case VNET_API_ERROR_NO_SUCH_ENTRY:
+      return clib_error_return (0, "tunnel does not exist...");
+    case VNET_API_ERROR_SPAN_DESTINATION_IN_USE:
+      return clib_error_return (0, "tunnel is the destination of a SPAN "
+				"session, disable it first");
+    case VNET_API_ERROR_INVALID_VALUE:
+      return clib_error_return (0, "session-id must be at most %d",
+				ERSPAN_MAX_SESSION_ID);
+    case VNET_API_ERROR_INVALID_VALUE_2:
+      return clib_error_return (0, "type must be 2 or 3");
+    default:
+      return clib_error_return
+	(0, "vnet_erspan_add_del_tunnel returned %d", rv);
+    }
+
+  return 0;
+}
+
+/*?
+ * Create or delete an ERSPAN tunnel, a remote SPAN destination.
+ * Mirrors sent to the erspan_tunnel<n> interface are encapsulated in
+ * IPv4 + GRE + ERSPAN type II or III headers, with a per tunnel GRE
+ * sequence number and, for type III, a 100us timestamp.
+ *
+ * @cliexpar
+ * Example of how to mirror an interface to a remote analyzer:
+ * @cliexcmd{create erspan tunnel src 10.0.3.1 dst 10.0.3.3 session-id 5 type 3}
+ * @cliexcmd{set span src GigabitEthernet0/8/0 dst erspan_tunnel0}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (create_erspan_tunnel_command, static) = {
+  .path = "create erspan tunnel",
+  .short_help =
+  "create erspan tunnel src <local-addr> dst <analyzer-addr> session-id <nn>"
+  " [type 2|3] [encap-vrf-id <nn>] [del]",
+  .function = erspan_add_del_tunnel_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+show_erspan_tunnel_command_fn (vlib_main_t * vm,
+			       unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  erspan_main_t *em = &erspan_main;
+  erspan_tunnel_t *t;
+
+  if (pool_elts (em->tunnels) == 0)
+    vlib_cli_output (vm, "No erspan tunnels configured...");
+
+  /* *INDENT-OFF* */
+  pool_foreach (t, em->tunnels,
+  ({
+    vlib_cli_output (vm, "%U", format_erspan_tunnel, t);
+  }));
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_erspan_tunnel_command, static) = {
+  .path = "show erspan tunnel",
+  .short_help = "show erspan tunnel",
+  .function = show_erspan_tunnel_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+erspan_init (vlib_main_t * vm)
+{
+  erspan_main_t *em = &erspan_main;
+
+  em->tunnel_index_by_key = hash_create (0, sizeof (uword));
+  em->vlib_main = vm;
+  em->vnet_main = vnet_get_main ();
+
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (erspan_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __erspan_h__
+#define __erspan_h__
+
+#include <vnet/vnet.h>
+#include <vnet/ip/ip.h>
+#include <vnet/gre/packet.h>
+
+/*
+ * Remote SPAN destinations: ERSPAN tunnel interfaces. Mirrors sent to an
+ * erspan_tunnel<n> interface are wrapped in IPv4 + GRE + ERSPAN headers
+ * and routed to the analyzer in the tunnel encap FIB.
+ */
+
+#define foreach_erspan_type                     \
+_(2, II, 0x88BE)                                \
+_(3, III, 0x22EB)
+
+typedef enum
+{
+#define _(n,sym,proto) ERSPAN_TYPE_##sym = n,
+  foreach_erspan_type
+#undef _
+} erspan_type_t;
+
+/* ERSPAN session ids are 10 bits wide */
+#define ERSPAN_MAX_SESSION_ID 1023
+
+typedef CLIB_PACKED (struct
+{
+  /* GRE flags and version, only the sequence number bit is set */
+  u16 flags_and_version;
+  u16 protocol;
+  u32 sequence;
+}) erspan_gre_header_t;
+
+/* ERSPAN type II header */
+typedef CLIB_PACKED (struct
+{
+  /* version (4), vlan (12) */
+  u16 ver_vlan;
+  /* cos (3), encapsulation type (2), truncated (1), session id (10) */
+  u16 cos_en_t_session_id;
+  /* reserved (12), port index (20) */
+  u32 index;
+}) erspan2_header_t;
+
+/* ERSPAN type III header, without the optional platform sub-header */
+typedef CLIB_PACKED (struct
+{
+  /* version (4), vlan (12) */
+  u16 ver_vlan;
+  /* cos (3), bad/short/oversized (2), truncated (1), session id (10) */
+  u16 cos_bso_t_session_id;
+  u32 timestamp;
+  u16 sgt;
+  /* platform (1), frame type (5), hardware id (6), direction (1),
+     timestamp granularity (2), optional sub-header (1) */
+  u16 p_ft_hwid_d_gra_o;
+}) erspan3_header_t;
+
+#define ERSPAN_VERSION_II  1
+#define ERSPAN_VERSION_III 2
+#define ERSPAN_TRUNCATED   (1 << 10)
+/* type II: frames are mirrored with their original VLAN tags */
+#define ERSPAN_EN_VLAN_PRESERVED (3 << 11)
+
+typedef CLIB_PACKED (struct
+{
+  ip4_header_t ip4;		/* 20 bytes */
+  erspan_gre_header_t gre;	/* 8 bytes */
+  erspan2_header_t erspan;	/* 8 bytes */
+}) ip4_erspan2_header_t;
+
+typedef CLIB_PACKED (struct
+{
+  ip4_header_t ip4;		/* 20 bytes */
+  erspan_gre_header_t gre;	/* 8 bytes */
+  erspan3_header_t erspan;	/* 12 bytes */
+}) ip4_erspan3_header_t;
+
+typedef struct
+{
+  /* outer headers, precomputed once per tunnel */
+  u8 *rewrite;
+
+  /* GRE sequence number of the next mirror, shared by all threads */
+  volatile u32 sequence;
+
+  u8 type;			/* erspan_type_t */
+  u16 session_id;
+
+  ip4_address_t src;
+  ip4_address_t dst;
+
+  /* tunnel partner IP lookup here */
+  u32 encap_fib_index;
+
+  /* vnet intfc hw/sw_if_index */
+  u32 hw_if_index;
+  u32 sw_if_index;
+} erspan_tunnel_t;
+
+typedef struct
+{
+  /* pool of tunnels */
+  erspan_tunnel_t *tunnels;
+
+  /* tunnel index by dst address and session id */
+  uword *tunnel_index_by_key;
+
+  /* free hw_if_indices of deleted tunnels */
+  u32 *free_tunnel_hw_if_indices;
+
+  /* convenience */
+  vlib_main_t *vlib_main;
+  vnet_main_t *vnet_main;
+} erspan_main_t;
+
+erspan_main_t erspan_main;
+
+typedef struct
+{
+  u8 is_add;
+  u8 type;
+  u16 session_id;
+  ip4_address_t src, dst;
+  u32 encap_fib_index;
+} vnet_erspan_add_del_tunnel_args_t;
+
+int vnet_erspan_add_del_tunnel (vnet_erspan_add_del_tunnel_args_t * a,
+				u32 * sw_if_indexp);
+
+format_function_t format_erspan_tunnel;
+
+#endif /* __erspan_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -18,14 +18,27 @@
 #include <vppinfra/error.h>
 
 #include <vnet/span/span.h>
+#include <vnet/l2/l2_input.h>
+#include <vnet/l2/l2_output.h>
 
 #include <vppinfra/error.h>
 #include <vppinfra/elog.h>
 
 vlib_node_registration_t span_out_node;
+vlib_node_registration_t span_input_node;
+vlib_node_registration_t span_l2_input_node;
+vlib_node_registration_t span_l2_output_node;
 
 #define foreach_span_out_error                      \
-_(HITS, "SPAN outgoing packets processed")
+_(HITS, "SPAN outgoing packets processed")                \
+_(FILTERED, "SPAN outgoing packets missing the classify filter")        \
+_(UNSAMPLED, "SPAN outgoing packets not sampled")
+
+/* same errors as foreach_span_out_error, for span-input */
+#define foreach_span_in_error                       \
+_(HITS, "SPAN incoming packets processed")                \
+_(FILTERED, "SPAN incoming packets missing the classify filter")        \
+_(UNSAMPLED, "SPAN incoming packets not sampled")
 
 typedef enum
 {
@@ -41,43 +54,517 @@ static char *span_out_error_strings[] = {
 #undef _
 };
 
+static char *span_in_error_strings[] = {
+#define _(sym,string) string,
+  foreach_span_in_error
+#undef _
+};
+
+/* originals are handed to their next output feature, not to a next node */
 typedef enum
 {
-  SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-  SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
+  SPAN_OUT_NEXT_DROP,
+  SPAN_OUT_NEXT_MIRROR_INTERFACE_OUTPUT,
   SPAN_OUT_N_NEXT,
 } span_out_next_t;
 
+typedef enum
+{
+  SPAN_IN_NEXT_ETHERNET_INPUT,
+  SPAN_IN_NEXT_MIRROR_INTERFACE_OUTPUT,
+  SPAN_IN_N_NEXT,
+} span_in_next_t;
+
+/* feature nodes are added after these by feat_bitmap_init_next_nodes */
+typedef enum
+{
+  SPAN_L2_NEXT_DROP,
+  SPAN_L2_NEXT_MIRROR_INTERFACE_OUTPUT,
+  SPAN_L2_N_NEXT,
+} span_l2_next_t;
+
+typedef struct
+{
+  /* next nodes of span-l2-input, by l2-input feature */
+  u32 input_feat_next_node_index[32];
+  /* next nodes of span-l2-output, by feature and output interface */
+  l2_output_next_nodes_st output_next_nodes;
+} span_l2_main_t;
+
+static span_l2_main_t span_l2_main;
+
+/* Mirror state shared by all packets of a frame */
+typedef struct
+{
+  /* RX or TX interface the session was resolved for */
+  u32 sw_if_index;
+  /* session of sw_if_index, 0 if it is not mirrored */
+  span_session_t *session;
+  /* mirror buffers allocated up front for the whole frame */
+  span_per_thread_data_t *ptd;
+  u32 n_heads;
+  u32 n_heads_used;
+  /* mirrors collected so far in ptd->mirrors */
+  u32 n_mirrors;
+  /* session the frame was selected for, ptd->match is valid for it */
+  span_session_t *select_session;
+  u32 n_filtered;
+  u32 n_unsampled;
+  f64 now;
+} span_frame_state_t;
+
+/*
+ * Look the session of sw_if_index up. Sessions not mirroring the node
+ * direction, or mirrored by the other kind of node (device or l2), are
+ * ignored, as sub-interfaces of a mirrored interface share its driver
+ * input and interface output nodes.
+ */
+static_always_inline void
+span_frame_resolve (span_frame_state_t * st, u32 sw_if_index, int is_input,
+		    int is_l2)
+{
+  span_session_t *s = get_span_entry (sw_if_index);
+
+  st->sw_if_index = sw_if_index;
+  st->session = (s != 0 && s->is_l2 == is_l2
+		 && (s->direction & (is_input ? SPAN_DIRECTION_RX :
+				     SPAN_DIRECTION_TX))) ? s : 0;
+}
+
+/*
+ * Run the classify filter and sampling of the frame session over the
+ * whole frame, before any mirror buffer is allocated. Returns the number
+ * of packets selected.
+ */
+static_always_inline u32
+span_frame_select (vlib_main_t * vm, span_frame_state_t * st,
+		   u32 * from, u32 n)
+{
+  span_per_thread_data_t *ptd = st->ptd;
+  u32 i;
+
+  vec_validate (ptd->headers, n - 1);
+  vec_validate (ptd->hashes, n - 1);
+  vec_validate (ptd->match, n - 1);
+
+  for (i = 0; i < n; i++)
+    {
+      if (PREDICT_TRUE (i + 4 < n))
+	vlib_prefetch_buffer_header (vlib_get_buffer (vm, from[i + 4]),
+				     LOAD);
+      ptd->headers[i] =
+	vlib_buffer_get_current (vlib_get_buffer (vm, from[i]));
+    }
+
+  st->select_session = st->session;
+  return span_select_packets (st->session, ptd, ptd->headers, n, st->now);
+}
+
+/*
+ * Mirror one packet to all destinations of its session, if it passes
+ * the session filter and sampling. i is the index of the packet in the
+ * frame. *bi0 may be replaced by a new head in clone mode. Sessions are
+ * looked up by RX interface in the input nodes, by TX interface otherwise.
+ */
+static_always_inline void
+span_one (vlib_main_t * vm, vlib_node_runtime_t * node,
+	  span_frame_state_t * st, u32 * bi0, u32 i, int is_input, int is_l2)
+{
+  vlib_buffer_t *b0 = vlib_get_buffer (vm, *bi0);
+  u32 sw_if_index0 =
+    vnet_buffer (b0)->sw_if_index[is_input ? VLIB_RX : VLIB_TX];
+  span_session_t *s0;
+  u32 n_mirrors0 = 0;
+
+  /*
+   * all packets normally share the interface, sub-interfaces and
+   * driver input nodes polling several interfaces don't
+   */
+  if (PREDICT_FALSE (sw_if_index0 != st->sw_if_index))
+    span_frame_resolve (st, sw_if_index0, is_input, is_l2);
+
+  s0 = st->session;
+  if (PREDICT_FALSE (s0 != 0 && span_session_selects (s0)))
+    {
+      span_select_t sel0 = (s0 == st->select_session) ? st->ptd->match[i] :
+	span_select_one (s0, st->ptd, vlib_buffer_get_current (b0), st->now);
+      if (sel0 != SPAN_SELECT_HIT)
+	{
+	  s0 = 0;
+	  st->n_filtered += sel0 == SPAN_SELECT_FILTERED;
+	  st->n_unsampled += sel0 == SPAN_SELECT_UNSAMPLED;
+	}
+    }
+
+  if (PREDICT_TRUE (s0 != 0 && !(b0->flags & VLIB_NODE_FLAG_IS_SPAN)))
+    {
+      span_per_thread_data_t *ptd = st->ptd;
+      span_direction_t dir0 =
+	is_input ? SPAN_DIRECTION_RX : SPAN_DIRECTION_TX;
+      u32 n_used;
+
+      vec_validate (ptd->mirrors, st->n_mirrors + vec_len (s0->dsts) - 1);
+      n_used = span_mirror_buffer (vm, bi0, ptd->heads + st->n_heads_used,
+				   st->n_heads - st->n_heads_used, s0, dir0,
+				   ptd->mirrors + st->n_mirrors,
+				   &n_mirrors0);
+      if (PREDICT_FALSE (n_used == SPAN_MIRROR_NO_BUFFERS))
+	{
+	  /* preallocation exhausted, fall back to per packet allocation */
+	  _vec_len (ptd->mirrors) = st->n_mirrors;
+	  n_mirrors0 = span_duplicate_buffer (vm, bi0, s0, dir0,
+						  &ptd->mirrors);
+	}
+      else
+	st->n_heads_used += n_used;
+      st->n_mirrors += n_mirrors0;
+
+      if (is_input && n_mirrors0)
+	vlib_increment_simple_counter
+	  (vnet_main.interface_main.sw_if_counters +
+	   VNET_INTERFACE_COUNTER_SPAN, os_get_cpu_number (), sw_if_index0,
+	   n_mirrors0);
+    }
+
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    {
+      b0 = vlib_get_buffer (vm, *bi0);
+      if (b0->flags & VLIB_BUFFER_IS_TRACED)
+	{
+	  span_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+	  t->src_sw_if_index = sw_if_index0;
+	  t->mirror_sw_if_index = n_mirrors0 ? s0->dsts[0].sw_if_index : ~0;
+	  t->n_mirrors = n_mirrors0;
+	}
+    }
+}
+
+/*
+ * Resolve the session of the first packet of a frame, select its packets
+ * and allocate the mirror buffers of the whole frame up front.
+ */
+static_always_inline void
+span_frame_init (vlib_main_t * vm, span_frame_state_t * st, u32 * from,
+		 u32 n_left_from, int is_input, int is_l2)
+{
+  span_main_t *sm = &span_main;
+  span_per_thread_data_t *ptd;
+
+  ptd = vec_elt_at_index (sm->per_thread_data, os_get_cpu_number ());
+  st->ptd = ptd;
+  st->n_heads = 0;
+  st->n_heads_used = 0;
+  st->n_mirrors = 0;
+  st->select_session = 0;
+  st->n_filtered = 0;
+  st->n_unsampled = 0;
+  st->now = vlib_time_now (vm);
+
+  /* resolve the mirror destinations once per frame */
+  span_frame_resolve (st, vnet_buffer (vlib_get_buffer (vm, from[0]))->
+		      sw_if_index[is_input ? VLIB_RX : VLIB_TX], is_input,
+		      is_l2);
+  if (PREDICT_TRUE (st->session != 0))
+    {
+      u32 n = n_left_from;
+
+      /* only packets hitting the filter and sampled get mirror buffers */
+      if (PREDICT_FALSE (span_session_selects (st->session)))
+	n = span_frame_select (vm, st, from, n_left_from);
+
+      n *= span_n_heads_per_packet (st->session);
+      if (n)
+	{
+	  vec_validate (ptd->heads, n - 1);
+	  st->n_heads = vlib_buffer_alloc_from_free_list
+	    (vm, ptd->heads, n, span_main.buffer_free_list_index);
+	}
+    }
+  vec_reset_length (ptd->mirrors);
+}
+
+/*
+ * Free the unused mirror buffers of a frame, enqueue its mirrors to
+ * next_index and count them.
+ */
+static_always_inline void
+span_frame_finish (vlib_main_t * vm, vlib_node_runtime_t * node,
+		   span_frame_state_t * st, u32 next_index)
+{
+  span_per_thread_data_t *ptd = st->ptd;
+
+  if (st->n_heads_used < st->n_heads)
+    vlib_buffer_free (vm, ptd->heads + st->n_heads_used,
+		      st->n_heads - st->n_heads_used);
+
+  vlib_buffer_enqueue_to_single_next (vm, node, ptd->mirrors, next_index,
+				      st->n_mirrors);
+
+  vlib_node_increment_counter (vm, node->node_index, SPAN_ERROR_OUT_HITS,
+			       st->n_mirrors);
+  if (PREDICT_FALSE (st->n_filtered))
+    vlib_node_increment_counter (vm, node->node_index,
+				 SPAN_ERROR_OUT_FILTERED, st->n_filtered);
+  if (PREDICT_FALSE (st->n_unsampled))
+    vlib_node_increment_counter (vm, node->node_index,
+				 SPAN_ERROR_OUT_UNSAMPLED, st->n_unsampled);
+}
+
+/*
+ * Hand the originals seen by span-output to their next output feature,
+ * or back to the output node of their interface once no feature is left.
+ */
+static_always_inline void
+span_out_enqueue_originals (vlib_main_t * vm, u32 * buffers, u32 n)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  vlib_frame_t *f = 0;
+  u32 *to_next = 0;
+  u32 next_node_index, last_node_index = ~0;
+
+  while (n > 0)
+    {
+      vlib_buffer_t *b0 = vlib_get_buffer (vm, buffers[0]);
+
+      next_node_index = get_next_output_feature_node_index (vnm, b0);
+      if (PREDICT_FALSE (next_node_index != last_node_index))
+	{
+	  if (f)
+	    vlib_put_frame_to_node (vm, last_node_index, f);
+	  f = vlib_get_frame_to_node (vm, next_node_index);
+	  to_next = vlib_frame_vector_args (f);
+	  last_node_index = next_node_index;
+	}
+
+      to_next[0] = buffers[0];
+      to_next += 1;
+      f->n_vectors += 1;
+
+      buffers += 1;
+      n -= 1;
+    }
+
+  if (f)
+    vlib_put_frame_to_node (vm, last_node_index, f);
+}
+
+static_always_inline uword
+span_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+		  vlib_frame_t * frame, int is_input)
+{
+  u32 n_left_from, *from;
+  u32 originals[VLIB_FRAME_SIZE], *to_next = originals;
+  u32 i = 0;
+  span_frame_state_t st;
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+
+  span_frame_init (vm, &st, from, n_left_from, is_input, 0 /* is_l2 */ );
+
+  while (n_left_from >= 8)
+    {
+      u32 bi0, bi1, bi2, bi3;
+
+      /* Prefetch next iteration. */
+      {
+	vlib_buffer_t *p4, *p5, *p6, *p7;
+
+	p4 = vlib_get_buffer (vm, from[4]);
+	p5 = vlib_get_buffer (vm, from[5]);
+	p6 = vlib_get_buffer (vm, from[6]);
+	p7 = vlib_get_buffer (vm, from[7]);
+
+	vlib_prefetch_buffer_header (p4, LOAD);
+	vlib_prefetch_buffer_header (p5, LOAD);
+	vlib_prefetch_buffer_header (p6, LOAD);
+	vlib_prefetch_buffer_header (p7, LOAD);
+
+	CLIB_PREFETCH (p4->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	CLIB_PREFETCH (p5->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	CLIB_PREFETCH (p6->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	CLIB_PREFETCH (p7->data, CLIB_CACHE_LINE_BYTES, LOAD);
+      }
+
+      bi0 = from[0];
+      bi1 = from[1];
+      bi2 = from[2];
+      bi3 = from[3];
+
+      span_one (vm, node, &st, &bi0, i + 0, is_input, 0);
+      span_one (vm, node, &st, &bi1, i + 1, is_input, 0);
+      span_one (vm, node, &st, &bi2, i + 2, is_input, 0);
+      span_one (vm, node, &st, &bi3, i + 3, is_input, 0);
+
+      /* originals, possibly re-headed by clone mode */
+      to_next[0] = bi0;
+      to_next[1] = bi1;
+      to_next[2] = bi2;
+      to_next[3] = bi3;
+      to_next += 4;
+      i += 4;
+
+      from += 4;
+      n_left_from -= 4;
+    }
+
+  while (n_left_from > 0)
+    {
+      u32 bi0;
+
+      bi0 = from[0];
+      span_one (vm, node, &st, &bi0, i, is_input, 0);
+
+      to_next[0] = bi0;
+      to_next += 1;
+      i += 1;
+
+      from += 1;
+      n_left_from -= 1;
+    }
+
+  if (is_input)
+    vlib_buffer_enqueue_to_single_next (vm, node, originals,
+					SPAN_IN_NEXT_ETHERNET_INPUT,
+					frame->n_vectors);
+  else
+    span_out_enqueue_originals (vm, originals, frame->n_vectors);
+  span_frame_finish (vm, node, &st,
+		     is_input ? SPAN_IN_NEXT_MIRROR_INTERFACE_OUTPUT :
+		     SPAN_OUT_NEXT_MIRROR_INTERFACE_OUTPUT);
+
+  return frame->n_vectors;
+}
+
+/*
+ * TX mirroring: span-output is the SPAN feature of the interface output
+ * feature path, enabled on the interfaces with a TX session.
+ */
 static uword
 span_out_node_fn (vlib_main_t * vm,
 		  vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  span_main_t *sm = &span_main;
-  u32 n_left_from, *from, *to_next, *to_c_next;
-  span_out_next_t next_index;
-  u32 n_span_packets = 0;
+  return span_node_inline (vm, node, frame, 0 /* is_input */ );
+}
+
+/*
+ * RX mirroring for drivers without a span_enable_disable_function:
+ * the driver input node is redirected here, originals continue to
+ * ethernet-input.
+ */
+static uword
+span_input_node_fn (vlib_main_t * vm,
+		    vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return span_node_inline (vm, node, frame, 1 /* is_input */ );
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (span_input_node) = {
+  .function = span_input_node_fn,
+  .name = "span-input",
+  .vector_size = sizeof (u32),
+  .format_trace = format_span_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN (span_in_error_strings),
+  .error_strings = span_in_error_strings,
+
+  .n_next_nodes = SPAN_IN_N_NEXT,
+
+  .next_nodes = {
+    [SPAN_IN_NEXT_ETHERNET_INPUT] = "ethernet-input",
+    [SPAN_IN_NEXT_MIRROR_INTERFACE_OUTPUT] = "interface-output",
+  },
+};
+
+VLIB_NODE_FUNCTION_MULTIARCH (span_input_node, span_input_node_fn)
+
+VLIB_REGISTER_NODE (span_out_node) = {
+  .function = span_out_node_fn,
+  .name = "span-output",
+  .vector_size = sizeof (u32),
+  .format_trace = format_span_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN (span_out_error_strings),
+  .error_strings = span_out_error_strings,
+
+  .n_next_nodes = SPAN_OUT_N_NEXT,
+
+  .next_nodes = {
+    [SPAN_OUT_NEXT_DROP] = "error-drop",
+    [SPAN_OUT_NEXT_MIRROR_INTERFACE_OUTPUT] = "interface-output",
+  },
+};
+
+VLIB_NODE_FUNCTION_MULTIARCH (span_out_node, span_out_node_fn)
+/* *INDENT-ON* */
+
+/*
+ * Next node of a packet seen by span-l2-input or span-l2-output: the
+ * next l2 feature, or the output interface once no feature is left.
+ */
+static_always_inline u32
+span_l2_next (vlib_main_t * vm, vnet_main_t * vnm, vlib_node_runtime_t * node,
+	      vlib_buffer_t * b0, u32 * cached_sw_if_index,
+	      u32 * cached_next_index, int is_input)
+{
+  span_l2_main_t *slm = &span_l2_main;
+  u32 feature_bitmap0, next0;
+
+  if (is_input)
+    {
+      /* Remove ourself from the feature bitmap */
+      feature_bitmap0 =
+	vnet_buffer (b0)->l2.feature_bitmap & ~L2INPUT_FEAT_SPAN;
+      vnet_buffer (b0)->l2.feature_bitmap = feature_bitmap0;
+      return feat_bitmap_get_next_node_index
+	(slm->input_feat_next_node_index, feature_bitmap0);
+    }
+
+  feature_bitmap0 = vnet_buffer (b0)->l2.feature_bitmap & ~L2OUTPUT_FEAT_SPAN;
+  l2_output_dispatch (vm, vnm, node, span_l2_output_node.index,
+		      cached_sw_if_index, cached_next_index,
+		      &slm->output_next_nodes, b0,
+		      vnet_buffer (b0)->sw_if_index[VLIB_TX], feature_bitmap0,
+		      &next0);
+  return next0;
+}
+
+/*
+ * SPAN l2 features: mirror the packets of the interfaces, sub-interfaces
+ * included, which have the SPAN bit set in their l2-input or l2-output
+ * feature bitmap, then hand the originals to the next feature.
+ */
+static_always_inline uword
+span_l2_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+		     vlib_frame_t * frame, int is_input)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 n_left_from, *from, *to_next;
+  u32 next_index, i = 0;
+  u32 cached_sw_if_index = ~0;
+  u32 cached_next_index = ~0;
+  span_frame_state_t st;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
   next_index = node->cached_next_index;
 
+  span_frame_init (vm, &st, from, n_left_from, is_input, 1 /* is_l2 */ );
+
   while (n_left_from > 0)
     {
       u32 n_left_to_next;
-      u32 n_left_to_c_next;
 
       vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
-      vlib_get_next_frame (vm, node, SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-			   to_next, n_left_to_next);
-      vlib_get_next_frame (vm, node, SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-			   to_c_next, n_left_to_c_next);
 
-      while (n_left_from >= 4 && n_left_to_next >= 4 && n_left_to_c_next >= 2)
+      while (n_left_from >= 4 && n_left_to_next >= 2)
 	{
 	  u32 bi0, bi1;
-	  u32 ci0, ci1;
 	  vlib_buffer_t *b0, *b1;
-	  vlib_buffer_t *c0, *c1;
+	  u32 next0, next1;
 
 	  /* Prefetch next iteration. */
 	  {
@@ -89,325 +576,263 @@ span_out_node_fn (vlib_main_t * vm,
 	    vlib_prefetch_buffer_header (p2, LOAD);
 	    vlib_prefetch_buffer_header (p3, LOAD);
 
-	    CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
-	    CLIB_PREFETCH (p3->data, CLIB_CACHE_LINE_BYTES, STORE);
+	    CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	    CLIB_PREFETCH (p3->data, CLIB_CACHE_LINE_BYTES, LOAD);
 	  }
 
-	  /* speculatively enqueue b0 to the current next frame */
-	  to_next[0] = bi0 = from[0];
-	  to_next[1] = bi1 = from[1];
+	  bi0 = from[0];
+	  bi1 = from[1];
+
+	  span_one (vm, node, &st, &bi0, i + 0, is_input, 1);
+	  span_one (vm, node, &st, &bi1, i + 1, is_input, 1);
+
+	  /* originals, possibly re-headed by clone mode */
+	  to_next[0] = bi0;
+	  to_next[1] = bi1;
+	  from += 2;
 	  to_next += 2;
+	  n_left_from -= 2;
 	  n_left_to_next -= 2;
-
-	  if (n_left_to_next == 0)
-	    {
-	      vlib_put_next_frame (vm, node,
-				   SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-				   n_left_to_next);
-	      vlib_get_next_frame (vm, node,
-				   SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-				   to_next, n_left_to_next);
-	    }
+	  i += 2;
 
 	  b0 = vlib_get_buffer (vm, bi0);
 	  b1 = vlib_get_buffer (vm, bi1);
-	  u32 dst_if0 = vnet_buffer (b0)->sw_if_index[VLIB_TX];
-	  u32 dst_if1 = vnet_buffer (b1)->sw_if_index[VLIB_TX];
-      u32 span_if0 = get_span_entry (dst_if0);
-      u32 span_if1 = get_span_entry (dst_if1);
-
-	  // first packet
-	  if (PREDICT_TRUE (span_if0 != ~0))
-	    {
-	      c0 = span_duplicate_buffer (vm, b0, span_if0, 0);
-	      ci0 = vlib_get_buffer_index (vm, c0);
-
-	      to_c_next[0] = ci0;
-	      to_c_next += 1;
-	      n_left_to_c_next -= 1;
-
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (c0->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, c0, sizeof (*t));
-		  t->src_sw_if_index = dst_if0;
-		  t->mirror_sw_if_index = span_if0;
-		}
-
-	      ++n_span_packets;
-	    }
-	  else
-	    {
-	      clib_warning ("SPAN entry not found for this interface!");
-
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (b0->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, b0, sizeof (*t));
-		  t->src_sw_if_index = dst_if0;
-		  t->mirror_sw_if_index = span_if0;
-		}
-	    }
-
-	  // second packet
-	  if (PREDICT_TRUE (span_if1 != ~0))
-	    {
-	      c1 = span_duplicate_buffer (vm, b1, span_if1, 0);
-	      ASSERT (c1 != 0);
-	      ci1 = vlib_get_buffer_index (vm, c1);
-
-	      to_c_next[0] = ci1;
-	      to_c_next += 1;
-	      n_left_to_c_next -= 1;
-
-	      if (n_left_to_c_next == 0)
-		{
-		  vlib_put_next_frame (vm, node,
-				       SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-				       n_left_to_c_next);
-		  vlib_get_next_frame (vm, node,
-				       SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-				       to_c_next, n_left_to_c_next);
-		}
-
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (c1->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, c1, sizeof (*t));
-		  t->src_sw_if_index = dst_if1;
-		  t->mirror_sw_if_index = span_if1;
-		}
-
-	      ++n_span_packets;
-	    }
-	  else
-	    {
-	      clib_warning ("SPAN entry not found for this interface!");
-
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (b1->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, b1, sizeof (*t));
-		  t->src_sw_if_index = dst_if1;
-		  t->mirror_sw_if_index = span_if1;
-		}
-	    }
 
-	  from += 2;
-	  n_left_from -= 2;
+	  next0 = span_l2_next (vm, vnm, node, b0, &cached_sw_if_index,
+				&cached_next_index, is_input);
+	  next1 = span_l2_next (vm, vnm, node, b1, &cached_sw_if_index,
+				&cached_next_index, is_input);
+
+	  vlib_validate_buffer_enqueue_x2 (vm, node, next_index,
+					   to_next, n_left_to_next,
+					   bi0, bi1, next0, next1);
 	}
 
-      while (n_left_from > 0 && n_left_to_next > 0 && n_left_to_c_next > 0)
+      while (n_left_from > 0 && n_left_to_next > 0)
 	{
 	  u32 bi0;
-	  u32 ci0;
 	  vlib_buffer_t *b0;
-	  vlib_buffer_t *c0;
+	  u32 next0;
 
-	  /* speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
+	  span_one (vm, node, &st, &bi0, i, is_input, 1);
+
 	  to_next[0] = bi0;
+	  from += 1;
 	  to_next += 1;
+	  n_left_from -= 1;
 	  n_left_to_next -= 1;
-
-	  if (n_left_to_next == 0)
-	    {
-	      vlib_put_next_frame (vm, node,
-				   SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-				   n_left_to_next);
-	      vlib_get_next_frame (vm, node,
-				   SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-				   to_next, n_left_to_next);
-	    }
+	  i += 1;
 
 	  b0 = vlib_get_buffer (vm, bi0);
-	  u32 dst_if = vnet_buffer (b0)->sw_if_index[VLIB_TX];
-      u32 span_if = get_span_entry (dst_if);
-      vnet_sw_interface_t *sw_if = 0;
-
-      if (PREDICT_TRUE (span_if != ~0))
-      {
-          sw_if = vnet_get_sw_interface (sm->vnet_main, span_if);
-//          clib_warning ("mirror to sw_if: %U",
-//                format_vnet_sw_interface, sm->vnet_main, sw_if);
-      }
+	  next0 = span_l2_next (vm, vnm, node, b0, &cached_sw_if_index,
+				&cached_next_index, is_input);
 
-      if (PREDICT_TRUE (!(b0->flags & VLIB_NODE_FLAG_IS_SPAN) &&
-              (sw_if != 0) &&
-              (sw_if->flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)))
-	    {
-	      c0 = span_duplicate_buffer (vm, b0, span_if, 0);
-	      ASSERT (c0 != 0);
-	      ci0 = vlib_get_buffer_index (vm, c0);
-
-	      to_c_next[0] = ci0;
-	      to_c_next++;
-	      n_left_to_c_next--;
-
-	      if (n_left_to_c_next == 0)
-		{
-		  vlib_put_next_frame (vm, node,
-				       SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-				       n_left_to_c_next);
-		  vlib_get_next_frame (vm, node,
-				       SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-				       to_c_next, n_left_to_c_next);
-		}
-
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (c0->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, c0, sizeof (*t));
-		  t->src_sw_if_index = dst_if;
-		  t->mirror_sw_if_index = span_if;
-		}
-
-	      ++n_span_packets;
-	    }
-	  else
-	    {
-	      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-				 && (b0->flags & VLIB_BUFFER_IS_TRACED)))
-		{
-		  span_trace_t *t =
-		    vlib_add_trace (vm, node, b0, sizeof (*t));
-		  t->src_sw_if_index = dst_if;
-		  t->mirror_sw_if_index = span_if;
-		}
-	    }
-
-	  from += 1;
-	  n_left_from -= 1;
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
+					   to_next, n_left_to_next,
+					   bi0, next0);
 	}
 
-      vlib_put_next_frame (vm, node, SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX,
-			   n_left_to_next);
-      vlib_put_next_frame (vm, node, SPAN_OUT_NEXT_MIRROR_INTERFACE_TX,
-			   n_left_to_c_next);
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
     }
 
-  vlib_node_increment_counter (vm, node->node_index, SPAN_ERROR_OUT_HITS,
-			       n_span_packets);
+  span_frame_finish (vm, node, &st, SPAN_L2_NEXT_MIRROR_INTERFACE_OUTPUT);
 
   return frame->n_vectors;
 }
 
-uword
-span_out_register_node (vlib_main_t * vm,
-			u32 src_sw_if_index, u32 dst_sw_if_index, u8 disable)
+static uword
+span_l2_input_node_fn (vlib_main_t * vm,
+		       vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  span_main_t *sm = &span_main;
-  vnet_sw_interface_t *sw =
-    vnet_get_sw_interface (sm->vnet_main, src_sw_if_index);
-  vnet_hw_interface_t *hw =
-    vnet_get_hw_interface (sm->vnet_main, sw->hw_if_index);
+  return span_l2_node_inline (vm, node, frame, 1 /* is_input */ );
+}
 
-  u32 span_node_index;
-  char *node_name = (char *) format (0, "%v-span", hw->name);
-  vlib_node_t *node_span = vlib_get_node_by_name (vm, (u8 *) node_name);
+static uword
+span_l2_output_node_fn (vlib_main_t * vm,
+			vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return span_l2_node_inline (vm, node, frame, 0 /* is_input */ );
+}
 
-  if (!disable)
-    {
-      ASSERT (node_span == 0);
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (span_l2_input_node) = {
+  .function = span_l2_input_node_fn,
+  .name = "span-l2-input",
+  .vector_size = sizeof (u32),
+  .format_trace = format_span_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
 
-      clib_warning ("span_node %s about to setup", node_name);
+  .n_errors = ARRAY_LEN (span_in_error_strings),
+  .error_strings = span_in_error_strings,
 
-      // get/create IF-span-output node
-      if (vec_len (sm->free_span_out_nodes) > 0)
-	{
-	  u32 *index = vec_end (sm->free_span_out_nodes) - 1;
-	  span_node_index = index[0];
-	  _vec_len (sm->free_span_out_nodes) -= 1;
+  .n_next_nodes = SPAN_L2_N_NEXT,
 
-	  vlib_node_rename (vm, span_node_index, "%v", node_name);
-	  clib_warning ("free span node index %u renamed to %s",
-			span_node_index, node_name);
-	}
-      else
-	{
-	  vlib_node_registration_t r;
+  .next_nodes = {
+    [SPAN_L2_NEXT_DROP] = "error-drop",
+    [SPAN_L2_NEXT_MIRROR_INTERFACE_OUTPUT] = "interface-output",
+  },
+};
 
-	  memset (&r, 0, sizeof (r));
+VLIB_NODE_FUNCTION_MULTIARCH (span_l2_input_node, span_l2_input_node_fn)
 
-	  r.type = VLIB_NODE_TYPE_INTERNAL;
-	  r.scalar_size = 0;
-	  r.vector_size = sizeof (u32);
-	  r.flags = VLIB_NODE_FLAG_IS_OUTPUT;
-	  r.name = node_name;
-	  r.n_errors = ARRAY_LEN (span_out_error_strings);
-	  r.error_strings = span_out_error_strings;
-	  r.function = span_out_node_fn;
-	  r.format_trace = format_span_trace;
+VLIB_REGISTER_NODE (span_l2_output_node) = {
+  .function = span_l2_output_node_fn,
+  .name = "span-l2-output",
+  .vector_size = sizeof (u32),
+  .format_trace = format_span_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
 
-	  span_node_index = vlib_register_node (vm, &r);
+  .n_errors = ARRAY_LEN (span_out_error_strings),
+  .error_strings = span_out_error_strings,
 
-	  clib_warning ("span node %s index %u created", node_name,
-			span_node_index);
-	}
-      node_span = vlib_get_node (vm, span_node_index);
-      ASSERT (node_span != 0);
-
-      // connect IF-span-output node
-//      vnet_sw_interface_t *dst_sw =
-//	vnet_get_sw_interface (sm->vnet_main, dst_sw_if_index);
-//      vnet_hw_interface_t *dst_hw =
-//	vnet_get_hw_interface (sm->vnet_main, dst_sw->hw_if_index);
-
-      // make SPAN node point IF-tx for original packets
-      vlib_node_add_next_with_slot (vm, span_node_index,
-				    hw->tx_node_index,
-				    SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX);
-
-//      // make SPAN node point DEST-IF-tx for cloned packets
-//      vlib_node_add_next_with_slot (vm, span_node_index,
-//				    dst_hw->tx_node_index,
-//				    SPAN_OUT_NEXT_MIRROR_INTERFACE_TX);
-      // make SPAN node point DEST-IF-tx for cloned packets
-      vlib_node_t *node_ifo = vlib_get_node_by_name (vm, (u8 *) "interface-output");
-            vlib_node_add_next_with_slot (vm, span_node_index,
-                    node_ifo->index,
-                          SPAN_OUT_NEXT_MIRROR_INTERFACE_TX);
-
-      // make IF-output node to point to SPAN in stead of IF-tx
-      vlib_node_add_next_with_slot (vm, hw->output_node_index,
-				    node_span->index,
-				    VNET_INTERFACE_OUTPUT_NEXT_TX);
-    }
-  else
-    {
-      ASSERT (node_span != 0);
+  .n_next_nodes = SPAN_L2_N_NEXT,
+
+  .next_nodes = {
+    [SPAN_L2_NEXT_DROP] = "error-drop",
+    [SPAN_L2_NEXT_MIRROR_INTERFACE_OUTPUT] = "interface-output",
+  },
+};
+
+VLIB_NODE_FUNCTION_MULTIARCH (span_l2_output_node, span_l2_output_node_fn)
+/* *INDENT-ON* */
+
+static clib_error_t *
+span_l2_init (vlib_main_t * vm)
+{
+  span_l2_main_t *slm = &span_l2_main;
+
+  /* Initialize the feature next-node indexes */
+  feat_bitmap_init_next_nodes (vm, span_l2_input_node.index,
+			       L2INPUT_N_FEAT, l2input_get_feat_names (),
+			       slm->input_feat_next_node_index);
+  feat_bitmap_init_next_nodes (vm, span_l2_output_node.index,
+			       L2OUTPUT_N_FEAT, l2output_get_feat_names (),
+			       slm->output_next_nodes.feat_next_node_index);
+
+  /* Initialize the output node mapping table */
+  l2output_init_output_node_vec (&slm->output_next_nodes.
+				 output_node_index_vec);
 
-      // point back IF-output to IF-tx
-      vlib_node_add_next_with_slot (vm, hw->output_node_index,
-				    hw->tx_node_index,
-				    VNET_INTERFACE_OUTPUT_NEXT_TX);
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (span_l2_init);
+
+/*
+ * Drop mirroring: called by error-drop, while the drop session exists,
+ * for a frame of packets about to be freed. Mirrors start at the L2
+ * header saved on input, if the packet has moved past it. The dropped
+ * packets are left untouched for error-drop to count: mirrors needing
+ * their L2 header back, or made in clone mode which re-heads the packet,
+ * are made from a private copy. Mirrors of mirrors are not made, so
+ * dropped mirrors can't loop. Mirror buffers come from the bounded SPAN
+ * pool and the destination rate limiters apply, a drop storm only costs
+ * the mirrors let through.
+ */
+void
+span_mirror_drops (vlib_main_t * vm, vlib_node_runtime_t * node,
+		   vlib_frame_t * frame)
+{
+  span_main_t *sm = &span_main;
+  span_session_t *s = get_span_drop_entry ();
+  span_per_thread_data_t *ptd;
+  u32 *from = vlib_frame_vector_args (frame);
+  u32 n_left = frame->n_vectors;
+  u32 i, n_mirrors = 0;
+  f64 now = vlib_time_now (vm);
 
-      // point SPAN original & mirror to something "useless"
-      vlib_node_add_named_next_with_slot (vm, node_span->index,
-					  "ip4-drop",
-					  SPAN_OUT_NEXT_ORIGINAL_INTERFACE_TX);
+  if (PREDICT_FALSE (s == 0))
+    return;
 
-      vlib_node_add_named_next_with_slot (vm, node_span->index,
-					  "error-drop",
-					  SPAN_OUT_NEXT_MIRROR_INTERFACE_TX);
+  ptd = vec_elt_at_index (sm->per_thread_data, os_get_cpu_number ());
+  vec_reset_length (ptd->mirrors);
 
-      u32 *index;
-      vec_add2 (sm->free_span_out_nodes, index, 1);
-      *index = node_span->index;
+  for (i = 0; i < n_left; i++)
+    {
+      vlib_buffer_t *b0, *c0;
+      u32 ci0;
+      word l2_len0 = 0;
+      u8 *h0;
+
+      if (PREDICT_TRUE (i + 1 < n_left))
+	vlib_prefetch_buffer_header (vlib_get_buffer (vm, from[i + 1]),
+				     LOAD);
+
+      b0 = vlib_get_buffer (vm, from[i]);
+      if (PREDICT_FALSE (b0->flags & VLIB_NODE_FLAG_IS_SPAN))
+	continue;
+
+      /* drop nodes may be past the L2 header, as in pcap drop trace */
+      if ((b0->flags & BUFFER_L2_HDR_OFFSET_VALID)
+	  && vnet_buffer2 (b0)->l2_hdr_offset < b0->current_data)
+	l2_len0 = b0->current_data - vnet_buffer2 (b0)->l2_hdr_offset;
+      h0 = vlib_buffer_get_current (b0) - l2_len0;
+
+      if (PREDICT_FALSE (span_session_selects (s))
+	  && span_select_one (s, ptd, h0, now) != SPAN_SELECT_HIT)
+	continue;
+
+      if (PREDICT_TRUE (l2_len0 == 0 && s->mode == SPAN_MIRROR_MODE_COPY))
+	{
+	  n_mirrors += span_duplicate_buffer (vm, from + i, s,
+					      SPAN_DIRECTION_DROP,
+					      &ptd->mirrors);
+	  continue;
+	}
+
+      if (PREDICT_FALSE (vlib_buffer_alloc_from_free_list
+			 (vm, &ci0, 1, sm->buffer_free_list_index) != 1
+			 || (c0 = vlib_buffer_copy_to (vm, b0, ci0)) == 0))
+	{
+	  vlib_increment_simple_counter
+	    (&sm->counters[SPAN_COUNTER_COPY_FAILED], os_get_cpu_number (),
+	     s->counter_index, vec_len (s->dsts));
+	  continue;
+	}
 
-      vlib_node_rename (vm, node_span->index, "%v-free", node_name);
-      clib_warning ("node %u renamed to %s", node_span->index,
-		    node_span->name);
+      c0->error = b0->error;
+      if (l2_len0)
+	{
+	  vlib_buffer_advance (c0, -l2_len0);
+	  clib_memcpy (vlib_buffer_get_current (c0), h0, l2_len0);
+#if DPDK == 1
+	  {
+	    struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (c0);
+	    mb->data_off -= l2_len0;
+	    mb->data_len += l2_len0;
+	    mb->pkt_len += l2_len0;
+	  }
+#endif
+	}
+
+      n_mirrors += span_duplicate_buffer (vm, &ci0, s, SPAN_DIRECTION_DROP,
+					  &ptd->mirrors);
+      vlib_buffer_free_one (vm, ci0);
     }
 
+  vlib_buffer_enqueue_to_single_next (vm, node, ptd->mirrors,
+				      sm->drop_next_index, n_mirrors);
+}
+
+static clib_error_t *
+span_drop_init (vlib_main_t * vm)
+{
+  span_main_t *sm = &span_main;
+  vlib_node_t *drop, *output;
+
+  drop = vlib_get_node_by_name (vm, (u8 *) "error-drop");
+  output = vlib_get_node_by_name (vm, (u8 *) "interface-output");
+  if (drop == 0 || output == 0)
+    return clib_error_return (0, "error-drop or interface-output AWOL");
+
+  sm->drop_next_index = vlib_node_add_next (vm, drop->index, output->index);
+
   return 0;
 }
 
+VLIB_INIT_FUNCTION (span_drop_init);
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -17,9 +17,9 @@
 #include <vppinfra/error.h>
 
 #include <vnet/span/span.h>
-#if DPDK==1
-#include <vnet/dpdk_replication.h>
-#endif /* DPDK */
+#include <vnet/ethernet/ethernet.h>
+#include <vnet/l2/l2_input.h>
+#include <vnet/l2/l2_output.h>
 
 u8 *
 format_span_trace (u8 * s, va_list * args)
@@ -34,73 +34,551 @@ format_span_trace (u8 * s, va_list * args)
   if (t->mirror_sw_if_index != ~0) {
       s = format (s, " %U",
                 format_vnet_sw_if_index_name, vnm, t->mirror_sw_if_index);
+      if (t->n_mirrors > 1)
+          s = format (s, " and %d more", t->n_mirrors - 1);
   }
 
   return s;
 }
 
-vlib_buffer_t *
-span_duplicate_buffer (vlib_main_t * vm,
-		       vlib_buffer_t * b0, uword span_if_index, u8 copy)
+u8 *
+format_span_mirror_mode (u8 * s, va_list * args)
+{
+  u32 mode = va_arg (*args, u32);
+  char *t = 0;
+
+  switch (mode)
+    {
+#define _(sym,str) case SPAN_MIRROR_MODE_##sym: t = str; break;
+      foreach_span_mirror_mode
+#undef _
+    default:
+      return format (s, "unknown %d", mode);
+    }
+  return format (s, "%s", t);
+}
+
+u8 *
+format_span_sample_mode (u8 * s, va_list * args)
+{
+  u32 mode = va_arg (*args, u32);
+  char *t = 0;
+
+  switch (mode)
+    {
+#define _(sym,str) case SPAN_SAMPLE_##sym: t = str; break;
+      foreach_span_sample_mode
+#undef _
+    default:
+      return format (s, "unknown %d", mode);
+    }
+  return format (s, "%s", t);
+}
+
+u8 *
+format_span_direction (u8 * s, va_list * args)
+{
+  u32 direction = va_arg (*args, u32);
+  char *t = 0;
+
+  switch (direction)
+    {
+#define _(v,sym,str) case SPAN_DIRECTION_##sym: t = str; break;
+      foreach_span_direction
+#undef _
+    default:
+      return format (s, "unknown %d", direction);
+    }
+  return format (s, "%s", t);
+}
+
+u8 *
+format_span_metadata_mode (u8 * s, va_list * args)
 {
-  vlib_buffer_t *c0 = 0;
+  u32 mode = va_arg (*args, u32);
+  char *t = 0;
 
-  /*
-   * Copy buffer for now, clone is not enough because incomming buffer
-   * can be changed before it goes out of SPAN interface.
-   */
-#if DPDK==1
-  struct rte_mbuf *clone0 = (copy) ?
-    dpdk_replicate_packet_mb (b0) : dpdk_zerocopy_replicate_packet_mb (b0);
-  c0 = vlib_buffer_from_rte_mbuf (clone0);
-#else /* DPDK */
-  u32 ci0 = 0;
+  switch (mode)
+    {
+#define _(sym,str) case SPAN_METADATA_##sym: t = str; break;
+      foreach_span_metadata_mode
+#undef _
+    default:
+      return format (s, "unknown %d", mode);
+    }
+  return format (s, "%s", t);
+}
+
+/* Name of a session source, an interface or the drops */
+u8 *
+format_span_src (u8 * s, va_list * args)
+{
+  u32 src_sw_if_index = va_arg (*args, u32);
+
+  if (src_sw_if_index == SPAN_SRC_DROP)
+    return format (s, "drop");
+  return format (s, "%U", format_vnet_sw_if_index_name, &vnet_main,
+		 src_sw_if_index);
+}
+
+/* A session source, an interface name or "drop" */
+uword
+unformat_span_src (unformat_input_t * input, va_list * args)
+{
+  u32 *result = va_arg (*args, u32 *);
+
+  if (unformat (input, "drop"))
+    *result = SPAN_SRC_DROP;
+  else if (!unformat (input, "%U", unformat_vnet_sw_interface,
+		      &vnet_main, result))
+    return 0;
+
+  return 1;
+}
 
-  if (vlib_buffer_alloc (vm, &ci0, 1) != 1)
+uword
+unformat_span_mirror_mode (unformat_input_t * input, va_list * args)
+{
+  u32 *result = va_arg (*args, u32 *);
+
+  if (0)
+    ;
+#define _(sym,str) else if (unformat (input, str)) \
+    *result = SPAN_MIRROR_MODE_##sym;
+  foreach_span_mirror_mode
+#undef _
+  else
     return 0;
 
-  c0 = vlib_get_buffer (vm, ci0);
-  clib_memcpy (c0->data + b0->current_data, b0->data + b0->current_data,
-	       b0->current_length);
-#endif /* DPDK */
+  return 1;
+}
+
+/*
+ * Check that a new L3 session can mirror the packets received by its
+ * source. Sub-interfaces share the input node of their hardware
+ * interface, their packets are only told apart by the l2 session. The
+ * span-input redirect hands packets to ethernet-input, so it can only
+ * replace a redirect to ethernet-input, not one to another feature.
+ */
+static clib_error_t *
+span_check_rx_source (span_main_t * sm, u32 src_sw_if_index,
+		      u32 direction, u32 is_l2)
+{
+  vnet_sw_interface_t *si;
+  vnet_hw_interface_t *hi;
+  vnet_device_class_t *dev_class;
+
+  if (src_sw_if_index == SPAN_SRC_DROP || is_l2 == 1)
+    return 0;
+  if (direction != ~0 && !(direction & SPAN_DIRECTION_RX))
+    return 0;
 
-  c0->current_data = b0->current_data;
-  c0->current_length = b0->current_length;
-  c0->flags = b0->flags | VLIB_NODE_FLAG_IS_SPAN | VLIB_BUFFER_IS_TRACED;
-  c0->trace_index = b0->trace_index;
+  si = vnet_get_sw_interface (sm->vnet_main, src_sw_if_index);
+  if (si->type != VNET_SW_INTERFACE_TYPE_HARDWARE)
+    return clib_error_return (0,
+			      "Received packets of sub-interface %U are only mirrored in l2 ",
+			      format_vnet_sw_if_index_name, sm->vnet_main,
+			      src_sw_if_index);
 
-  vnet_buffer (c0)->sw_if_index[VLIB_TX] = span_if_index;
-  vnet_buffer (c0)->sw_if_index[VLIB_RX] =
-    vnet_buffer (b0)->sw_if_index[VLIB_RX];
-  clib_warning (">> trace index (%u) %u -> (%u) %u",
-          vlib_get_buffer_index (vm, b0), b0->trace_index,
-          vlib_get_buffer_index (vm, c0), c0->trace_index);
+  hi = vnet_get_hw_interface (sm->vnet_main, si->hw_if_index);
+  dev_class = vnet_get_device_class (sm->vnet_main, hi->dev_class_index);
+  if (dev_class->span_enable_disable_function == 0
+      && hi->rx_redirect_node_index != ~0
+      && hi->rx_redirect_node_index != ethernet_input_node.index)
+    return clib_error_return (0,
+			      "Received packets of %U are redirected to %U already ",
+			      format_vnet_sw_if_index_name, sm->vnet_main,
+			      src_sw_if_index, format_vlib_node_name,
+			      vlib_get_main (), hi->rx_redirect_node_index);
 
-  return c0;
+  return 0;
 }
 
+/*
+ * Create the mirror copies of buffer *bi0, one per session destination,
+ * and append them to the *mirrors vector. In clone mode the original
+ * TX or dropped packet is re-headed: *bi0 is replaced by a fresh head
+ * which shares the packet tail with the mirrors, RX mirrors are copied.
+ * dir is the direction of the packet, for the clone choice and the
+ * mirror metadata. Returns the number of mirrors created.
+ */
 u32
-get_span_entry (u32 src_sw_if_index)
+span_duplicate_buffer (vlib_main_t * vm, u32 * bi0, span_session_t * s,
+		       span_direction_t dir, u32 ** mirrors)
+{
+  u32 heads[SPAN_MAX_DESTINATIONS + 1];
+  u32 n_heads, n_used, n_mirrors, *m;
+
+  n_heads = vlib_buffer_alloc_from_free_list (vm, heads,
+					      span_n_heads_per_packet (s),
+					      span_main.buffer_free_list_index);
+
+  vec_add2 (*mirrors, m, vec_len (s->dsts));
+  n_used = span_mirror_buffer (vm, bi0, heads, n_heads, s, dir, m,
+			       &n_mirrors);
+  _vec_len (*mirrors) -= vec_len (s->dsts) - n_mirrors;
+
+  if (PREDICT_FALSE (n_used == SPAN_MIRROR_NO_BUFFERS))
+    {
+      vlib_increment_simple_counter
+	(&span_main.counters[SPAN_COUNTER_COPY_FAILED], os_get_cpu_number (),
+	 s->counter_index, vec_len (s->dsts));
+      n_used = 0;
+    }
+
+  if (n_used < n_heads)
+    vlib_buffer_free (vm, heads + n_used, n_heads - n_used);
+
+  return n_mirrors;
+}
+
+u64
+span_get_counter (u32 src_sw_if_index, span_counter_type_t type)
+{
+  span_main_t *sm = &span_main;
+
+  return vlib_get_simple_counter (&sm->counters[type],
+				  span_src_counter_index (src_sw_if_index));
+}
+
+/*
+ * Make room for the counters of a new source and zero them.
+ * The stats thread reads the counter vectors under the interface counter
+ * lock, so they only grow while it is held.
+ */
+static void
+span_counters_validate (span_main_t * sm, u32 counter_index)
+{
+  vnet_interface_main_t *im = &sm->vnet_main->interface_main;
+  int i;
+
+  vnet_interface_counter_lock (im);
+  for (i = 0; i < SPAN_N_COUNTER; i++)
+    {
+      vlib_validate_simple_counter (&sm->counters[i], counter_index);
+      vlib_zero_simple_counter (&sm->counters[i], counter_index);
+    }
+  vnet_interface_counter_unlock (im);
+}
+
+void
+span_get_dst_counter (span_dst_t * d, vlib_counter_t * result)
 {
-    span_main_t *sm = &span_main;
+  span_main_t *sm = &span_main;
 
-    uword *p = hash_get (sm->dst_sw_if_index_by_src, src_sw_if_index);
-    if (p != 0)
-        return (u32) p[0];
-    else
-        return (u32) ~0;
+  vlib_get_combined_counter (&sm->dst_counters, d->counter_index, result);
 }
 
+void
+span_get_dst_drop_counter (span_dst_t * d, vlib_counter_t * result)
+{
+  span_main_t *sm = &span_main;
+
+  vlib_get_combined_counter (&sm->dst_drop_counters, d->counter_index,
+			     result);
+}
+
+u32
+span_get_dst_max_pps (u32 dst_sw_if_index)
+{
+  span_main_t *sm = &span_main;
+
+  if (dst_sw_if_index >= vec_len (sm->max_pps_by_dst_sw_if_index))
+    return 0;
+  return sm->max_pps_by_dst_sw_if_index[dst_sw_if_index];
+}
+
+/*
+ * Limit the rate of mirrors sent to a destination interface, from all
+ * sources together. A max_pps of 0 removes the limit.
+ *
+ * Each thread forwarding packets, the workers or else the main thread,
+ * polices with a token bucket of its own holding an equal share of
+ * max_pps, so the data plane takes no lock. A thread cannot borrow the
+ * share another one leaves unused.
+ */
+clib_error_t *
+span_set_dst_max_pps (vlib_main_t * vm, u32 dst_sw_if_index, u32 max_pps)
+{
+  span_main_t *sm = &span_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  sse2_qos_pol_cfg_params_st cfg;
+  policer_read_response_type_st phys;
+  span_per_thread_data_t *ptd;
+  u32 *pi, n_shares;
+
+  if (dst_sw_if_index == ~0)
+    return clib_error_return (0, "Destination interface must be set... ");
+
+  if (max_pps)
+    {
+      n_shares = tm->n_vlib_mains > 1 ? tm->n_vlib_mains - 1 : 1;
+      if (max_pps < n_shares)
+	return clib_error_return (0, "max-pps %u is below one per thread",
+				  max_pps);
+
+      memset (&cfg, 0, sizeof (cfg));
+      cfg.rfc = SSE2_QOS_POLICER_TYPE_1R2C;
+      cfg.rnd_type = SSE2_QOS_ROUND_TO_CLOSEST;
+      cfg.rate_type = SSE2_QOS_RATE_PPS;
+      cfg.rb.pps.cir_pps = max_pps / n_shares;
+      cfg.rb.pps.cb_ms = SPAN_POLICER_BURST_MS;
+      cfg.conform_action.action_type = SSE2_QOS_ACTION_TRANSMIT;
+      cfg.exceed_action.action_type = SSE2_QOS_ACTION_DROP;
+      cfg.violate_action.action_type = SSE2_QOS_ACTION_DROP;
+
+      if (sse2_pol_logical_2_physical (&cfg, &phys))
+	return clib_error_return (0, "max-pps %u is out of policer range",
+				  max_pps);
+    }
+
+  /* policers are used by the data plane on all threads */
+  vlib_worker_thread_barrier_sync (vm);
+
+  vec_validate_init_empty (sm->policer_index_by_dst_sw_if_index,
+			   dst_sw_if_index, ~0);
+  vec_validate (sm->max_pps_by_dst_sw_if_index, dst_sw_if_index);
+  pi = vec_elt_at_index (sm->policer_index_by_dst_sw_if_index,
+			 dst_sw_if_index);
+
+  if (max_pps == 0)
+    {
+      if (*pi != ~0)
+	vec_add1 (sm->free_policer_indices, *pi);
+      *pi = ~0;
+    }
+  else
+    {
+      if (*pi == ~0)
+	{
+	  if (vec_len (sm->free_policer_indices))
+	    *pi = vec_pop (sm->free_policer_indices);
+	  else
+	    *pi = sm->n_policers++;
+	}
+      /* the main thread gets a share too, for the packets it forwards */
+      vec_foreach (ptd, sm->per_thread_data)
+      {
+	vec_validate_aligned (ptd->policers, *pi, CLIB_CACHE_LINE_BYTES);
+	ptd->policers[*pi] = phys;
+      }
+    }
+  sm->max_pps_by_dst_sw_if_index[dst_sw_if_index] = max_pps;
+
+  vlib_worker_thread_barrier_release (vm);
+
+  return 0;
+}
+
+/*
+ * Mirror only the packets of src_sw_if_index which hit the classify
+ * table table_index, or one of the tables chained to it. A table_index
+ * of ~0 mirrors all packets again.
+ */
+clib_error_t *
+span_set_classify_table (vlib_main_t * vm, u32 src_sw_if_index,
+			 u32 table_index)
+{
+  vnet_classify_main_t *vcm = &vnet_classify_main;
+  span_session_t *session;
+
+  if (src_sw_if_index == ~0)
+    return clib_error_return (0, "Source interface must be set... ");
+
+  session = get_span_entry (src_sw_if_index);
+  if (session == 0)
+    return clib_error_return (0, "Source interface is not mirrored ");
+
+  if (table_index != ~0 && pool_is_free_index (vcm->tables, table_index))
+    return clib_error_return (0, "No such classifier table %u",
+			      table_index);
+
+  /* the filter is read by the data plane on all threads */
+  vlib_worker_thread_barrier_sync (vm);
+  session->table_index = table_index;
+  vlib_worker_thread_barrier_release (vm);
+
+  return 0;
+}
+
+/*
+ * Mirror only a sample of the packets of src_sw_if_index passing the
+ * classify filter: 1 packet, or 1 flow, in rate. SPAN_SAMPLE_NONE mirrors
+ * all packets again.
+ */
+clib_error_t *
+span_set_sample (vlib_main_t * vm, u32 src_sw_if_index,
+		 span_sample_mode_t mode, u32 rate)
+{
+  span_main_t *sm = &span_main;
+  span_session_t *session;
+  span_per_thread_data_t *ptd;
+  u32 si;
+
+  if (src_sw_if_index == ~0)
+    return clib_error_return (0, "Source interface must be set... ");
+
+  session = get_span_entry (src_sw_if_index);
+  if (session == 0)
+    return clib_error_return (0, "Source interface is not mirrored ");
+
+  if (mode >= SPAN_N_SAMPLE_MODE)
+    return clib_error_return (0, "Unknown sampling mode %d", mode);
+  if (mode == SPAN_SAMPLE_NONE)
+    rate = 1;
+  else if (rate == 0)
+    return clib_error_return (0, "Sampling rate must be at least 1 ");
+
+  si = session - sm->sessions;
+
+  /* sampling state is read by the data plane on all threads */
+  vlib_worker_thread_barrier_sync (vm);
+  session->sample_mode = mode;
+  session->sample_rate = rate;
+  session->sample_threshold = 0xffffffff / rate;
+  vec_foreach (ptd, sm->per_thread_data)
+  {
+    vec_validate (ptd->sample_counts, si);
+    ptd->sample_counts[si] = 0;
+  }
+  vlib_worker_thread_barrier_release (vm);
+
+  return 0;
+}
+
+clib_error_t *
+span_set_metadata (vlib_main_t * vm, u32 src_sw_if_index,
+		   span_metadata_mode_t mode)
+{
+  span_session_t *session;
+
+  if (src_sw_if_index == ~0)
+    return clib_error_return (0, "Source interface must be set... ");
+
+  session = get_span_entry (src_sw_if_index);
+  if (session == 0)
+    return clib_error_return (0, "Source interface is not mirrored ");
+
+  if (mode >= SPAN_N_METADATA_MODE)
+    return clib_error_return (0, "Unknown metadata mode %d", mode);
+  /* clone mirrors share their tail, which is not theirs to append to */
+  if (mode == SPAN_METADATA_TRAILER
+      && session->mode == SPAN_MIRROR_MODE_CLONE && session->snaplen == 0)
+    return clib_error_return (0,
+			      "Metadata trailer needs copy mode or a snaplen ");
+
+  /* a single byte, the data plane reads it once per packet */
+  session->metadata_mode = mode;
+
+  return 0;
+}
+
+static u32
+span_dst_counter_alloc (span_main_t * sm)
+{
+  u32 index;
+
+  if (vec_len (sm->free_dst_counter_indices) > 0)
+    {
+      index = vec_pop (sm->free_dst_counter_indices);
+    }
+  else
+    {
+      index = sm->n_dst_counters++;
+      vlib_validate_combined_counter (&sm->dst_counters, index);
+      vlib_validate_combined_counter (&sm->dst_drop_counters, index);
+    }
+  vlib_zero_combined_counter (&sm->dst_counters, index);
+  vlib_zero_combined_counter (&sm->dst_drop_counters, index);
+
+  return index;
+}
+
+static span_dst_t *
+span_session_find_dst (span_session_t * session, u32 dst_sw_if_index)
+{
+  span_dst_t *d;
+
+  vec_foreach (d, session->dsts)
+    if (d->sw_if_index == dst_sw_if_index)
+      return d;
+
+  return 0;
+}
+
+/* 1 if any session mirrors to dst_sw_if_index */
+int
+span_dst_in_use (u32 dst_sw_if_index)
+{
+  span_main_t *sm = &span_main;
+  span_session_t *session;
+
+  /* *INDENT-OFF* */
+  pool_foreach (session, sm->sessions,
+  ({
+    if (span_session_find_dst (session, dst_sw_if_index))
+      return 1;
+  }));
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+/*
+ * Count a TX session of sw_if_index in or out. Sub-interfaces transmit
+ * through the output node of their hardware interface, so span-output is
+ * enabled on the sup interface while any of them has a TX session.
+ */
+static void
+span_out_feature_enable (span_main_t * sm, u32 sw_if_index, int enable)
+{
+  vnet_sw_interface_t *sup =
+    vnet_get_sup_sw_interface (sm->vnet_main, sw_if_index);
+  u32 *n;
+
+  vec_validate (sm->n_tx_sessions_by_sup_sw_if_index, sup->sw_if_index);
+  n = vec_elt_at_index (sm->n_tx_sessions_by_sup_sw_if_index,
+			sup->sw_if_index);
+  *n += enable ? 1 : -1;
+
+  /* first session in, or last one out */
+  if (*n == enable)
+    vnet_interface_add_del_feature (sm->vnet_main, sm->vlib_main,
+				    sup->sw_if_index, INTF_OUTPUT_FEAT_SPAN,
+				    enable);
+}
+
+/*
+ * Add destination dst_sw_if_index to the session of src_sw_if_index,
+ * creating the session if needed. With disable set, remove the given
+ * destination, or the whole session if dst_sw_if_index is ~0.
+ * A mode of ~0 keeps the mode of an existing session, new sessions
+ * default to copy mode. Likewise a snaplen of ~0 keeps the snaplen of an
+ * existing session, new sessions default to mirroring whole packets, and
+ * a direction of ~0 keeps the direction of an existing session, new
+ * sessions default to both. Only the datapath hooks of the session
+ * direction are installed: the driver RX hook or span-input for RX, the
+ * span-output interface output feature for TX. With is_l2 set, the session mirrors the
+ * L2 traffic of src_sw_if_index, which may be a sub-interface, through
+ * the SPAN bits of its l2-input and l2-output feature bitmaps instead.
+ * An is_l2 of ~0 keeps the setting of an existing session, new sessions
+ * default to the device hooks. A src_sw_if_index of SPAN_SRC_DROP makes
+ * the drop session, in SPAN_DIRECTION_DROP direction and with a metadata
+ * header by default; error-drop mirrors the packets it frees while it
+ * exists.
+ */
 clib_error_t *
 set_span_add_delete_entry (vlib_main_t * vm,
 			   u32 src_sw_if_index,
-			   u32 dst_sw_if_index, u8 disable)
+			   u32 dst_sw_if_index,
+			   span_mirror_mode_t mode, u32 snaplen,
+			   span_direction_t direction, u32 is_l2, u8 disable)
 {
   span_main_t *sm = &span_main;
+  span_session_t *session;
+  span_dst_t *d;
   vnet_sw_interface_t *si;
-
-  if (disable)
-      dst_sw_if_index = ~0;
+  u32 first_dst_sw_if_index;
 
   if (src_sw_if_index == ~0)
     return clib_error_return (0, "Source interface must be set... ");
@@ -109,43 +587,200 @@ set_span_add_delete_entry (vlib_main_t * vm,
   if (src_sw_if_index == dst_sw_if_index)
     return clib_error_return (0,
 			      "Source interface must be different to Destination interface ");
+  if (mode >= SPAN_N_MIRROR_MODE && mode != ~0)
+    return clib_error_return (0, "Unknown mirror mode %d", mode);
+  if (snaplen > 0xffff && snaplen != ~0)
+    return clib_error_return (0, "snaplen %u is out of range", snaplen);
+  if (src_sw_if_index == SPAN_SRC_DROP)
+    {
+      if (direction != SPAN_DIRECTION_DROP && direction != ~0)
+	return clib_error_return (0, "Drops have no rx or tx direction ");
+      if (is_l2 == 1)
+	return clib_error_return (0, "Drops are not mirrored in l2 ");
+      direction = SPAN_DIRECTION_DROP;
+      is_l2 = 0;
+    }
+  else if ((direction == 0 || direction > SPAN_DIRECTION_BOTH)
+	   && direction != ~0)
+    return clib_error_return (0, "Unknown direction %d", direction);
 
-  uword *p = hash_get (sm->dst_sw_if_index_by_src, src_sw_if_index);
-  if (p != 0 && !disable)
-  {
-      si = vnet_get_sw_interface (sm->vnet_main, p[0]);
-    return clib_error_return (0,
-			      "Source interface is already mirrored to interface index %U ",
-			      format_vnet_sw_interface_name, sm->vnet_main, si);
-  }
-  if (p == 0 && disable)
+  session = get_span_entry (src_sw_if_index);
+  if (session == 0 && disable)
     return clib_error_return (0, "Source interface is not mirrored ");
 
   if (!disable)
-    hash_set (sm->dst_sw_if_index_by_src, src_sw_if_index, dst_sw_if_index);
-  else
-    hash_unset (sm->dst_sw_if_index_by_src, src_sw_if_index);
+    {
+      if (session != 0)
+	{
+	  if (span_session_find_dst (session, dst_sw_if_index))
+	    return clib_error_return (0,
+				      "Source interface is already mirrored to interface %U ",
+				      format_vnet_sw_if_index_name,
+				      sm->vnet_main, dst_sw_if_index);
+	  if (mode != ~0 && mode != session->mode)
+	    return clib_error_return (0,
+				      "Source interface is mirrored in %U mode ",
+				      format_span_mirror_mode, session->mode);
+	  if (snaplen != ~0 && snaplen != session->snaplen)
+	    return clib_error_return (0,
+				      "Source interface is mirrored with snaplen %u ",
+				      session->snaplen);
+	  if (is_l2 != ~0 && is_l2 != session->is_l2)
+	    return clib_error_return (0,
+				      "Source interface is %smirrored in l2 ",
+				      session->is_l2 ? "" : "not ");
+	  if (direction != ~0 && direction != session->direction)
+	    return clib_error_return (0,
+				      "Source interface is mirrored in %U direction ",
+				      format_span_direction,
+				      session->direction);
+	  if (vec_len (session->dsts) >= SPAN_MAX_DESTINATIONS)
+	    return clib_error_return (0,
+				      "Source interface is mirrored to %d interfaces already ",
+				      SPAN_MAX_DESTINATIONS);
+	}
+    }
+  else if (dst_sw_if_index != ~0
+	   && !span_session_find_dst (session, dst_sw_if_index))
+    return clib_error_return (0,
+			      "Source interface is not mirrored to interface %U ",
+			      format_vnet_sw_if_index_name, sm->vnet_main,
+			      dst_sw_if_index);
 
-// setup dpdk-span-in feature
-  si = vnet_get_sw_interface (sm->vnet_main, src_sw_if_index);
+  if (!disable && session == 0)
+    {
+      clib_error_t *error;
 
-if (si->type == VNET_SW_INTERFACE_TYPE_HARDWARE)
-  {
-    vnet_hw_interface_t *hi =
-      vnet_get_hw_interface (sm->vnet_main, si->hw_if_index);
+      error = span_check_rx_source (sm, src_sw_if_index, direction, is_l2);
+      if (error)
+	return error;
+    }
 
-    vnet_device_class_t *dev_class =
-      vnet_get_device_class (sm->vnet_main, hi->dev_class_index);
-    if (dev_class->span_enable_disable_function)
+  /* sessions are read by the data plane on all threads */
+  vlib_worker_thread_barrier_sync (vm);
+
+  if (!disable)
+    {
+      if (session == 0)
+	{
+	  pool_get (sm->sessions, session);
+	  memset (session, 0, sizeof (*session));
+	  session->src_sw_if_index = src_sw_if_index;
+	  session->counter_index = span_src_counter_index (src_sw_if_index);
+	  session->is_drop = src_sw_if_index == SPAN_SRC_DROP;
+	  session->mode = mode == ~0 ? SPAN_MIRROR_MODE_COPY : mode;
+	  session->snaplen = snaplen == ~0 ? 0 : snaplen;
+	  session->direction =
+	    direction == ~0 ? SPAN_DIRECTION_BOTH : direction;
+	  session->is_l2 = is_l2 == ~0 ? 0 : is_l2 != 0;
+	  session->table_index = ~0;
+	  session->rx_redirect_node_index = ~0;
+	  session->sample_rate = 1;
+	  span_counters_validate (sm, session->counter_index);
+	  if (session->is_drop)
+	    {
+	      /* drop mirrors are tagged with the drop reason */
+	      session->metadata_mode = SPAN_METADATA_HEADER;
+	      sm->drop_session_index = session - sm->sessions;
+	    }
+	  else
+	    {
+	      vec_validate_init_empty (sm->session_index_by_sw_if_index,
+				       src_sw_if_index, ~0);
+	      sm->session_index_by_sw_if_index[src_sw_if_index] =
+		session - sm->sessions;
+	    }
+	}
+      vec_add2 (session->dsts, d, 1);
+      d->sw_if_index = dst_sw_if_index;
+      d->counter_index = span_dst_counter_alloc (sm);
+    }
+  else
+    {
+      vec_foreach (d, session->dsts)
       {
-        dev_class->span_enable_disable_function (sm->vnet_main,
-                               si->hw_if_index,
-                               dst_sw_if_index);
+	if (dst_sw_if_index != ~0 && d->sw_if_index != dst_sw_if_index)
+	  continue;
+	vec_add1 (sm->free_dst_counter_indices, d->counter_index);
+	if (dst_sw_if_index != ~0)
+	  {
+	    vec_delete (session->dsts, 1, d - session->dsts);
+	    break;
+	  }
       }
-  }
+      if (dst_sw_if_index == ~0)
+	vec_reset_length (session->dsts);
+    }
+
+  first_dst_sw_if_index = vec_len (session->dsts) ?
+    session->dsts[0].sw_if_index : ~0;
+
+  if (session->is_drop)
+    ;				/* error-drop looks the session up itself */
+  else if (session->is_l2)
+    {
+      /* l2 sessions only set the feature bitmap bits of their source */
+      if (session->direction & SPAN_DIRECTION_RX)
+	l2input_intf_bitmap_enable (src_sw_if_index, L2INPUT_FEAT_SPAN,
+				    first_dst_sw_if_index != ~0);
+      if (session->direction & SPAN_DIRECTION_TX)
+	l2output_intf_bitmap_enable (src_sw_if_index, L2OUTPUT_FEAT_SPAN,
+				     first_dst_sw_if_index != ~0);
+    }
+  else
+    {
+      // setup dpdk-span-in feature
+      si = vnet_get_sw_interface (sm->vnet_main, src_sw_if_index);
+
+      if ((session->direction & SPAN_DIRECTION_RX)
+	  && si->type == VNET_SW_INTERFACE_TYPE_HARDWARE)
+	{
+	  vnet_hw_interface_t *hi =
+	    vnet_get_hw_interface (sm->vnet_main, si->hw_if_index);
+
+	  vnet_device_class_t *dev_class =
+	    vnet_get_device_class (sm->vnet_main, hi->dev_class_index);
+	  if (dev_class->span_enable_disable_function)
+	    {
+	      dev_class->span_enable_disable_function (sm->vnet_main,
+						       si->hw_if_index,
+						       first_dst_sw_if_index);
+	    }
+	  /*
+	   * other drivers send received packets through span-input, which
+	   * passes them on to ethernet-input: the redirect found there is
+	   * put back once the last destination is gone
+	   */
+	  else if (dev_class->rx_redirect_to_node)
+	    {
+	      if (hi->rx_redirect_node_index != span_input_node.index)
+		session->rx_redirect_node_index = hi->rx_redirect_node_index;
+	      vnet_hw_interface_rx_redirect_to_node
+		(sm->vnet_main, si->hw_if_index,
+		 first_dst_sw_if_index != ~0 ?
+		 span_input_node.index : session->rx_redirect_node_index);
+	    }
+	}
 
-  // setup span-out node
-  span_out_register_node (vm, src_sw_if_index, dst_sw_if_index, disable);
+      /* enable span-output with the first destination */
+      if ((session->direction & SPAN_DIRECTION_TX)
+	  && !disable && vec_len (session->dsts) == 1)
+	span_out_feature_enable (sm, src_sw_if_index, 1);
+    }
+
+  if (vec_len (session->dsts) == 0)
+    {
+      if (!session->is_l2 && (session->direction & SPAN_DIRECTION_TX))
+	span_out_feature_enable (sm, src_sw_if_index, 0);
+      if (session->is_drop)
+	sm->drop_session_index = ~0;
+      else
+	sm->session_index_by_sw_if_index[src_sw_if_index] = ~0;
+      vec_free (session->dsts);
+      pool_put (sm->sessions, session);
+    }
+
+  vlib_worker_thread_barrier_release (vm);
 
   return 0;
 }
@@ -157,16 +792,31 @@ set_span_command_fn (vlib_main_t * vm,
   span_main_t *sm = &span_main;
   u32 src_sw_if_index = ~0;
   u32 dst_sw_if_index = ~0;
+  u32 mode = ~0;
+  u32 snaplen = ~0;
+  u32 direction = ~0;
+  u32 is_l2 = ~0;
   u8 disable = 0;
 
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
-      if (unformat (input, "src %U", unformat_vnet_sw_interface,
-		    sm->vnet_main, &src_sw_if_index))
+      if (unformat (input, "src %U", unformat_span_src, &src_sw_if_index))
 	;
       else if (unformat (input, "dst %U", unformat_vnet_sw_interface,
 			 sm->vnet_main, &dst_sw_if_index))
 	;
+      else if (unformat (input, "rx"))
+	direction = SPAN_DIRECTION_RX;
+      else if (unformat (input, "tx"))
+	direction = SPAN_DIRECTION_TX;
+      else if (unformat (input, "both"))
+	direction = SPAN_DIRECTION_BOTH;
+      else if (unformat (input, "l2"))
+	is_l2 = 1;
+      else if (unformat (input, "mode %U", unformat_span_mirror_mode, &mode))
+	;
+      else if (unformat (input, "snaplen %u", &snaplen))
+	;
       else if (unformat (input, "disable"))
 	disable = 1;
       else
@@ -174,32 +824,226 @@ set_span_command_fn (vlib_main_t * vm,
     }
 
   return set_span_add_delete_entry (vm, src_sw_if_index, dst_sw_if_index,
-				    disable);
+				    mode, snaplen, direction, is_l2, disable);
 }
 
 /* *INDENT-OFF* */
 VLIB_CLI_COMMAND (set_span_command, static) = {
   .path = "set span",
   .short_help =
-      "set span src <interface-name> [dst <interface-name>|disable]",
+      "set span src <interface-name>|drop [dst <interface-name>] "
+      "[rx|tx|both] "
+      "[l2] [mode copy|clone] [snaplen <n>] [disable]",
   .function = set_span_command_fn,
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+set_span_rate_limit_command_fn (vlib_main_t * vm,
+				unformat_input_t * input,
+				vlib_cli_command_t * cmd)
+{
+  span_main_t *sm = &span_main;
+  u32 dst_sw_if_index = ~0;
+  u32 max_pps = ~0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "dst %U", unformat_vnet_sw_interface,
+		    sm->vnet_main, &dst_sw_if_index))
+	;
+      else if (unformat (input, "max-pps %u", &max_pps))
+	;
+      else if (unformat (input, "disable"))
+	max_pps = 0;
+      else
+	break;
+    }
+
+  if (max_pps == ~0)
+    return clib_error_return (0, "max-pps must be set... ");
+
+  return span_set_dst_max_pps (vm, dst_sw_if_index, max_pps);
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_span_rate_limit_command, static) = {
+  .path = "set span rate-limit",
+  .short_help =
+      "set span rate-limit dst <interface-name> [max-pps <n>|disable]",
+  .function = set_span_rate_limit_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_span_classify_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  u32 src_sw_if_index = ~0;
+  u32 table_index = ~0;
+  u8 disable = 0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "src %U", unformat_span_src, &src_sw_if_index))
+	;
+      else if (unformat (input, "table %u", &table_index))
+	;
+      else if (unformat (input, "disable"))
+	disable = 1;
+      else
+	break;
+    }
+
+  if (disable)
+    table_index = ~0;
+  else if (table_index == ~0)
+    return clib_error_return (0, "Classify table must be set... ");
+
+  return span_set_classify_table (vm, src_sw_if_index, table_index);
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_span_classify_command, static) = {
+  .path = "set span classify",
+  .short_help =
+      "set span classify src <interface-name>|drop [table <n>|disable]",
+  .function = set_span_classify_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_span_sample_command_fn (vlib_main_t * vm,
+			    unformat_input_t * input,
+			    vlib_cli_command_t * cmd)
+{
+  u32 src_sw_if_index = ~0;
+  u32 mode = ~0;
+  u32 rate = 0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "src %U", unformat_span_src, &src_sw_if_index))
+	;
+      else if (unformat (input, "every %u", &rate))
+	mode = SPAN_SAMPLE_EVERY;
+      else if (unformat (input, "random %u", &rate))
+	mode = SPAN_SAMPLE_RANDOM;
+      else if (unformat (input, "flow %u", &rate))
+	mode = SPAN_SAMPLE_FLOW;
+      else if (unformat (input, "disable"))
+	mode = SPAN_SAMPLE_NONE;
+      else
+	break;
+    }
+
+  if (mode == ~0)
+    return clib_error_return (0, "Sampling mode must be set... ");
+
+  return span_set_sample (vm, src_sw_if_index, mode, rate);
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_span_sample_command, static) = {
+  .path = "set span sample",
+  .short_help =
+      "set span sample src <interface-name>|drop "
+      "[every <n>|random <n>|flow <n>|disable]",
+  .function = set_span_sample_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_span_metadata_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  u32 src_sw_if_index = ~0;
+  u32 mode = ~0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "src %U", unformat_span_src, &src_sw_if_index))
+	;
+      else if (unformat (input, "header"))
+	mode = SPAN_METADATA_HEADER;
+      else if (unformat (input, "trailer"))
+	mode = SPAN_METADATA_TRAILER;
+      else if (unformat (input, "disable"))
+	mode = SPAN_METADATA_NONE;
+      else
+	break;
+    }
+
+  if (mode == ~0)
+    return clib_error_return (0, "Metadata mode must be set... ");
+
+  return span_set_metadata (vm, src_sw_if_index, mode);
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_span_metadata_command, static) = {
+  .path = "set span metadata",
+  .short_help =
+      "set span metadata src <interface-name>|drop "
+      "[header|trailer|disable]",
+  .function = set_span_metadata_command_fn,
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
 show_span_command_fn (vlib_main_t * vm,
 		      unformat_input_t * input, vlib_cli_command_t * cmd)
 {
   span_main_t *sm = &span_main;
   vnet_main_t *vnm = &vnet_main;
-  u32 src_sw_if_index = ~0, dst_sw_if_index = ~0;
+  span_session_t *session;
+  span_dst_t *d;
+  vlib_counter_t v, dv;
+  u32 max_pps;
 
   /* *INDENT-OFF* */
   vlib_cli_output (vm, "SPAN source interface to destination interface table");
-  hash_foreach (src_sw_if_index, dst_sw_if_index, sm->dst_sw_if_index_by_src, ({
-      vlib_cli_output (vm, "%32U => %-32U",
-          format_vnet_sw_if_index_name, vnm, src_sw_if_index,
-          format_vnet_sw_if_index_name, vnm, dst_sw_if_index);
+  pool_foreach (session, sm->sessions, ({
+      vlib_cli_output (vm, "%U (%U, %U%s)",
+          format_span_src, session->src_sw_if_index,
+          format_span_mirror_mode, session->mode,
+          format_span_direction, session->direction,
+          session->is_l2 ? ", l2" : "");
+      vlib_cli_output (vm, "  %Ld mirrored packets %Ld bytes, "
+                       "%Ld copy/clone failures, %Ld rate limited",
+          span_get_counter (session->src_sw_if_index,
+                            SPAN_COUNTER_MIRRORED),
+          span_get_counter (session->src_sw_if_index,
+                            SPAN_COUNTER_MIRRORED_BYTES),
+          span_get_counter (session->src_sw_if_index,
+                            SPAN_COUNTER_COPY_FAILED),
+          span_get_counter (session->src_sw_if_index,
+                            SPAN_COUNTER_RATE_DROPPED));
+      if (session->snaplen)
+        vlib_cli_output (vm, "  snaplen %u", session->snaplen);
+      if (session->table_index != ~0)
+        vlib_cli_output (vm, "  classify table %u", session->table_index);
+      if (session->sample_mode != SPAN_SAMPLE_NONE)
+        vlib_cli_output (vm, "  sample %U 1 in %u",
+            format_span_sample_mode, session->sample_mode,
+            session->sample_rate);
+      if (session->metadata_mode != SPAN_METADATA_NONE)
+        vlib_cli_output (vm, "  metadata %U",
+            format_span_metadata_mode, session->metadata_mode);
+      vec_foreach (d, session->dsts)
+        {
+          span_get_dst_counter (d, &v);
+          span_get_dst_drop_counter (d, &dv);
+          max_pps = span_get_dst_max_pps (d->sw_if_index);
+          vlib_cli_output (vm, "  => %-32U %16Ld packets %16Ld bytes "
+                           "%16Ld rate limited",
+              format_vnet_sw_if_index_name, vnm, d->sw_if_index,
+              v.packets, v.bytes, dv.packets);
+          if (max_pps)
+            vlib_cli_output (vm, "     max-pps %u", max_pps);
+        }
   }));
   /* *INDENT-ON* */
   return 0;
@@ -217,8 +1061,22 @@ static clib_error_t *
 span_init (vlib_main_t * vm)
 {
   span_main_t *sm = &span_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  span_per_thread_data_t *ptd;
+
+#define _(sym,str) sm->counters[SPAN_COUNTER_##sym].name = "span " str;
+  foreach_span_counter
+#undef _
+  sm->dst_counters.name = "span destinations";
+  sm->dst_drop_counters.name = "span destination rate limit drops";
+  vec_validate_aligned (sm->per_thread_data, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+  vec_foreach (ptd, sm->per_thread_data)
+    ptd->random_seed = random_default_seed () + (ptd - sm->per_thread_data);
 
-  sm->dst_sw_if_index_by_src = hash_create (0, sizeof (u32));
+  sm->drop_session_index = ~0;
+  sm->buffer_free_list_index = VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX;
+  sm->buffers_per_numa = SPAN_DEFAULT_BUFFERS_PER_NUMA;
 
   sm->vlib_main = vm;
   sm->vnet_main = vnet_get_main ();
@@ -227,6 +1085,55 @@ span_init (vlib_main_t * vm)
 
 VLIB_INIT_FUNCTION (span_init);
 
+static clib_error_t *
+span_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  span_main_t *sm = &span_main;
+  vlib_buffer_free_list_t *fl;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "buffers-per-numa %u", &sm->buffers_per_numa))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  /* no pool of its own, mirror from the default free list */
+  if (sm->buffers_per_numa == 0)
+    return 0;
+
+  /* before the worker threads start, they get a copy of the free list */
+  sm->buffer_free_list_index =
+    vlib_buffer_create_free_list (vm, VLIB_BUFFER_DEFAULT_FREE_LIST_BYTES,
+				  "span");
+  fl = vlib_buffer_get_free_list (vm, sm->buffer_free_list_index);
+#if DPDK == 1
+  {
+    struct rte_mempool **pools;
+    clib_error_t *error;
+    u32 i;
+
+    /* one private mempool next to each shared one, once those exist */
+    if ((error = vlib_call_config_function (vm, dpdk_config)))
+      return error;
+
+    pools = vm->buffer_main->pktmbuf_pools;
+    for (i = 0; i < vec_len (pools); i++)
+      if (pools[i] && (error = vlib_buffer_free_list_pool_create
+		       (vm, fl->index, sm->buffers_per_numa, i)))
+	return error;
+  }
+#else
+  fl->max_n_alloc = sm->buffers_per_numa;
+#endif
+
+  return 0;
+}
+
+VLIB_CONFIG_FUNCTION (span_config, "span");
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
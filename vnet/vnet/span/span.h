@@ -18,14 +18,247 @@
 
 #include <vnet/vnet.h>
 #include <vnet/ip/ip.h>
+#include <vnet/ethernet/packet.h>
+#include <vnet/policer/xlate.h>
+#include <vnet/classify/vnet_classify.h>
+#include <vppinfra/random.h>
 
 #define VLIB_NODE_FLAG_IS_SPAN (1 << 8)
 
+/*
+ * Number of leading packet bytes privately copied into each clone head.
+ * Covers the L2 to L4 headers, so rewrite nodes never reach the payload
+ * shared between the original packet and its mirror.
+ */
+#define SPAN_CLONE_HEAD_BYTES (2 * CLIB_CACHE_LINE_BYTES)
+
+#define foreach_span_mirror_mode                \
+_(COPY, "copy")                                 \
+_(CLONE, "clone")
+
+typedef enum
+{
+#define _(sym,str) SPAN_MIRROR_MODE_##sym,
+  foreach_span_mirror_mode
+#undef _
+    SPAN_N_MIRROR_MODE,
+} span_mirror_mode_t;
+
+/*
+ * Mirrored traffic of a session, a bitmap of the RX and TX directions,
+ * or the packets dropped by error-drop for the drop session
+ */
+#define foreach_span_direction                  \
+_(1, RX, "rx")                                  \
+_(2, TX, "tx")                                  \
+_(3, BOTH, "both")                              \
+_(4, DROP, "drop")
+
+typedef enum
+{
+#define _(v,sym,str) SPAN_DIRECTION_##sym = v,
+  foreach_span_direction
+#undef _
+} span_direction_t;
+
+/*
+ * Sampling of the packets of a session, applied after the classify filter:
+ * every: deterministic, 1 packet in N per thread
+ * random: each packet with a 1/N probability
+ * flow: whole flows with a 1/N probability, keyed on the 5-tuple hash
+ */
+#define foreach_span_sample_mode                \
+_(NONE, "none")                                 \
+_(EVERY, "every")                               \
+_(RANDOM, "random")                             \
+_(FLOW, "flow")
+
+typedef enum
+{
+#define _(sym,str) SPAN_SAMPLE_##sym,
+  foreach_span_sample_mode
+#undef _
+    SPAN_N_SAMPLE_MODE,
+} span_sample_mode_t;
+
+/*
+ * Optional metadata of the mirrors of a session, written in front of the
+ * mirrored frame (header) or after it (trailer)
+ */
+#define foreach_span_metadata_mode              \
+_(NONE, "none")                                 \
+_(HEADER, "header")                             \
+_(TRAILER, "trailer")
+
+typedef enum
+{
+#define _(sym,str) SPAN_METADATA_##sym,
+  foreach_span_metadata_mode
+#undef _
+    SPAN_N_METADATA_MODE,
+} span_metadata_mode_t;
+
+/* Mirror metadata, in network byte order */
+/* *INDENT-OFF* */
+typedef CLIB_PACKED (struct
+{
+  /* CPU clock at the dispatch of the mirroring node, e.g. dpdk-input */
+  u64 timestamp;
+  u32 sequence;			/* per session, one per mirrored packet */
+  u32 sw_if_index;		/* RX or TX interface of the packet */
+  u8 direction;			/* SPAN_DIRECTION_RX, _TX or _DROP */
+  u8 pad;
+  u16 error_code;		/* drops: error of error_node, else 0 */
+  u32 error_node;		/* drops: node which set the error, else 0 */
+}) span_metadata_t;
+/* *INDENT-ON* */
+
+/* Packet selection result, stored per packet in span_per_thread_data_t */
+typedef enum
+{
+  SPAN_SELECT_FILTERED = 0,	/* missed the classify filter */
+  SPAN_SELECT_HIT = 1,		/* to be mirrored */
+  SPAN_SELECT_UNSAMPLED = 2,	/* left out by sampling */
+} span_select_t;
+
+/*
+ * Source of the drop session, which mirrors the packets freed by
+ * error-drop, ip4-drop and ip6-drop included. Not an interface index,
+ * ~0 already stands for "no interface" in the CLIs and API calls.
+ */
+#define SPAN_SRC_DROP ((u32) ~0 - 1)
+
+/* Destinations per source, bounded by the u8 clone count */
+#define SPAN_MAX_DESTINATIONS 64
+
+/*
+ * Default size of the mirror buffer pool, per NUMA socket with DPDK and
+ * per thread without. Set by "span { buffers-per-numa <n> }" in
+ * startup.conf; by default there is no pool and mirror buffers come from
+ * the shared buffer pools, so boxes without SPAN sessions pay nothing.
+ */
+#define SPAN_DEFAULT_BUFFERS_PER_NUMA 0
+
+/* Committed burst of the per-destination rate limiters */
+#define SPAN_POLICER_BURST_MS 10
+
+/* Per source interface counters, kept per thread */
+#define foreach_span_counter                    \
+_(MIRRORED, "mirrored packets")                 \
+_(MIRRORED_BYTES, "mirrored bytes")             \
+_(COPY_FAILED, "copy/clone failures")           \
+_(RATE_DROPPED, "rate limited")
+
+typedef enum
+{
+#define _(sym,str) SPAN_COUNTER_##sym,
+  foreach_span_counter
+#undef _
+    SPAN_N_COUNTER,
+} span_counter_type_t;
+
+/* span_mirror_buffer() return value if preallocated buffers ran out */
+#define SPAN_MIRROR_NO_BUFFERS ((u32) ~0)
+
+typedef struct
+{
+  u32 sw_if_index;		/* output interface index */
+  u32 counter_index;		/* index into span_main.dst_counters */
+} span_dst_t;
+
+typedef struct
+{
+  u32 src_sw_if_index;		/* mirrored interface index */
+  u32 counter_index;		/* into the per source counters */
+  u8 is_drop;			/* the drop session, from SPAN_SRC_DROP */
+  span_dst_t *dsts;		/* vector of destinations */
+  u8 mode;			/* span_mirror_mode_t */
+  u8 direction;			/* span_direction_t */
+  u8 is_l2;			/* mirrored by the l2 feature nodes */
+  u16 snaplen;			/* bytes mirrored per packet, 0 = all */
+  u32 table_index;		/* classify table filter, ~0 = none */
+  u32 rx_redirect_node_index;	/* source redirect before span-input */
+  u8 sample_mode;		/* span_sample_mode_t */
+  u32 sample_rate;		/* 1 packet or flow in sample_rate */
+  u32 sample_threshold;		/* random or hash values kept, <= this */
+  u8 metadata_mode;		/* span_metadata_mode_t */
+  volatile u32 sequence;	/* next metadata sequence number */
+} span_session_t;
+
+typedef struct
+{
+  /* mirror buffers allocated up front for a frame */
+  u32 *heads;
+  /* mirrors of a frame, for all destinations */
+  u32 *mirrors;
+  /* classifier filter state of a frame, per packet */
+  u8 **headers;
+  u64 *hashes;
+  u8 *match;			/* span_select_t */
+  /* 1-in-N sampling position, by session index */
+  u32 *sample_counts;
+  /* random sampling generator state */
+  u32 random_seed;
+  /* this thread's share of the mirror rate limiters, by policer index */
+  policer_read_response_type_st *policers;
+} span_per_thread_data_t;
+
 typedef struct
 {
-  /* destination interface index by source interface index */
-  uword *dst_sw_if_index_by_src;
-  u32 *free_span_out_nodes;
+  /* pool of mirroring sessions */
+  span_session_t *sessions;
+
+  /*
+   * session index by source interface index, ~0 if not mirrored.
+   * Read by the data plane on all threads, only changed under the
+   * worker barrier.
+   */
+  u32 *session_index_by_sw_if_index;
+
+  /* index of the drop session, ~0 if none. Same rules as above. */
+  u32 drop_session_index;
+
+  /*
+   * TX sessions of each interface and its sub-interfaces, which share
+   * the span-output feature of the interface while this is not 0
+   */
+  u32 *n_tx_sessions_by_sup_sw_if_index;
+
+  /* mirrored packets and bytes per destination */
+  vlib_combined_counter_main_t dst_counters;
+  /* packets and bytes dropped by the rate limiter, before cloning */
+  vlib_combined_counter_main_t dst_drop_counters;
+  u32 *free_dst_counter_indices;
+  u32 n_dst_counters;
+
+  /*
+   * per source counters, indexed by span_src_counter_index. Validated
+   * under the interface counter lock, which the stats thread holds
+   * while reading them.
+   */
+  vlib_simple_counter_main_t counters[SPAN_N_COUNTER];
+
+  /*
+   * mirror rate limiters, shared by all sessions using a destination.
+   * Each thread polices with a bucket of its own, in per_thread_data.
+   */
+  u32 *policer_index_by_dst_sw_if_index;
+  u32 *free_policer_indices;
+  u32 n_policers;
+  u32 *max_pps_by_dst_sw_if_index;
+
+  span_per_thread_data_t *per_thread_data;
+
+  /* next of error-drop towards interface-output, for drop mirrors */
+  u32 drop_next_index;
+
+  /*
+   * With a non-zero buffers_per_numa, mirror buffers come from a free
+   * list of their own, bounded to it, so running out of them never
+   * starves RX.
+   */
+  u32 buffer_free_list_index;
+  u32 buffers_per_numa;
 
   /* convenience */
   vlib_main_t *vlib_main;
@@ -35,32 +268,507 @@ typedef struct
 span_main_t span_main;
 
 extern vlib_node_registration_t span_node;
+extern vlib_node_registration_t span_input_node;
+extern vlib_node_registration_t span_l2_input_node;
+extern vlib_node_registration_t span_l2_output_node;
+
+always_inline span_session_t *
+get_span_drop_entry (void)
+{
+  span_main_t *sm = &span_main;
+  u32 si = sm->drop_session_index;
+
+  return si == ~0 ? 0 : pool_elt_at_index (sm->sessions, si);
+}
+
+always_inline span_session_t *
+get_span_entry (u32 src_sw_if_index)
+{
+  span_main_t *sm = &span_main;
+  u32 si;
+
+  if (PREDICT_FALSE (src_sw_if_index >=
+		     vec_len (sm->session_index_by_sw_if_index)))
+    return src_sw_if_index == SPAN_SRC_DROP ? get_span_drop_entry () : 0;
+  si = sm->session_index_by_sw_if_index[src_sw_if_index];
+  return si == ~0 ? 0 : pool_elt_at_index (sm->sessions, si);
+}
+
+/* Per source counters of a source, the drops come first */
+always_inline u32
+span_src_counter_index (u32 src_sw_if_index)
+{
+  return src_sw_if_index == SPAN_SRC_DROP ? 0 : src_sw_if_index + 1;
+}
 
 typedef struct
 {
   u32 src_sw_if_index;		/* mirrored interface index */
-  u32 mirror_sw_if_index;	/* output interface index */
+  u32 mirror_sw_if_index;	/* first output interface index */
+  u32 n_mirrors;		/* number of mirrors created */
 } span_trace_t;
 
 u8 *
 format_span_trace (u8 * s, va_list * args);
 
-vlib_buffer_t *
-span_duplicate_buffer (vlib_main_t * vm,
-				      vlib_buffer_t * b0,
-				      uword span_if_index, u8 copy);
+format_function_t format_span_mirror_mode;
+unformat_function_t unformat_span_mirror_mode;
+format_function_t format_span_sample_mode;
+format_function_t format_span_direction;
+format_function_t format_span_metadata_mode;
+format_function_t format_span_src;
+unformat_function_t unformat_span_src;
+
+/* Number of preallocated buffers needed to mirror one packet */
+always_inline u32
+span_n_heads_per_packet (span_session_t * s)
+{
+  return vec_len (s->dsts) + (s->mode == SPAN_MIRROR_MODE_CLONE
+			      && s->snaplen == 0);
+}
+
+/*
+ * First classifier pass: hash the packet at h for table t and prefetch
+ * its bucket, for a later span_classify_match() call.
+ */
+always_inline u64
+span_classify_hash (vnet_classify_table_t * t, u8 * h)
+{
+  u64 hash = vnet_classify_hash_packet_inline (t, h);
+
+  vnet_classify_prefetch_bucket (t, hash);
+  return hash;
+}
 
-uword
-span_out_register_node (vlib_main_t * vm,
-			u32 src_sw_if_index, u32 dst_sw_if_index, u8 disable);
+/*
+ * Second classifier pass: look the packet at h up in table t, then in
+ * the tables chained to it. Returns 1 on a hit.
+ */
+always_inline int
+span_classify_match (vnet_classify_main_t * vcm, vnet_classify_table_t * t,
+		     u8 * h, u64 hash, f64 now)
+{
+  while (1)
+    {
+      if (vnet_classify_find_entry_inline (t, h, hash, now))
+	return 1;
+      if (PREDICT_TRUE (t->next_table_index == ~0))
+	return 0;
+      t = pool_elt_at_index (vcm->tables, t->next_table_index);
+      hash = vnet_classify_hash_packet_inline (t, h);
+    }
+}
+
+/*
+ * Filter n packets through the classify table of session s, h[i] being
+ * the ethernet header of packet i. As in the input ACL nodes, all hashes
+ * are computed first with their buckets prefetched, then entries are
+ * looked up while prefetching 3 packets ahead. Sets match[i] for each
+ * packet and returns the number of hits.
+ */
+always_inline u32
+span_classify_packets (span_session_t * s, u8 ** h, u32 n, u64 * hashes,
+		       u8 * match, f64 now)
+{
+  vnet_classify_main_t *vcm = &vnet_classify_main;
+  vnet_classify_table_t *t = pool_elt_at_index (vcm->tables,
+						s->table_index);
+  uword skip = t->skip_n_vectors * sizeof (u32x4);
+  u32 i, n_hits = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      if (PREDICT_TRUE (i + 1 < n))
+	CLIB_PREFETCH (h[i + 1] + skip, CLIB_CACHE_LINE_BYTES, LOAD);
+      hashes[i] = span_classify_hash (t, h[i]);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      if (PREDICT_TRUE (i + 3 < n))
+	vnet_classify_prefetch_entry (t, hashes[i + 3]);
+      match[i] = span_classify_match (vcm, t, h[i], hashes[i], now);
+      n_hits += match[i];
+    }
+
+  return n_hits;
+}
+
+/* Classify a single packet, for packets outside of a filtered frame */
+always_inline int
+span_classify_one (span_session_t * s, u8 * h, f64 now)
+{
+  vnet_classify_main_t *vcm = &vnet_classify_main;
+  vnet_classify_table_t *t = pool_elt_at_index (vcm->tables,
+						s->table_index);
+
+  return span_classify_match (vcm, t, h,
+			      vnet_classify_hash_packet_inline (t, h), now);
+}
+
+/*
+ * Flow hash of the packet at ethernet header h, from the IP 5-tuple, or
+ * from the MAC addresses for non-IP packets.
+ */
+always_inline u32
+span_flow_hash (u8 * h)
+{
+  ethernet_header_t *e = (ethernet_header_t *) h;
+  u16 type = clib_net_to_host_u16 (e->type);
+
+  if (PREDICT_TRUE (type == ETHERNET_TYPE_IP4))
+    return ip4_compute_flow_hash ((ip4_header_t *) (e + 1),
+				  IP_FLOW_HASH_DEFAULT);
+  if (type == ETHERNET_TYPE_IP6)
+    return ip6_compute_flow_hash ((ip6_header_t *) (e + 1),
+				  IP_FLOW_HASH_DEFAULT);
+  return hash_memory (e->dst_address, 2 * sizeof (e->dst_address), 0);
+}
+
+/*
+ * Sample one packet of session s, h being its ethernet header.
+ * Returns 1 if the packet is kept.
+ */
+always_inline int
+span_sample (span_session_t * s, span_per_thread_data_t * ptd, u8 * h)
+{
+  u32 *count;
+
+  switch (s->sample_mode)
+    {
+    case SPAN_SAMPLE_EVERY:
+      count = vec_elt_at_index (ptd->sample_counts,
+				s - span_main.sessions);
+      if (++count[0] < s->sample_rate)
+	return 0;
+      count[0] = 0;
+      return 1;
+    case SPAN_SAMPLE_RANDOM:
+      return random_u32 (&ptd->random_seed) <= s->sample_threshold;
+    case SPAN_SAMPLE_FLOW:
+      return span_flow_hash (h) <= s->sample_threshold;
+    default:
+      return 1;
+    }
+}
+
+/* Sessions which do not mirror all of their packets */
+always_inline int
+span_session_selects (span_session_t * s)
+{
+  return s->table_index != ~0 || s->sample_mode != SPAN_SAMPLE_NONE;
+}
+
+/*
+ * Select the packets of session s to be mirrored among n packets, h[i]
+ * being the ethernet header of packet i: filter them through the classify
+ * table, then sample the hits. Sets match[i] to a span_select_t for each
+ * packet and returns the number of packets selected.
+ */
+always_inline u32
+span_select_packets (span_session_t * s, span_per_thread_data_t * ptd,
+		     u8 ** h, u32 n, f64 now)
+{
+  u32 i, n_hits;
+
+  if (s->table_index != ~0)
+    n_hits = span_classify_packets (s, h, n, ptd->hashes, ptd->match, now);
+  else
+    {
+      memset (ptd->match, SPAN_SELECT_HIT, n);
+      n_hits = n;
+    }
+
+  if (s->sample_mode != SPAN_SAMPLE_NONE)
+    for (i = 0; i < n; i++)
+      if (ptd->match[i] == SPAN_SELECT_HIT && !span_sample (s, ptd, h[i]))
+	{
+	  ptd->match[i] = SPAN_SELECT_UNSAMPLED;
+	  n_hits--;
+	}
+
+  return n_hits;
+}
+
+/* Select a single packet, for packets outside of a selected frame */
+always_inline span_select_t
+span_select_one (span_session_t * s, span_per_thread_data_t * ptd, u8 * h,
+		 f64 now)
+{
+  if (s->table_index != ~0 && !span_classify_one (s, h, now))
+    return SPAN_SELECT_FILTERED;
+  if (s->sample_mode != SPAN_SAMPLE_NONE && !span_sample (s, ptd, h))
+    return SPAN_SELECT_UNSAMPLED;
+  return SPAN_SELECT_HIT;
+}
+
+/*
+ * Police one mirror to a rate limited destination, with the bucket of
+ * the calling thread, which holds its share of the rate.
+ * Returns 1 if the mirror may be sent.
+ */
+always_inline int
+span_police_dst (span_main_t * sm, u32 dst_sw_if_index, u64 * time)
+{
+  span_per_thread_data_t *ptd;
+  policer_read_response_type_st *pol;
+  policer_result_e col;
+  u32 pi;
+
+  if (PREDICT_TRUE (dst_sw_if_index >=
+		    vec_len (sm->policer_index_by_dst_sw_if_index)))
+    return 1;
+  pi = sm->policer_index_by_dst_sw_if_index[dst_sw_if_index];
+  if (PREDICT_TRUE (pi == ~0))
+    return 1;
+
+  if (*time == 0)
+    *time = clib_cpu_time_now () >> POLICER_TICKS_PER_PERIOD_SHIFT;
+
+  ptd = vec_elt_at_index (sm->per_thread_data, os_get_cpu_number ());
+  pol = vec_elt_at_index (ptd->policers, pi);
+  /* rates are in pps, so every packet costs the same */
+  col = vnet_police_packet (pol, SSE2_QOS_POLICER_FIXED_PKT_SIZE,
+			    POLICE_CONFORM, *time);
+
+  return pol->action[col] != SSE2_QOS_ACTION_DROP;
+}
+
+/*
+ * Write metadata md in front of mirror c0, or after its last byte. The
+ * mirror has just been copied or cloned, so its first and last cache lines
+ * are still hot. Skipped if the buffer has no headroom or tailroom left.
+ * Trailers are only added to private buffers: clone tails are shared.
+ */
+always_inline void
+span_add_metadata (vlib_main_t * vm, vlib_buffer_t * c0, u8 mode,
+		   span_metadata_t * md)
+{
+  vlib_buffer_t *l0 = c0;
+  word n = sizeof (*md);
+
+  if (mode == SPAN_METADATA_HEADER)
+    {
+      if (PREDICT_FALSE (c0->current_data - n < -VLIB_BUFFER_PRE_DATA_SIZE))
+	return;
+      vlib_buffer_advance (c0, -n);
+      clib_memcpy (vlib_buffer_get_current (c0), md, n);
+      vnet_buffer (c0)->span.frame_offset = n;
+#if DPDK == 1
+      {
+	struct rte_mbuf *mb = rte_mbuf_from_vlib_buffer (c0);
+	mb->data_off -= n;
+	mb->data_len += n;
+	mb->pkt_len += n;
+      }
+#endif
+      return;
+    }
+
+  while (l0->flags & VLIB_BUFFER_NEXT_PRESENT)
+    l0 = vlib_get_buffer (vm, l0->next_buffer);
+  if (PREDICT_FALSE (l0->current_data + l0->current_length + n >
+		     vlib_buffer_free_list_buffer_size (vm,
+							l0->free_list_index)))
+    return;
+  clib_memcpy (vlib_buffer_get_current (l0) + l0->current_length, md, n);
+  l0->current_length += n;
+  if (l0 != c0)
+    c0->total_length_not_including_first_buffer += n;
+#if DPDK == 1
+  rte_mbuf_from_vlib_buffer (l0)->data_len += n;
+  rte_mbuf_from_vlib_buffer (c0)->pkt_len += n;
+#endif
+}
+
+/*
+ * Create one mirror of buffer *bi0 per session destination, from
+ * preallocated buffers. Rate limited destinations are policed first,
+ * so no buffer is copied or cloned for a mirror which would be dropped.
+ * In clone mode *bi0 is replaced by a fresh head which shares the packet
+ * tail with all mirrors. With a snaplen set, each mirror is a single
+ * buffer holding at most snaplen bytes of the first segment, whatever
+ * the mode. Mirror buffer indices are stored to mirrors[], which must
+ * have room for all destinations, and their number to *n_mirrors.
+ * The session metadata, if any, is added to each mirror, with direction
+ * dir of the packet. The original packet length, plus the metadata, is
+ * kept in the span buffer metadata, and the
+ * counters of the source interface are updated. Returns the number of
+ * preallocated buffers used, or SPAN_MIRROR_NO_BUFFERS if there were not
+ * enough of them.
+ */
+always_inline u32
+span_mirror_buffer (vlib_main_t * vm, u32 * bi0, u32 * heads, u32 n_heads,
+		    span_session_t * s, span_direction_t dir, u32 * mirrors,
+		    u32 * n_mirrors)
+{
+  span_main_t *sm = &span_main;
+  vlib_buffer_t *b0 = vlib_get_buffer (vm, *bi0);
+  u32 n_dsts = vec_len (s->dsts);
+  u32 cpu_index = os_get_cpu_number ();
+  u32 len0 = vlib_buffer_length_in_chain (vm, b0);
+  u8 dst_index[SPAN_MAX_DESTINATIONS];
+  span_metadata_t md;
+  u32 md_len = 0;
+  u32 i, n_used, n_pass = 0, n = 0, n_failed = 0, n_bytes = 0;
+  u64 time = 0;
+
+  *n_mirrors = 0;
+
+  /* check for the worst case before policing, which must happen once */
+  if (PREDICT_FALSE (n_heads < span_n_heads_per_packet (s)))
+    return SPAN_MIRROR_NO_BUFFERS;
+
+  for (i = 0; i < n_dsts; i++)
+    {
+      span_dst_t *d = vec_elt_at_index (s->dsts, i);
+
+      if (PREDICT_TRUE (span_police_dst (sm, d->sw_if_index, &time)))
+	dst_index[n_pass++] = i;
+      else
+	vlib_increment_combined_counter (&sm->dst_drop_counters, cpu_index,
+					 d->counter_index, 1, len0);
+    }
+
+  if (PREDICT_FALSE (n_pass < n_dsts))
+    vlib_increment_simple_counter (&sm->counters[SPAN_COUNTER_RATE_DROPPED],
+				   cpu_index, s->counter_index,
+				   n_dsts - n_pass);
+
+  if (PREDICT_FALSE (n_pass == 0))
+    return 0;
+
+  /* from the original, before clone mode re-heads it */
+  if (PREDICT_FALSE (s->metadata_mode != SPAN_METADATA_NONE))
+    {
+      md.timestamp = clib_host_to_net_u64 (vm->cpu_time_last_node_dispatch);
+      md.sequence =
+	clib_host_to_net_u32 (__sync_fetch_and_add (&s->sequence, 1));
+      md.sw_if_index = clib_host_to_net_u32
+	(vnet_buffer (b0)->sw_if_index[dir == SPAN_DIRECTION_TX ?
+				       VLIB_TX : VLIB_RX]);
+      md.direction = dir;
+      md.pad = 0;
+      md.error_code = md.error_node = 0;
+      if (dir == SPAN_DIRECTION_DROP)
+	{
+	  md.error_code = clib_host_to_net_u16 (vlib_error_get_code
+						(b0->error));
+	  md.error_node = clib_host_to_net_u32 (vlib_error_get_node
+						(b0->error));
+	}
+      md_len = sizeof (md);
+    }
+
+  if (PREDICT_FALSE (s->snaplen != 0))
+    {
+      for (i = 0; i < n_pass; i++)
+	vlib_buffer_copy_head_to (vm, b0, heads[i], s->snaplen);
+      clib_memcpy (mirrors, heads, n_pass * sizeof (u32));
+      n_used = n_pass;
+    }
+  /*
+   * RX originals still go through the graph, where nodes may rewrite the
+   * packet past the head in place: only TX and drop mirrors share the
+   * tail of the original, RX mirrors are copies.
+   */
+  else if (s->mode == SPAN_MIRROR_MODE_CLONE && dir != SPAN_DIRECTION_RX
+	   && b0->current_length >
+	   SPAN_CLONE_HEAD_BYTES + VLIB_BUFFER_CLONE_MIN_TAIL_BYTES)
+    {
+      vlib_buffer_clone_to_heads (vm, *bi0, heads, n_pass + 1,
+				  SPAN_CLONE_HEAD_BYTES);
+      *bi0 = heads[0];
+      clib_memcpy (mirrors, heads + 1, n_pass * sizeof (u32));
+      n_used = n_pass + 1;
+    }
+  else
+    {
+      /* on failure the head has been freed, it still counts as used */
+      for (i = 0; i < n_pass; i++)
+	{
+	  vlib_buffer_t *c0 = vlib_buffer_copy_to (vm, b0, heads[i]);
+	  mirrors[i] = c0 ? vlib_get_buffer_index (vm, c0) : ~0;
+	}
+      n_used = n_pass;
+    }
+
+  for (i = 0; i < n_pass; i++)
+    {
+      span_dst_t *d = vec_elt_at_index (s->dsts, dst_index[i]);
+      vlib_buffer_t *c0;
+      u32 c0_len;
+
+      if (PREDICT_FALSE (mirrors[i] == ~0))
+	{
+	  n_failed++;
+	  continue;
+	}
+
+      c0 = vlib_get_buffer (vm, mirrors[i]);
+      /* mirrors go through the output features of their destination */
+      c0->flags = (c0->flags | VLIB_NODE_FLAG_IS_SPAN)
+	& ~BUFFER_OUTPUT_FEAT_DONE;
+      vnet_buffer (c0)->sw_if_index[VLIB_TX] = d->sw_if_index;
+      vnet_buffer (c0)->span.orig_length = len0 + md_len;
+      vnet_buffer (c0)->span.frame_offset = 0;
+      if (PREDICT_FALSE (md_len != 0))
+	span_add_metadata (vm, c0, s->metadata_mode, &md);
+      c0_len = vlib_buffer_length_in_chain (vm, c0);
+      vlib_increment_combined_counter (&sm->dst_counters, cpu_index,
+				       d->counter_index, 1, c0_len);
+      n_bytes += c0_len;
+      mirrors[n++] = mirrors[i];
+    }
+  *n_mirrors = n;
+
+  if (PREDICT_TRUE (n != 0))
+    {
+      vlib_increment_simple_counter (&sm->counters[SPAN_COUNTER_MIRRORED],
+				     cpu_index, s->counter_index, n);
+      vlib_increment_simple_counter
+	(&sm->counters[SPAN_COUNTER_MIRRORED_BYTES], cpu_index,
+	 s->counter_index, n_bytes);
+    }
+  if (PREDICT_FALSE (n_failed != 0))
+    vlib_increment_simple_counter (&sm->counters[SPAN_COUNTER_COPY_FAILED],
+				   cpu_index, s->counter_index, n_failed);
+
+  return n_used;
+}
 
 u32
-get_span_entry (u32 src_sw_if_index);
+span_duplicate_buffer (vlib_main_t * vm, u32 * bi0, span_session_t * s,
+		       span_direction_t dir, u32 ** mirrors);
+
+void span_mirror_drops (vlib_main_t * vm, vlib_node_runtime_t * node,
+			vlib_frame_t * frame);
 
 clib_error_t *
 set_span_add_delete_entry (vlib_main_t * vm,
-					 u32 src_sw_if_index,
-					 u32 dst_sw_if_index, u8 disable);
+			   u32 src_sw_if_index,
+			   u32 dst_sw_if_index,
+			   span_mirror_mode_t mode, u32 snaplen,
+			   span_direction_t direction, u32 is_l2,
+			   u8 disable);
+
+void span_get_dst_counter (span_dst_t * d, vlib_counter_t * result);
+u64 span_get_counter (u32 src_sw_if_index, span_counter_type_t type);
+void span_get_dst_drop_counter (span_dst_t * d, vlib_counter_t * result);
+
+clib_error_t *span_set_dst_max_pps (vlib_main_t * vm, u32 dst_sw_if_index,
+				    u32 max_pps);
+u32 span_get_dst_max_pps (u32 dst_sw_if_index);
+int span_dst_in_use (u32 dst_sw_if_index);
+
+clib_error_t *span_set_classify_table (vlib_main_t * vm,
+				       u32 src_sw_if_index, u32 table_index);
+
+clib_error_t *span_set_sample (vlib_main_t * vm, u32 src_sw_if_index,
+			       span_sample_mode_t mode, u32 rate);
+
+clib_error_t *span_set_metadata (vlib_main_t * vm, u32 src_sw_if_index,
+				 span_metadata_mode_t mode);
 
 #endif /* __span_h__ */
 
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vppinfra/error.h>
+
+#include <vnet/span/span.h>
+#include <vnet/span/span_group.h>
+
+#define foreach_span_group_tx_error                 \
+_(NO_MEMBERS, "span group without members, mirrors dropped") \
+_(DELETED, "span group deleted, mirrors dropped")
+
+typedef enum
+{
+#define _(sym,str) SPAN_GROUP_TX_ERROR_##sym,
+  foreach_span_group_tx_error
+#undef _
+    SPAN_GROUP_TX_N_ERROR,
+} span_group_tx_error_t;
+
+static char *span_group_tx_error_strings[] = {
+#define _(sym,string) string,
+  foreach_span_group_tx_error
+#undef _
+};
+
+/* interface-output, which sends each buffer to its own TX interface */
+static u32 span_group_interface_output_node_index;
+
+u8 *
+format_span_group (u8 * s, va_list * args)
+{
+  span_group_t *g = va_arg (*args, span_group_t *);
+  span_group_main_t *sgm = &span_group_main;
+  u32 i;
+
+  s = format (s, "[%d] %U members %d", g - sgm->groups,
+	      format_vnet_sw_if_index_name, sgm->vnet_main, g->sw_if_index,
+	      vec_len (g->members));
+  for (i = 0; i < vec_len (g->members); i++)
+    s = format (s, "\n  %U %u buckets", format_vnet_sw_if_index_name,
+		sgm->vnet_main, g->members[i], g->n_buckets[i]);
+  return s;
+}
+
+static u8 *
+format_span_group_name (u8 * s, va_list * args)
+{
+  u32 dev_instance = va_arg (*args, u32);
+  return format (s, "span_group%d", dev_instance);
+}
+
+/*
+ * Send each mirror of a frame to the member owning the bucket of its
+ * symmetric flow hash, through interface-output. The hash skips the
+ * metadata header of mirrors, if any.
+ */
+static uword
+span_group_tx (vlib_main_t * vm,
+	       vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  span_group_main_t *sgm = &span_group_main;
+  vnet_interface_output_runtime_t *rd = (void *) node->runtime_data;
+  /* hw interfaces are reused, so their dev_instance may have changed */
+  vnet_hw_interface_t *hi =
+    vnet_get_hw_interface (sgm->vnet_main, rd->hw_if_index);
+  u32 *from = vlib_frame_vector_args (frame);
+  u32 n_left = frame->n_vectors;
+  vlib_frame_t *f;
+  span_group_t *g;
+  u32 *to_next, i;
+
+  /* frames still pending when the group was deleted */
+  if (PREDICT_FALSE (pool_is_free_index (sgm->groups, hi->dev_instance)))
+    {
+      vlib_buffer_free (vm, from, n_left);
+      vlib_error_count (vm, node->node_index,
+			SPAN_GROUP_TX_ERROR_DELETED, n_left);
+      return n_left;
+    }
+
+  g = pool_elt_at_index (sgm->groups, hi->dev_instance);
+
+  if (PREDICT_FALSE (vec_len (g->members) == 0))
+    {
+      vlib_buffer_free (vm, from, n_left);
+      vlib_error_count (vm, node->node_index,
+			SPAN_GROUP_TX_ERROR_NO_MEMBERS, n_left);
+      return n_left;
+    }
+
+  f = vlib_get_frame_to_node (vm, span_group_interface_output_node_index);
+  to_next = vlib_frame_vector_args (f);
+
+  for (i = 0; i < n_left; i++)
+    {
+      vlib_buffer_t *b0;
+      u32 offset0, hash0;
+
+      if (PREDICT_TRUE (i + 2 < n_left))
+	{
+	  vlib_buffer_t *p2 = vlib_get_buffer (vm, from[i + 2]);
+	  vlib_prefetch_buffer_header (p2, STORE);
+	  CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	}
+
+      b0 = vlib_get_buffer (vm, from[i]);
+      offset0 = (b0->flags & VLIB_NODE_FLAG_IS_SPAN) ?
+	vnet_buffer (b0)->span.frame_offset : 0;
+      hash0 = span_group_flow_hash (vlib_buffer_get_current (b0) + offset0,
+				    b0->current_length - offset0);
+
+      vnet_buffer (b0)->sw_if_index[VLIB_TX] =
+	g->buckets[hash0 & (SPAN_GROUP_N_BUCKETS - 1)];
+      /* mirrors go through the output features of their member */
+      b0->flags &= ~BUFFER_OUTPUT_FEAT_DONE;
+      to_next[i] = from[i];
+    }
+
+  f->n_vectors = n_left;
+  vlib_put_frame_to_node (vm, span_group_interface_output_node_index, f);
+
+  return n_left;
+}
+
+static clib_error_t *
+span_group_interface_admin_up_down (vnet_main_t * vnm, u32 hw_if_index,
+				    u32 flags)
+{
+  if (flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)
+    vnet_hw_interface_set_flags (vnm, hw_if_index,
+				 VNET_HW_INTERFACE_FLAG_LINK_UP);
+  else
+    vnet_hw_interface_set_flags (vnm, hw_if_index, 0);
+
+  return /* no error */ 0;
+}
+
+/* *INDENT-OFF* */
+VNET_DEVICE_CLASS (span_group_device_class,static) = {
+  .name = "SPAN-group",
+  .format_device_name = format_span_group_name,
+  .tx_function = span_group_tx,
+  .tx_function_n_errors = SPAN_GROUP_TX_N_ERROR,
+  .tx_function_error_strings = span_group_tx_error_strings,
+  .admin_up_down_function = span_group_interface_admin_up_down,
+};
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+VNET_HW_INTERFACE_CLASS (span_group_hw_class) = {
+  .name = "SPAN-group",
+};
+/* *INDENT-ON* */
+
+/*
+ * Give buckets to new member mi, taken one at a time from the member
+ * with the most of them, until it has its share. Only the buckets taken
+ * are remapped, flows of all other buckets keep their member.
+ */
+static void
+span_group_buckets_add (span_group_t * g, u32 mi)
+{
+  u32 n_members = vec_len (g->members);
+  u32 share = SPAN_GROUP_N_BUCKETS / n_members;
+  u32 i, j, max;
+
+  if (n_members == 1)
+    {
+      for (i = 0; i < SPAN_GROUP_N_BUCKETS; i++)
+	g->buckets[i] = g->members[mi];
+      g->n_buckets[mi] = SPAN_GROUP_N_BUCKETS;
+      return;
+    }
+
+  while (g->n_buckets[mi] < share)
+    {
+      max = mi == 0 ? 1 : 0;
+      for (j = 0; j < n_members; j++)
+	if (j != mi && g->n_buckets[j] > g->n_buckets[max])
+	  max = j;
+
+      for (i = 0; i < SPAN_GROUP_N_BUCKETS; i++)
+	if (g->buckets[i] == g->members[max])
+	  break;
+
+      g->buckets[i] = g->members[mi];
+      g->n_buckets[max]--;
+      g->n_buckets[mi]++;
+    }
+}
+
+/*
+ * Hand the buckets of member mi over, one at a time, to the member with
+ * the fewest of them. Only the buckets of mi are remapped.
+ */
+static void
+span_group_buckets_del (span_group_t * g, u32 mi)
+{
+  u32 n_members = vec_len (g->members);
+  u32 i, j, min;
+
+  for (i = 0; i < SPAN_GROUP_N_BUCKETS; i++)
+    {
+      if (g->buckets[i] != g->members[mi])
+	continue;
+
+      if (n_members == 1)
+	{
+	  g->buckets[i] = ~0;
+	  continue;
+	}
+
+      min = mi == 0 ? 1 : 0;
+      for (j = 0; j < n_members; j++)
+	if (j != mi && g->n_buckets[j] < g->n_buckets[min])
+	  min = j;
+
+      g->buckets[i] = g->members[min];
+      g->n_buckets[min]++;
+    }
+}
+
+clib_error_t *
+span_group_add_del_member (vlib_main_t * vm, u32 group_sw_if_index,
+			   u32 member_sw_if_index, u8 is_add)
+{
+  span_group_main_t *sgm = &span_group_main;
+  vnet_main_t *vnm = sgm->vnet_main;
+  vnet_hw_interface_t *hi;
+  span_group_t *g;
+  u32 mi;
+
+  hi = vnet_get_sup_hw_interface (vnm, group_sw_if_index);
+  if (hi->dev_class_index != span_group_device_class.index)
+    return clib_error_return (0, "%U is not a span group",
+			      format_vnet_sw_if_index_name, vnm,
+			      group_sw_if_index);
+  g = pool_elt_at_index (sgm->groups, hi->dev_instance);
+
+  for (mi = 0; mi < vec_len (g->members); mi++)
+    if (g->members[mi] == member_sw_if_index)
+      break;
+
+  if (is_add)
+    {
+      if (mi < vec_len (g->members))
+	return clib_error_return (0, "%U is a member already",
+				  format_vnet_sw_if_index_name, vnm,
+				  member_sw_if_index);
+      if (vec_len (g->members) >= SPAN_GROUP_MAX_MEMBERS)
+	return clib_error_return (0, "span group has %d members already",
+				  SPAN_GROUP_MAX_MEMBERS);
+      /* groups of groups could loop */
+      hi = vnet_get_sup_hw_interface (vnm, member_sw_if_index);
+      if (hi->dev_class_index == span_group_device_class.index)
+	return clib_error_return (0, "a span group can't be a member");
+    }
+  else if (mi == vec_len (g->members))
+    return clib_error_return (0, "%U is not a member",
+			      format_vnet_sw_if_index_name, vnm,
+			      member_sw_if_index);
+
+  /* buckets are read by the data plane on all threads */
+  vlib_worker_thread_barrier_sync (vm);
+  if (is_add)
+    {
+      vec_add1 (g->members, member_sw_if_index);
+      vec_add1 (g->n_buckets, 0);
+      span_group_buckets_add (g, mi);
+    }
+  else
+    {
+      span_group_buckets_del (g, mi);
+      vec_delete (g->members, 1, mi);
+      vec_delete (g->n_buckets, 1, mi);
+    }
+  vlib_worker_thread_barrier_release (vm);
+
+  return 0;
+}
+
+clib_error_t *
+span_group_add_del (vlib_main_t * vm, u8 is_add, u32 * sw_if_indexp)
+{
+  span_group_main_t *sgm = &span_group_main;
+  vnet_main_t *vnm = sgm->vnet_main;
+  vnet_hw_interface_t *hi;
+  span_group_t *g;
+  u32 hw_if_index, sw_if_index;
+
+  if (is_add)
+    {
+      pool_get_aligned (sgm->groups, g, CLIB_CACHE_LINE_BYTES);
+      memset (g, 0, sizeof (*g));
+      vec_validate_aligned (g->buckets, SPAN_GROUP_N_BUCKETS - 1,
+			    CLIB_CACHE_LINE_BYTES);
+      /* no member, ~0 */
+      memset (g->buckets, 0xff, vec_bytes (g->buckets));
+
+      if (vec_len (sgm->free_hw_if_indices) > 0)
+	{
+	  vnet_interface_main_t *im = &vnm->interface_main;
+	  hw_if_index = vec_pop (sgm->free_hw_if_indices);
+
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	  hi->dev_instance = g - sgm->groups;
+	  hi->hw_instance = hi->dev_instance;
+
+	  /* clear old stats of freed group before reuse */
+	  sw_if_index = hi->sw_if_index;
+	  vnet_interface_counter_lock (im);
+	  vlib_zero_combined_counter
+	    (&im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_TX],
+	     sw_if_index);
+	  vlib_zero_simple_counter
+	    (&im->sw_if_counters[VNET_INTERFACE_COUNTER_DROP], sw_if_index);
+	  vnet_interface_counter_unlock (im);
+	}
+      else
+	{
+	  hw_if_index = vnet_register_interface
+	    (vnm, span_group_device_class.index, g - sgm->groups,
+	     span_group_hw_class.index, g - sgm->groups);
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	}
+
+      g->hw_if_index = hw_if_index;
+      g->sw_if_index = sw_if_index = hi->sw_if_index;
+
+      vnet_sw_interface_set_flags (vnm, sw_if_index,
+				   VNET_SW_INTERFACE_FLAG_ADMIN_UP);
+    }
+  else
+    {
+      hi = vnet_get_sup_hw_interface (vnm, *sw_if_indexp);
+      if (hi->dev_class_index != span_group_device_class.index)
+	return clib_error_return (0, "%U is not a span group",
+				  format_vnet_sw_if_index_name, vnm,
+				  *sw_if_indexp);
+
+      /* the hw interface is reused by the next group */
+      if (span_dst_in_use (*sw_if_indexp))
+	return clib_error_return (0, "%U is the destination of a SPAN "
+				  "session, disable it first",
+				  format_vnet_sw_if_index_name, vnm,
+				  *sw_if_indexp);
+
+      g = pool_elt_at_index (sgm->groups, hi->dev_instance);
+      sw_if_index = g->sw_if_index;
+
+      vnet_sw_interface_set_flags (vnm, sw_if_index, 0 /* down */ );
+
+      /*
+       * Free the group while workers are stopped. Frames still pending to
+       * the TX node then find it freed and drop their mirrors.
+       */
+      vlib_worker_thread_barrier_sync (vm);
+      vec_add1 (sgm->free_hw_if_indices, g->hw_if_index);
+      vec_free (g->buckets);
+      vec_free (g->members);
+      vec_free (g->n_buckets);
+      pool_put (sgm->groups, g);
+      vlib_worker_thread_barrier_release (vm);
+    }
+
+  *sw_if_indexp = sw_if_index;
+
+  return 0;
+}
+
+static clib_error_t *
+create_span_group_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  u32 sw_if_index;
+  clib_error_t *error;
+
+  error = span_group_add_del (vm, 1 /* is_add */ , &sw_if_index);
+  if (!error)
+    vlib_cli_output (vm, "%U\n", format_vnet_sw_if_index_name,
+		     vnet_get_main (), sw_if_index);
+
+  return error;
+}
+
+/*?
+ * Create a load balanced SPAN destination, a span_group<n> interface.
+ * Mirrors sent to it are spread over its members with a symmetric flow
+ * hash, so that both directions of a flow reach the same member.
+ *
+ * @cliexpar
+ * Example of how to spread the traffic of an interface over 2 analyzers:
+ * @cliexcmd{create span group}
+ * @cliexcmd{set span group span_group0 member GigabitEthernet0/9/0}
+ * @cliexcmd{set span group span_group0 member GigabitEthernet0/a/0}
+ * @cliexcmd{set span src GigabitEthernet0/8/0 dst span_group0}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (create_span_group_command, static) = {
+  .path = "create span group",
+  .short_help = "create span group",
+  .function = create_span_group_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+delete_span_group_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 sw_if_index;
+
+  if (!unformat (input, "%U", unformat_vnet_sw_interface, vnm,
+		 &sw_if_index))
+    return clib_error_return (0, "unknown interface `%U'",
+			      format_unformat_error, input);
+
+  return span_group_add_del (vm, 0 /* is_add */ , &sw_if_index);
+}
+
+/*?
+ * Delete a load balanced SPAN destination.
+ *
+ * @cliexpar
+ * @cliexcmd{delete span group span_group0}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (delete_span_group_command, static) = {
+  .path = "delete span group",
+  .short_help = "delete span group <interface>",
+  .function = delete_span_group_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_span_group_command_fn (vlib_main_t * vm,
+			   unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 group_sw_if_index = ~0, member_sw_if_index = ~0;
+  u8 is_add = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "member %U", unformat_vnet_sw_interface, vnm,
+		    &member_sw_if_index))
+	;
+      else if (unformat (input, "del"))
+	is_add = 0;
+      else if (unformat (input, "%U", unformat_vnet_sw_interface, vnm,
+			 &group_sw_if_index))
+	;
+      else
+	return clib_error_return (0, "parse error: '%U'",
+				  format_unformat_error, input);
+    }
+
+  if (group_sw_if_index == ~0)
+    return clib_error_return (0, "span group not specified");
+  if (member_sw_if_index == ~0)
+    return clib_error_return (0, "member not specified");
+
+  return span_group_add_del_member (vm, group_sw_if_index,
+				    member_sw_if_index, is_add);
+}
+
+/*?
+ * Add or remove a member interface of a load balanced SPAN destination.
+ * The new member takes over its share of hash buckets from the members
+ * with the most of them, a removed member hands its buckets over to the
+ * members with the fewest. Flows of all other buckets stay on their
+ * member.
+ *
+ * @cliexpar
+ * @cliexcmd{set span group span_group0 member GigabitEthernet0/9/0 del}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_span_group_command, static) = {
+  .path = "set span group",
+  .short_help = "set span group <interface> member <interface> [del]",
+  .function = set_span_group_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+show_span_group_command_fn (vlib_main_t * vm,
+			    unformat_input_t * input,
+			    vlib_cli_command_t * cmd)
+{
+  span_group_main_t *sgm = &span_group_main;
+  span_group_t *g;
+
+  if (pool_elts (sgm->groups) == 0)
+    vlib_cli_output (vm, "No span groups configured...");
+
+  /* *INDENT-OFF* */
+  pool_foreach (g, sgm->groups,
+  ({
+    vlib_cli_output (vm, "%U", format_span_group, g);
+  }));
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_span_group_command, static) = {
+  .path = "show span group",
+  .short_help = "show span group",
+  .function = show_span_group_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+span_group_init (vlib_main_t * vm)
+{
+  span_group_main_t *sgm = &span_group_main;
+  vlib_node_t *n;
+
+  sgm->vlib_main = vm;
+  sgm->vnet_main = vnet_get_main ();
+
+  n = vlib_get_node_by_name (vm, (u8 *) "interface-output");
+  if (n == 0)
+    return clib_error_return (0, "interface-output node AWOL");
+  span_group_interface_output_node_index = n->index;
+
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (span_group_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __span_group_h__
+#define __span_group_h__
+
+#include <vnet/vnet.h>
+#include <vnet/ip/ip.h>
+#include <vnet/ethernet/ethernet.h>
+#include <vppinfra/xxhash.h>
+
+/*
+ * Load balanced SPAN destinations: span_group<n> interfaces. Their TX
+ * node spreads mirrors over the member interfaces with a symmetric flow
+ * hash, so both directions of a flow reach the same analyzer.
+ */
+
+/* Hash buckets of a group, a power of 2 */
+#define SPAN_GROUP_N_BUCKETS 1024
+
+/* Members of a group */
+#define SPAN_GROUP_MAX_MEMBERS 64
+
+typedef struct
+{
+  /* member sw_if_index by bucket */
+  u32 *buckets;
+
+  /* member interfaces, and the number of buckets of each of them */
+  u32 *members;
+  u32 *n_buckets;
+
+  /* vnet intfc hw/sw_if_index */
+  u32 hw_if_index;
+  u32 sw_if_index;
+} span_group_t;
+
+typedef struct
+{
+  /* pool of load balanced destinations */
+  span_group_t *groups;
+
+  /* free hw_if_indices of deleted groups */
+  u32 *free_hw_if_indices;
+
+  /* convenience */
+  vlib_main_t *vlib_main;
+  vnet_main_t *vnet_main;
+} span_group_main_t;
+
+span_group_main_t span_group_main;
+
+clib_error_t *span_group_add_del (vlib_main_t * vm, u8 is_add,
+				  u32 * sw_if_indexp);
+clib_error_t *span_group_add_del_member (vlib_main_t * vm,
+					 u32 group_sw_if_index,
+					 u32 member_sw_if_index, u8 is_add);
+
+format_function_t format_span_group;
+
+/* Sort a pair of values, so that hashing them ignores the direction */
+#define span_group_sort(_a, _b)                 \
+do {                                            \
+  if ((_a) > (_b))                              \
+    {                                           \
+      typeof (_a) _t = (_a);                    \
+      (_a) = (_b);                              \
+      (_b) = _t;                                \
+    }                                           \
+} while (0)
+
+/*
+ * Symmetric flow hash of the ethernet frame at h, of n_bytes bytes: the
+ * same for both directions of a flow. Hashes the IP addresses, protocol
+ * and TCP/UDP ports, or the MAC addresses of non-IP frames. Up to 2
+ * VLAN tags are skipped.
+ */
+always_inline u32
+span_group_flow_hash (u8 * h, u32 n_bytes)
+{
+  ethernet_header_t *e = (ethernet_header_t *) h;
+  u8 *l3 = (u8 *) (e + 1);
+  u16 type = clib_net_to_host_u16 (e->type);
+  u64 a, b, ports = 0;
+  u8 proto, *l4 = 0;
+  int i;
+
+  for (i = 0; i < 2 && (type == ETHERNET_TYPE_VLAN
+			|| type == ETHERNET_TYPE_DOT1AD)
+       && l3 + sizeof (ethernet_vlan_header_t) <= h + n_bytes; i++)
+    {
+      ethernet_vlan_header_t *v = (ethernet_vlan_header_t *) l3;
+      type = clib_net_to_host_u16 (v->type);
+      l3 = (u8 *) (v + 1);
+    }
+
+  if (type == ETHERNET_TYPE_IP4
+      && l3 + sizeof (ip4_header_t) <= h + n_bytes)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) l3;
+      a = ip4->src_address.as_u32;
+      b = ip4->dst_address.as_u32;
+      proto = ip4->protocol;
+      if (!ip4_get_fragment_offset (ip4))
+	l4 = l3 + ip4_header_bytes (ip4);
+    }
+  else if (type == ETHERNET_TYPE_IP6
+	   && l3 + sizeof (ip6_header_t) <= h + n_bytes)
+    {
+      ip6_header_t *ip6 = (ip6_header_t *) l3;
+      a = ip6->src_address.as_u64[0] ^ ip6->src_address.as_u64[1];
+      b = ip6->dst_address.as_u64[0] ^ ip6->dst_address.as_u64[1];
+      proto = ip6->protocol;
+      l4 = (u8 *) (ip6 + 1);
+    }
+  else
+    {
+      a = b = 0;
+      clib_memcpy (&a, e->src_address, sizeof (e->src_address));
+      clib_memcpy (&b, e->dst_address, sizeof (e->dst_address));
+      proto = 0;
+    }
+
+  if ((proto == IP_PROTOCOL_TCP || proto == IP_PROTOCOL_UDP)
+      && l4 && l4 + sizeof (udp_header_t) <= h + n_bytes)
+    {
+      udp_header_t *udp = (udp_header_t *) l4;
+      u16 sport = udp->src_port, dport = udp->dst_port;
+      span_group_sort (sport, dport);
+      ports = ((u64) sport << 16) | dport;
+    }
+
+  span_group_sort (a, b);
+  ports |= (u64) proto << 32;
+  return clib_xxhash (a ^ clib_xxhash (b ^ clib_xxhash (ports)));
+}
+
+#endif /* __span_group_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
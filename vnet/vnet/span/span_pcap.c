@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vlib/threads.h>
+#include <vppinfra/error.h>
+
+#include <vnet/span/span.h>
+#include <vnet/span/span_pcap.h>
+
+static vlib_node_registration_t span_pcap_writer_node;
+
+#define foreach_span_pcap_tx_error                  \
+_(RING_FULL, "pcap ring full, mirrors dropped")     \
+_(DELETED, "pcap destination deleted, mirrors dropped")
+
+typedef enum
+{
+#define _(sym,str) SPAN_PCAP_TX_ERROR_##sym,
+  foreach_span_pcap_tx_error
+#undef _
+    SPAN_PCAP_TX_N_ERROR,
+} span_pcap_tx_error_t;
+
+static char *span_pcap_tx_error_strings[] = {
+#define _(sym,string) string,
+  foreach_span_pcap_tx_error
+#undef _
+};
+
+u8 *
+format_span_pcap (u8 * s, va_list * args)
+{
+  span_pcap_t *p = va_arg (*args, span_pcap_t *);
+  span_pcap_main_t *spm = &span_pcap_main;
+
+  s = format (s, "[%d] %U file %s ring-size %u written %Lu",
+	      p - spm->destinations, format_vnet_sw_if_index_name,
+	      spm->vnet_main, p->sw_if_index, p->pcap_main.file_name,
+	      p->ring_size, p->n_packets_written);
+  if (p->max_file_bytes)
+    s = format (s, " rotate-mb %Lu max-files %u",
+		p->max_file_bytes >> 20, p->max_files);
+  return s;
+}
+
+static u8 *
+format_span_pcap_name (u8 * s, va_list * args)
+{
+  u32 dev_instance = va_arg (*args, u32);
+  return format (s, "span_pcap%d", dev_instance);
+}
+
+/*
+ * Queue a frame of mirrors on the ring of this thread. Never blocks:
+ * mirrors which do not fit are dropped and counted.
+ */
+static uword
+span_pcap_tx (vlib_main_t * vm,
+	      vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+  vnet_interface_output_runtime_t *rd = (void *) node->runtime_data;
+  /* hw interfaces are reused, so their dev_instance may have changed */
+  vnet_hw_interface_t *hi =
+    vnet_get_hw_interface (spm->vnet_main, rd->hw_if_index);
+  u32 *from = vlib_frame_vector_args (frame);
+  u32 n_left = frame->n_vectors;
+  span_pcap_ring_t *r;
+  span_pcap_t *p;
+  u32 mask, head, n_enq, i;
+  f64 now = vlib_time_now (vm);
+
+  /* frames still pending when the destination was deleted */
+  if (PREDICT_FALSE (pool_is_free_index (spm->destinations,
+					 hi->dev_instance)))
+    {
+      vlib_buffer_free (vm, from, n_left);
+      vlib_error_count (vm, node->node_index, SPAN_PCAP_TX_ERROR_DELETED,
+			n_left);
+      return n_left;
+    }
+
+  p = pool_elt_at_index (spm->destinations, hi->dev_instance);
+  r = vec_elt_at_index (p->rings, os_get_cpu_number ());
+  mask = p->ring_size - 1;
+  head = r->head;
+
+  n_enq = clib_min (n_left, p->ring_size - (head - r->tail));
+
+  for (i = 0; i < n_enq; i++)
+    {
+      span_pcap_ring_entry_t *e = r->entries + ((head + i) & mask);
+      e->buffer_index = from[i];
+      e->time = now;
+    }
+
+  /* entries must be visible to the writer before the new head */
+  CLIB_MEMORY_BARRIER ();
+  r->head = head + n_enq;
+
+  if (PREDICT_FALSE (n_enq < n_left))
+    {
+      vlib_buffer_free (vm, from + n_enq, n_left - n_enq);
+      vlib_error_count (vm, node->node_index, SPAN_PCAP_TX_ERROR_RING_FULL,
+			n_left - n_enq);
+    }
+
+  return n_left;
+}
+
+static clib_error_t *
+span_pcap_interface_admin_up_down (vnet_main_t * vnm, u32 hw_if_index,
+				   u32 flags)
+{
+  if (flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)
+    vnet_hw_interface_set_flags (vnm, hw_if_index,
+				 VNET_HW_INTERFACE_FLAG_LINK_UP);
+  else
+    vnet_hw_interface_set_flags (vnm, hw_if_index, 0);
+
+  return /* no error */ 0;
+}
+
+/* *INDENT-OFF* */
+VNET_DEVICE_CLASS (span_pcap_device_class,static) = {
+  .name = "SPAN-pcap",
+  .format_device_name = format_span_pcap_name,
+  .tx_function = span_pcap_tx,
+  .tx_function_n_errors = SPAN_PCAP_TX_N_ERROR,
+  .tx_function_error_strings = span_pcap_tx_error_strings,
+  .admin_up_down_function = span_pcap_interface_admin_up_down,
+};
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+VNET_HW_INTERFACE_CLASS (span_pcap_hw_class) = {
+  .name = "SPAN-pcap",
+};
+/* *INDENT-ON* */
+
+/* Name the current file: <name> first, then <name>.1, <name>.2 ... */
+static void
+span_pcap_set_file_name (span_pcap_t * p)
+{
+  pcap_main_t *pm = &p->pcap_main;
+  u32 i = p->max_files ? p->file_index % p->max_files : p->file_index;
+
+  vec_free (pm->file_name);
+  if (i == 0)
+    pm->file_name = (char *) format (0, "%v%c", p->file_name, 0);
+  else
+    pm->file_name = (char *) format (0, "%v.%d%c", p->file_name, i, 0);
+}
+
+/* Write the buffered packet data out, rotating the file first if full */
+static void
+span_pcap_flush (span_pcap_t * p, f64 now)
+{
+  pcap_main_t *pm = &p->pcap_main;
+  u32 n_bytes = vec_len (pm->pcap_data);
+  clib_error_t *error;
+
+  p->last_flush = now;
+  if (n_bytes == 0)
+    return;
+
+  if (p->max_file_bytes && p->n_file_bytes
+      && p->n_file_bytes + n_bytes > p->max_file_bytes)
+    {
+      if (pm->flags & PCAP_MAIN_INIT_DONE)
+	pcap_close (pm);
+      p->file_index++;
+      p->n_file_bytes = 0;
+      span_pcap_set_file_name (p);
+    }
+
+  error = pcap_write (pm);
+  if (error)
+    {
+      /* drop the data rather than let it grow, reopen next time */
+      clib_error_report (error);
+      vec_reset_length (pm->pcap_data);
+      pm->n_pcap_data_written = 0;
+      pm->flags &= ~PCAP_MAIN_INIT_DONE;
+      return;
+    }
+  p->n_file_bytes += n_bytes;
+}
+
+/*
+ * Copy one mirror to the pcap data. Truncated mirrors are recorded with
+ * the length of the original packet.
+ */
+static void
+span_pcap_add_buffer (vlib_main_t * vm, span_pcap_t * p, u32 bi, f64 time)
+{
+  vlib_buffer_t *b = vlib_get_buffer (vm, bi);
+  u32 n_bytes = vlib_buffer_length_in_chain (vm, b);
+  u32 n_bytes_in_packet = n_bytes;
+  u8 *d;
+
+  if ((b->flags & VLIB_NODE_FLAG_IS_SPAN)
+      && vnet_buffer (b)->span.orig_length > n_bytes)
+    n_bytes_in_packet = vnet_buffer (b)->span.orig_length;
+
+  d = pcap_add_packet (&p->pcap_main, time, n_bytes, n_bytes_in_packet);
+  while (1)
+    {
+      clib_memcpy (d, vlib_buffer_get_current (b), b->current_length);
+      d += b->current_length;
+      if (!(b->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      b = vlib_get_buffer (vm, b->next_buffer);
+    }
+}
+
+/*
+ * Move all queued mirrors of a destination to its pcap data and free
+ * them. time_offset converts vlib time to the unix time of pcap records.
+ */
+static void
+span_pcap_drain (vlib_main_t * vm, span_pcap_t * p, f64 time_offset)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+  span_pcap_ring_t *r;
+  u32 mask = p->ring_size - 1;
+
+  vec_reset_length (spm->to_free);
+
+  vec_foreach (r, p->rings)
+  {
+    u32 head = r->head;
+    u32 tail = r->tail;
+
+    /* entries up to head were written before head was */
+    CLIB_MEMORY_BARRIER ();
+
+    while (tail != head)
+      {
+	span_pcap_ring_entry_t *e = r->entries + (tail & mask);
+	span_pcap_add_buffer (vm, p, e->buffer_index, e->time + time_offset);
+	vec_add1 (spm->to_free, e->buffer_index);
+	tail++;
+      }
+
+    CLIB_MEMORY_BARRIER ();
+    r->tail = tail;
+  }
+
+  if (vec_len (spm->to_free))
+    {
+      vlib_buffer_free (vm, spm->to_free, vec_len (spm->to_free));
+      p->n_packets_written += vec_len (spm->to_free);
+    }
+}
+
+/*
+ * The writer: drains the rings of all destinations every poll interval
+ * and writes the data out once enough of it is buffered, or it is old.
+ * Runs on the main thread, so workers never wait for the disk.
+ */
+static uword
+span_pcap_writer (vlib_main_t * vm,
+		  vlib_node_runtime_t * rt, vlib_frame_t * f)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+  uword *event_data = 0;
+  span_pcap_t *p;
+  f64 now, time_offset;
+
+  while (1)
+    {
+      /* sleep until the first destination is created */
+      if (pool_elts (spm->destinations) == 0)
+	vlib_process_wait_for_event (vm);
+      else
+	vlib_process_wait_for_event_or_clock (vm, SPAN_PCAP_POLL_INTERVAL);
+
+      vlib_process_get_events (vm, &event_data);
+      if (event_data)
+	_vec_len (event_data) = 0;
+
+      now = vlib_time_now (vm);
+      time_offset = unix_time_now () - now;
+
+      /* *INDENT-OFF* */
+      pool_foreach (p, spm->destinations,
+      ({
+	span_pcap_drain (vm, p, time_offset);
+	if (vec_len (p->pcap_main.pcap_data) >= SPAN_PCAP_FLUSH_BYTES
+	    || now - p->last_flush >= SPAN_PCAP_FLUSH_INTERVAL)
+	  span_pcap_flush (p, now);
+      }));
+      /* *INDENT-ON* */
+    }
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (span_pcap_writer_node, static) = {
+  .function = span_pcap_writer,
+  .type = VLIB_NODE_TYPE_PROCESS,
+  .name = "span-pcap-writer",
+};
+/* *INDENT-ON* */
+
+clib_error_t *
+span_pcap_add_del (vlib_main_t * vm, span_pcap_add_del_args_t * a,
+		   u32 * sw_if_indexp)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+  vnet_main_t *vnm = spm->vnet_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vnet_hw_interface_t *hi;
+  span_pcap_ring_t *r;
+  span_pcap_t *p, _p;
+  u32 hw_if_index, sw_if_index;
+
+  if (a->is_add)
+    {
+      if (a->ring_size < 2 || !is_pow2 (a->ring_size))
+	return clib_error_return (0, "ring-size must be a power of 2");
+
+      pool_get_aligned (spm->destinations, p, CLIB_CACHE_LINE_BYTES);
+      memset (p, 0, sizeof (*p));
+
+      p->file_name = vec_dup (a->file_name);
+      p->max_file_bytes = a->max_file_bytes;
+      p->max_files = a->max_files;
+      p->pcap_main.packet_type = PCAP_PACKET_TYPE_ethernet;
+      p->pcap_main.n_packets_to_capture = ~0;
+      p->pcap_main.file_descriptor = -1;
+      span_pcap_set_file_name (p);
+      p->last_flush = vlib_time_now (vm);
+
+      p->ring_size = a->ring_size;
+      vec_validate_aligned (p->rings, tm->n_vlib_mains - 1,
+			    CLIB_CACHE_LINE_BYTES);
+      vec_foreach (r, p->rings)
+	vec_validate_aligned (r->entries, p->ring_size - 1,
+			      CLIB_CACHE_LINE_BYTES);
+
+      if (vec_len (spm->free_hw_if_indices) > 0)
+	{
+	  vnet_interface_main_t *im = &vnm->interface_main;
+	  hw_if_index = vec_pop (spm->free_hw_if_indices);
+
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	  hi->dev_instance = p - spm->destinations;
+	  hi->hw_instance = hi->dev_instance;
+
+	  /* clear old stats of freed destination before reuse */
+	  sw_if_index = hi->sw_if_index;
+	  vnet_interface_counter_lock (im);
+	  vlib_zero_combined_counter
+	    (&im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_TX],
+	     sw_if_index);
+	  vlib_zero_simple_counter
+	    (&im->sw_if_counters[VNET_INTERFACE_COUNTER_DROP], sw_if_index);
+	  vnet_interface_counter_unlock (im);
+	}
+      else
+	{
+	  hw_if_index = vnet_register_interface
+	    (vnm, span_pcap_device_class.index, p - spm->destinations,
+	     span_pcap_hw_class.index, p - spm->destinations);
+	  hi = vnet_get_hw_interface (vnm, hw_if_index);
+	}
+
+      p->hw_if_index = hw_if_index;
+      p->sw_if_index = sw_if_index = hi->sw_if_index;
+
+      vnet_sw_interface_set_flags (vnm, sw_if_index,
+				   VNET_SW_INTERFACE_FLAG_ADMIN_UP);
+
+      /* start polling */
+      vlib_process_signal_event (vm, span_pcap_writer_node.index, 0, 0);
+    }
+  else
+    {
+      hi = vnet_get_sup_hw_interface (vnm, a->sw_if_index);
+      if (hi->dev_class_index != span_pcap_device_class.index)
+	return clib_error_return (0, "%U is not a span pcap destination",
+				  format_vnet_sw_if_index_name, vnm,
+				  a->sw_if_index);
+
+      /* the hw interface is reused by the next destination */
+      if (span_dst_in_use (a->sw_if_index))
+	return clib_error_return (0, "%U is the destination of a SPAN "
+				  "session, disable it first",
+				  format_vnet_sw_if_index_name, vnm,
+				  a->sw_if_index);
+
+      p = pool_elt_at_index (spm->destinations, hi->dev_instance);
+      sw_if_index = p->sw_if_index;
+
+      vnet_sw_interface_set_flags (vnm, sw_if_index, 0 /* down */ );
+
+      /*
+       * Drain and free the destination while workers are stopped. Frames
+       * still pending to the TX node then find it freed and drop their
+       * mirrors. Its file is written out after the barrier, from a copy.
+       */
+      vlib_worker_thread_barrier_sync (vm);
+      span_pcap_drain (vm, p, unix_time_now () - vlib_time_now (vm));
+      _p = *p;
+      pool_put (spm->destinations, p);
+      vlib_worker_thread_barrier_release (vm);
+      p = &_p;
+
+      span_pcap_flush (p, vlib_time_now (vm));
+      if (p->pcap_main.flags & PCAP_MAIN_INIT_DONE)
+	pcap_close (&p->pcap_main);
+
+      vec_add1 (spm->free_hw_if_indices, p->hw_if_index);
+
+      vec_foreach (r, p->rings) vec_free (r->entries);
+      vec_free (p->rings);
+      vec_free (p->pcap_main.pcap_data);
+      vec_free (p->pcap_main.file_name);
+      vec_free (p->file_name);
+    }
+
+  if (sw_if_indexp)
+    *sw_if_indexp = sw_if_index;
+
+  return 0;
+}
+
+static clib_error_t *
+create_span_pcap_command_fn (vlib_main_t * vm,
+			     unformat_input_t * input,
+			     vlib_cli_command_t * cmd)
+{
+  span_pcap_add_del_args_t _a, *a = &_a;
+  u32 rotate_mb = 0;
+  u32 sw_if_index;
+  clib_error_t *error;
+
+  memset (a, 0, sizeof (*a));
+  a->is_add = 1;
+  a->ring_size = SPAN_PCAP_DEFAULT_RING_SIZE;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "file %s", &a->file_name))
+	;
+      else if (unformat (input, "ring-size %u", &a->ring_size))
+	;
+      else if (unformat (input, "rotate-mb %u", &rotate_mb))
+	;
+      else if (unformat (input, "max-files %u", &a->max_files))
+	;
+      else
+	{
+	  error = clib_error_return (0, "parse error: '%U'",
+				     format_unformat_error, input);
+	  goto done;
+	}
+    }
+
+  if (a->file_name == 0)
+    {
+      error = clib_error_return (0, "file name not specified");
+      goto done;
+    }
+  a->max_file_bytes = (u64) rotate_mb << 20;
+
+  error = span_pcap_add_del (vm, a, &sw_if_index);
+  if (!error)
+    vlib_cli_output (vm, "%U\n", format_vnet_sw_if_index_name,
+		     vnet_get_main (), sw_if_index);
+
+done:
+  vec_free (a->file_name);
+  return error;
+}
+
+/*?
+ * Create a pcap file SPAN destination, a span_pcap<n> interface.
+ * Mirrors sent to it are queued on a per-thread ring and written to the
+ * file by the span-pcap-writer process on the main thread; a worker
+ * finding its ring full drops the mirror and counts it. With rotate-mb
+ * the file is rotated to <file>.1, <file>.2 ... once it reaches that
+ * size, max-files then limits the number of files kept.
+ *
+ * @cliexpar
+ * Example of how to capture the traffic of an interface:
+ * @cliexcmd{create span pcap file /tmp/span.pcap rotate-mb 100 max-files 4}
+ * @cliexcmd{set span src GigabitEthernet0/8/0 dst span_pcap0}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (create_span_pcap_command, static) = {
+  .path = "create span pcap",
+  .short_help = "create span pcap file <filename> [ring-size <n>]"
+  " [rotate-mb <n> [max-files <n>]]",
+  .function = create_span_pcap_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+delete_span_pcap_command_fn (vlib_main_t * vm,
+			     unformat_input_t * input,
+			     vlib_cli_command_t * cmd)
+{
+  span_pcap_add_del_args_t _a, *a = &_a;
+  vnet_main_t *vnm = vnet_get_main ();
+
+  memset (a, 0, sizeof (*a));
+
+  if (!unformat (input, "%U", unformat_vnet_sw_interface, vnm,
+		 &a->sw_if_index))
+    return clib_error_return (0, "unknown interface `%U'",
+			      format_unformat_error, input);
+
+  return span_pcap_add_del (vm, a, 0);
+}
+
+/*?
+ * Delete a pcap file SPAN destination. Queued mirrors are written out
+ * and the file is closed.
+ *
+ * @cliexpar
+ * @cliexcmd{delete span pcap span_pcap0}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (delete_span_pcap_command, static) = {
+  .path = "delete span pcap",
+  .short_help = "delete span pcap <interface>",
+  .function = delete_span_pcap_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+show_span_pcap_command_fn (vlib_main_t * vm,
+			   unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+  span_pcap_t *p;
+
+  if (pool_elts (spm->destinations) == 0)
+    vlib_cli_output (vm, "No span pcap destinations configured...");
+
+  /* *INDENT-OFF* */
+  pool_foreach (p, spm->destinations,
+  ({
+    vlib_cli_output (vm, "%U", format_span_pcap, p);
+  }));
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_span_pcap_command, static) = {
+  .path = "show span pcap",
+  .short_help = "show span pcap",
+  .function = show_span_pcap_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+span_pcap_init (vlib_main_t * vm)
+{
+  span_pcap_main_t *spm = &span_pcap_main;
+
+  spm->vlib_main = vm;
+  spm->vnet_main = vnet_get_main ();
+
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (span_pcap_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __span_pcap_h__
+#define __span_pcap_h__
+
+#include <vnet/vnet.h>
+#include <vnet/unix/pcap.h>
+
+/*
+ * pcap file SPAN destinations: span_pcap<n> interfaces. Their TX node
+ * only queues mirror buffers on a per-thread ring; the span-pcap-writer
+ * process, on the main thread, drains the rings into a pcap file.
+ */
+
+/* Default number of ring entries per thread, a power of 2 */
+#define SPAN_PCAP_DEFAULT_RING_SIZE 4096
+
+/* Packet data buffered by the writer before it is written out */
+#define SPAN_PCAP_FLUSH_BYTES (256 << 10)
+
+/* Writer poll interval, and maximum age of buffered packet data */
+#define SPAN_PCAP_POLL_INTERVAL 1e-3
+#define SPAN_PCAP_FLUSH_INTERVAL 1.0
+
+typedef struct
+{
+  u32 buffer_index;
+  f64 time;			/* vlib_time_now () when queued */
+} span_pcap_ring_entry_t;
+
+/*
+ * Single producer, single consumer ring: the thread running the TX node
+ * advances head, the writer process advances tail.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  span_pcap_ring_entry_t *entries;
+  volatile u32 head;
+
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
+  volatile u32 tail;
+} span_pcap_ring_t;
+
+typedef struct
+{
+  /* per-thread rings of queued mirrors */
+  span_pcap_ring_t *rings;
+  u32 ring_size;
+
+  /* file name, and of the rotated files <name>.1, <name>.2 ... */
+  u8 *file_name;
+  pcap_main_t pcap_main;
+
+  /* rotation once a file reaches max_file_bytes, 0 = never */
+  u64 max_file_bytes;
+  u32 max_files;
+  u32 file_index;
+  u64 n_file_bytes;
+
+  f64 last_flush;
+  u64 n_packets_written;
+
+  /* vnet intfc hw/sw_if_index */
+  u32 hw_if_index;
+  u32 sw_if_index;
+} span_pcap_t;
+
+typedef struct
+{
+  /* pool of pcap file destinations */
+  span_pcap_t *destinations;
+
+  /* free hw_if_indices of deleted destinations */
+  u32 *free_hw_if_indices;
+
+  /* buffers written out by the writer, to be freed */
+  u32 *to_free;
+
+  /* convenience */
+  vlib_main_t *vlib_main;
+  vnet_main_t *vnet_main;
+} span_pcap_main_t;
+
+span_pcap_main_t span_pcap_main;
+
+typedef struct
+{
+  u8 is_add;
+  u8 *file_name;
+  u32 ring_size;
+  u64 max_file_bytes;
+  u32 max_files;
+  u32 sw_if_index;		/* destination to delete */
+} span_pcap_add_del_args_t;
+
+clib_error_t *span_pcap_add_del (vlib_main_t * vm,
+				 span_pcap_add_del_args_t * a,
+				 u32 * sw_if_indexp);
+
+format_function_t format_span_pcap;
+
+#endif /* __span_pcap_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
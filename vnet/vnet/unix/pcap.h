@@ -155,6 +155,9 @@ typedef struct {
 /** Write out data to output file. */
 clib_error_t * pcap_write (pcap_main_t * pm);
 
+/** Close output file. */
+clib_error_t * pcap_close (pcap_main_t * pm);
+
 /** Read data from file. */
 clib_error_t * pcap_read (pcap_main_t * pm);
 
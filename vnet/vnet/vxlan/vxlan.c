@@ -76,11 +76,23 @@ static u8 * format_vxlan_name (u8 * s, va_list * args)
   return format (s, "vxlan_tunnel%d", dev_instance);
 }
 
-static uword dummy_interface_tx (vlib_main_t * vm,
+/*
+ * Packets switched in L2 reach vxlan-encap directly. The ones sent
+ * through interface-output, e.g. SPAN mirrors, come here and are
+ * handed over to vxlan-encap as well.
+ */
+static uword vxlan_interface_tx (vlib_main_t * vm,
                                  vlib_node_runtime_t * node,
                                  vlib_frame_t * frame)
 {
-  clib_warning ("you shouldn't be here, leaking buffers...");
+  vlib_frame_t * f;
+
+  f = vlib_get_frame_to_node (vm, vxlan_encap_node.index);
+  clib_memcpy (vlib_frame_vector_args (f), vlib_frame_vector_args (frame),
+               frame->n_vectors * sizeof (u32));
+  f->n_vectors = frame->n_vectors;
+  vlib_put_frame_to_node (vm, vxlan_encap_node.index, f);
+
   return frame->n_vectors;
 }
 
@@ -99,7 +111,7 @@ VNET_DEVICE_CLASS (vxlan_device_class,static) = {
   .name = "VXLAN",
   .format_device_name = format_vxlan_name,
   .format_tx_trace = format_vxlan_encap_trace,
-  .tx_function = dummy_interface_tx,
+  .tx_function = vxlan_interface_tx,
   .admin_up_down_function = vxlan_interface_admin_up_down,
 };
 
@@ -1640,6 +1640,40 @@ static void vl_api_vxlan_add_del_tunnel_reply_t_handler_json
   vam->result_ready = 1;
 }
 
+static void vl_api_erspan_add_del_tunnel_reply_t_handler
+  (vl_api_erspan_add_del_tunnel_reply_t * mp)
+{
+  vat_main_t *vam = &vat_main;
+  i32 retval = ntohl (mp->retval);
+  if (vam->async_mode)
+    {
+      vam->async_errors += (retval < 0);
+    }
+  else
+    {
+      vam->retval = retval;
+      vam->sw_if_index = ntohl (mp->sw_if_index);
+      vam->result_ready = 1;
+    }
+}
+
+static void vl_api_erspan_add_del_tunnel_reply_t_handler_json
+  (vl_api_erspan_add_del_tunnel_reply_t * mp)
+{
+  vat_main_t *vam = &vat_main;
+  vat_json_node_t node;
+
+  vat_json_init_object (&node);
+  vat_json_object_add_int (&node, "retval", ntohl (mp->retval));
+  vat_json_object_add_uint (&node, "sw_if_index", ntohl (mp->sw_if_index));
+
+  vat_json_print (vam->ofp, &node);
+  vat_json_free (&node);
+
+  vam->retval = ntohl (mp->retval);
+  vam->result_ready = 1;
+}
+
 static void vl_api_gre_add_del_tunnel_reply_t_handler
   (vl_api_gre_add_del_tunnel_reply_t * mp)
 {
@@ -1948,6 +1982,18 @@ static void vl_api_vnet_interface_counters_t_handler
   /* not supported */
 }
 
+static void vl_api_vnet_span_counters_t_handler
+  (vl_api_vnet_span_counters_t * mp)
+{
+  /* not supported */
+}
+
+static void vl_api_vnet_span_counters_t_handler_json
+  (vl_api_vnet_span_counters_t * mp)
+{
+  /* not supported */
+}
+
 static void vl_api_vnet_interface_counters_t_handler_json
   (vl_api_vnet_interface_counters_t * mp)
 {
@@ -3528,6 +3574,10 @@ _(ipfix_classify_table_add_del_reply)                   \
 _(flow_classify_set_interface_reply)                    \
 _(span_create_reply)                                    \
 _(span_delete_reply)                                    \
+_(span_rate_limit_reply)                                \
+_(span_classify_reply)                                  \
+_(span_sample_reply)                                    \
+_(span_metadata_reply)                                  \
 _(pg_capture_reply)                                     \
 _(pg_enable_disable_reply)                              \
 _(ip_source_and_port_range_check_add_del_reply)         \
@@ -3692,6 +3742,7 @@ _(DELETE_LOOPBACK_REPLY, delete_loopback_reply)                         \
 _(BD_IP_MAC_ADD_DEL_REPLY, bd_ip_mac_add_del_reply)                     \
 _(DHCP_COMPL_EVENT, dhcp_compl_event)                                   \
 _(VNET_INTERFACE_COUNTERS, vnet_interface_counters)                     \
+_(VNET_SPAN_COUNTERS, vnet_span_counters)                               \
 _(VNET_IP4_FIB_COUNTERS, vnet_ip4_fib_counters)                         \
 _(VNET_IP6_FIB_COUNTERS, vnet_ip6_fib_counters)                         \
 _(MAP_ADD_DOMAIN_REPLY, map_add_domain_reply)                           \
@@ -3761,6 +3812,11 @@ _(FLOW_CLASSIFY_SET_INTERFACE_REPLY, flow_classify_set_interface_reply) \
 _(FLOW_CLASSIFY_DETAILS, flow_classify_details)                         \
 _(SPAN_CREATE_REPLY, span_create_reply)                                 \
 _(SPAN_DELETE_REPLY, span_delete_reply)                                 \
+_(SPAN_RATE_LIMIT_REPLY, span_rate_limit_reply)                         \
+_(SPAN_CLASSIFY_REPLY, span_classify_reply)                             \
+_(SPAN_SAMPLE_REPLY, span_sample_reply)                                 \
+_(SPAN_METADATA_REPLY, span_metadata_reply)                             \
+_(ERSPAN_ADD_DEL_TUNNEL_REPLY, erspan_add_del_tunnel_reply)             \
 _(SPAN_DETAILS, span_details)                                           \
 _(GET_NEXT_INDEX_REPLY, get_next_index_reply)                           \
 _(PG_CREATE_INTERFACE_REPLY, pg_create_interface_reply)                 \
@@ -14990,21 +15046,51 @@ api_span_create (vat_main_t * vam)
   f64 timeout;
   u32 src_sw_if_index;
   u32 dst_sw_if_index;
+  u8 mode = SPAN_MIRROR_MODE_COPY;
+  u32 snaplen = 0;
+  u8 direction = 0;
+  u8 is_l2 = 0;
 
   while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
     {
       if (unformat (i, "src %u", &src_sw_if_index))
 	;
+      else if (unformat (i, "src drop"))
+	src_sw_if_index = SPAN_SRC_DROP;
       else if (unformat (i, "dst %u", &dst_sw_if_index))
 	;
+      else if (unformat (i, "mode copy"))
+	mode = SPAN_MIRROR_MODE_COPY;
+      else if (unformat (i, "mode clone"))
+	mode = SPAN_MIRROR_MODE_CLONE;
+      else if (unformat (i, "snaplen %u", &snaplen))
+	;
+      else if (unformat (i, "rx"))
+	direction = SPAN_DIRECTION_RX;
+      else if (unformat (i, "tx"))
+	direction = SPAN_DIRECTION_TX;
+      else if (unformat (i, "both"))
+	direction = SPAN_DIRECTION_BOTH;
+      else if (unformat (i, "l2"))
+	is_l2 = 1;
       else
 	break;
     }
 
+  if (snaplen > 0xffff)
+    {
+      errmsg ("snaplen %u is out of range\n", snaplen);
+      return -99;
+    }
+
   M (SPAN_CREATE, span_create);
 
   mp->sw_if_index_from = htonl (src_sw_if_index);
   mp->sw_if_index_to = htonl (dst_sw_if_index);
+  mp->mode = mode;
+  mp->snaplen = htons (snaplen);
+  mp->direction = direction;
+  mp->is_l2 = is_l2;
 
   S;
   W;
@@ -15019,11 +15105,16 @@ api_span_delete (vat_main_t * vam)
   vl_api_span_delete_t *mp;
   f64 timeout;
   u32 src_sw_if_index;
+  u32 dst_sw_if_index = ~0;
 
   while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
     {
       if (unformat (i, "src %u", &src_sw_if_index))
 	;
+      else if (unformat (i, "src drop"))
+	src_sw_if_index = SPAN_SRC_DROP;
+      else if (unformat (i, "dst %u", &dst_sw_if_index))
+	;
       else
 	break;
     }
@@ -15031,6 +15122,159 @@ api_span_delete (vat_main_t * vam)
   M (SPAN_DELETE, span_delete);
 
   mp->sw_if_index_from = htonl (src_sw_if_index);
+  mp->sw_if_index_to = htonl (dst_sw_if_index);
+
+  S;
+  W;
+  /* NOTREACHED */
+  return 0;
+}
+
+static int
+api_span_rate_limit (vat_main_t * vam)
+{
+  unformat_input_t *i = vam->input;
+  vl_api_span_rate_limit_t *mp;
+  f64 timeout;
+  u32 dst_sw_if_index = ~0;
+  u32 max_pps = 0;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "dst %u", &dst_sw_if_index))
+	;
+      else if (unformat (i, "max-pps %u", &max_pps))
+	;
+      else
+	break;
+    }
+
+  M (SPAN_RATE_LIMIT, span_rate_limit);
+
+  mp->sw_if_index_to = htonl (dst_sw_if_index);
+  mp->max_pps = htonl (max_pps);
+
+  S;
+  W;
+  /* NOTREACHED */
+  return 0;
+}
+
+static int
+api_span_classify (vat_main_t * vam)
+{
+  unformat_input_t *i = vam->input;
+  vl_api_span_classify_t *mp;
+  f64 timeout;
+  u32 src_sw_if_index = ~0;
+  u32 table_index = ~0;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "src %u", &src_sw_if_index))
+	;
+      else if (unformat (i, "src drop"))
+	src_sw_if_index = SPAN_SRC_DROP;
+      else if (unformat (i, "table %u", &table_index))
+	;
+      else if (unformat (i, "disable"))
+	table_index = ~0;
+      else
+	break;
+    }
+
+  M (SPAN_CLASSIFY, span_classify);
+
+  mp->sw_if_index_from = htonl (src_sw_if_index);
+  mp->table_index = htonl (table_index);
+
+  S;
+  W;
+  /* NOTREACHED */
+  return 0;
+}
+
+static int
+api_span_sample (vat_main_t * vam)
+{
+  unformat_input_t *i = vam->input;
+  vl_api_span_sample_t *mp;
+  f64 timeout;
+  u32 src_sw_if_index = ~0;
+  u8 mode = ~0;
+  u32 rate = 0;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "src %u", &src_sw_if_index))
+	;
+      else if (unformat (i, "src drop"))
+	src_sw_if_index = SPAN_SRC_DROP;
+      else if (unformat (i, "every %u", &rate))
+	mode = SPAN_SAMPLE_EVERY;
+      else if (unformat (i, "random %u", &rate))
+	mode = SPAN_SAMPLE_RANDOM;
+      else if (unformat (i, "flow %u", &rate))
+	mode = SPAN_SAMPLE_FLOW;
+      else if (unformat (i, "disable"))
+	mode = SPAN_SAMPLE_NONE;
+      else
+	break;
+    }
+
+  if (mode == (u8) ~ 0)
+    {
+      errmsg ("sampling mode not specified\n");
+      return -99;
+    }
+
+  M (SPAN_SAMPLE, span_sample);
+
+  mp->sw_if_index_from = htonl (src_sw_if_index);
+  mp->mode = mode;
+  mp->rate = htonl (rate);
+
+  S;
+  W;
+  /* NOTREACHED */
+  return 0;
+}
+
+static int
+api_span_metadata (vat_main_t * vam)
+{
+  unformat_input_t *i = vam->input;
+  vl_api_span_metadata_t *mp;
+  f64 timeout;
+  u32 src_sw_if_index = ~0;
+  u8 mode = ~0;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "src %u", &src_sw_if_index))
+	;
+      else if (unformat (i, "src drop"))
+	src_sw_if_index = SPAN_SRC_DROP;
+      else if (unformat (i, "header"))
+	mode = SPAN_METADATA_HEADER;
+      else if (unformat (i, "trailer"))
+	mode = SPAN_METADATA_TRAILER;
+      else if (unformat (i, "disable"))
+	mode = SPAN_METADATA_NONE;
+      else
+	break;
+    }
+
+  if (mode == (u8) ~ 0)
+    {
+      errmsg ("metadata mode not specified\n");
+      return -99;
+    }
+
+  M (SPAN_METADATA, span_metadata);
+
+  mp->sw_if_index_from = htonl (src_sw_if_index);
+  mp->mode = mode;
 
   S;
   W;
@@ -15043,8 +15287,19 @@ vl_api_span_details_t_handler (vl_api_span_details_t * mp)
 {
   vat_main_t *vam = &vat_main;
 
-  fformat (vam->ofp, "%u => %u\n",
-	   ntohl (mp->sw_if_index_from), ntohl (mp->sw_if_index_to));
+  fformat (vam->ofp, "%u => %u (%s, %s%s, snaplen %u, table %d, "
+	   "sample %u/%u, metadata %u) %lld packets %lld bytes "
+	   "%lld rate limited (max-pps %u)\n",
+	   ntohl (mp->sw_if_index_from), ntohl (mp->sw_if_index_to),
+	   mp->mode == SPAN_MIRROR_MODE_CLONE ? "clone" : "copy",
+	   mp->direction == SPAN_DIRECTION_RX ? "rx" :
+	   mp->direction == SPAN_DIRECTION_TX ? "tx" : "both",
+	   mp->is_l2 ? " l2" : "",
+	   ntohs (mp->snaplen), ntohl (mp->table_index), mp->sample_mode,
+	   ntohl (mp->sample_rate), mp->metadata,
+	   clib_net_to_host_u64 (mp->packets),
+	   clib_net_to_host_u64 (mp->bytes),
+	   clib_net_to_host_u64 (mp->rate_limit_drops), ntohl (mp->max_pps));
 }
 
 static void
@@ -15064,6 +15319,91 @@ vl_api_span_details_t_handler_json (vl_api_span_details_t * mp)
   vat_json_object_add_uint (node, "src-if-index",
 			    ntohl (mp->sw_if_index_from));
   vat_json_object_add_uint (node, "dst-if-index", ntohl (mp->sw_if_index_to));
+  vat_json_object_add_uint (node, "mode", mp->mode);
+  vat_json_object_add_uint (node, "snaplen", ntohs (mp->snaplen));
+  vat_json_object_add_uint (node, "direction", mp->direction);
+  vat_json_object_add_uint (node, "is-l2", mp->is_l2);
+  vat_json_object_add_uint (node, "table-index", ntohl (mp->table_index));
+  vat_json_object_add_uint (node, "sample-mode", mp->sample_mode);
+  vat_json_object_add_uint (node, "sample-rate", ntohl (mp->sample_rate));
+  vat_json_object_add_uint (node, "metadata", mp->metadata);
+  vat_json_object_add_uint (node, "packets",
+			    clib_net_to_host_u64 (mp->packets));
+  vat_json_object_add_uint (node, "bytes", clib_net_to_host_u64 (mp->bytes));
+  vat_json_object_add_uint (node, "rate-limit-drops",
+			    clib_net_to_host_u64 (mp->rate_limit_drops));
+  vat_json_object_add_uint (node, "max-pps", ntohl (mp->max_pps));
+}
+
+static int
+api_erspan_add_del_tunnel (vat_main_t * vam)
+{
+  unformat_input_t *line_input = vam->input;
+  vl_api_erspan_add_del_tunnel_t *mp;
+  f64 timeout;
+  ip4_address_t src4, dst4;
+  u8 is_add = 1;
+  u8 src_set = 0;
+  u8 dst_set = 0;
+  u32 encap_vrf_id = 0;
+  u32 session_id = ~0;
+  u32 type = 2;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "del"))
+	is_add = 0;
+      else if (unformat (line_input, "src %U", unformat_ip4_address, &src4))
+	src_set = 1;
+      else if (unformat (line_input, "dst %U", unformat_ip4_address, &dst4))
+	dst_set = 1;
+      else if (unformat (line_input, "encap-vrf-id %d", &encap_vrf_id))
+	;
+      else if (unformat (line_input, "session-id %d", &session_id))
+	;
+      else if (unformat (line_input, "type %d", &type))
+	;
+      else
+	{
+	  errmsg ("parse error '%U'\n", format_unformat_error, line_input);
+	  return -99;
+	}
+    }
+
+  if (src_set == 0)
+    {
+      errmsg ("tunnel src address not specified\n");
+      return -99;
+    }
+  if (dst_set == 0)
+    {
+      errmsg ("tunnel dst address not specified\n");
+      return -99;
+    }
+  if (session_id > 1023)
+    {
+      errmsg ("session-id not specified or out of range\n");
+      return -99;
+    }
+  if (type != 2 && type != 3)
+    {
+      errmsg ("type must be 2 or 3\n");
+      return -99;
+    }
+
+  M (ERSPAN_ADD_DEL_TUNNEL, erspan_add_del_tunnel);
+
+  clib_memcpy (&mp->src_address, &src4, sizeof (src4));
+  clib_memcpy (&mp->dst_address, &dst4, sizeof (dst4));
+  mp->encap_vrf_id = ntohl (encap_vrf_id);
+  mp->session_id = ntohs (session_id);
+  mp->type = type;
+  mp->is_add = is_add;
+
+  S;
+  W;
+  /* NOTREACHED */
+  return 0;
 }
 
 static int
@@ -16378,8 +16718,16 @@ _(set_ipfix_classify_stream, "[domain <domain-id>] [src_port <src-port>]") \
 _(ipfix_classify_stream_dump, "")                                       \
 _(ipfix_classify_table_add_del, "table <table-index> ip4|ip6 [tcp|udp]")\
 _(ipfix_classify_table_dump, "")                                        \
-_(span_create, "src <src interface name> dst <dst interface name>")     \
-_(span_delete, "src <src interface name>")                              \
+_(span_create, "src <src interface name>|drop dst <dst interface name> " \
+  "[rx|tx|both] [l2] [mode copy|clone] [snaplen <n>]")                  \
+_(span_delete, "src <src interface name>|drop [dst <dst interface name>]")   \
+_(span_rate_limit, "dst <dst interface name> max-pps <n>")               \
+_(span_classify, "src <src interface name>|drop [table <n>|disable]")   \
+_(span_sample, "src <src interface name>|drop "                         \
+  "[every <n>|random <n>|flow <n>|disable]")                            \
+_(span_metadata, "src <src interface name>|drop [header|trailer|disable]")  \
+_(erspan_add_del_tunnel, "src <ip4-addr> dst <ip4-addr> "              \
+  "session-id <nn> [type 2|3] [encap-vrf-id <nn>] [del]")               \
 _(span_dump, "")                                                        \
 _(get_next_index, "node-name <node-name> next-node-name <node-name>")   \
 _(pg_create_interface, "if_id <nn>")                                    \
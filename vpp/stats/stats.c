@@ -18,6 +18,7 @@
 #include <vnet/fib/fib_entry.h>
 #include <vnet/fib/fib_table.h>
 #include <vnet/dpo/load_balance.h>
+#include <vnet/span/span.h>
 
 #define STATS_DEBUG 0
 
@@ -48,6 +49,7 @@ stats_main_t stats_main;
 _(WANT_STATS, want_stats)                               \
 _(WANT_STATS_REPLY, want_stats_reply)                   \
 _(VNET_INTERFACE_COUNTERS, vnet_interface_counters)     \
+_(VNET_SPAN_COUNTERS, vnet_span_counters)               \
 _(VNET_IP4_FIB_COUNTERS, vnet_ip4_fib_counters)         \
 _(VNET_IP6_FIB_COUNTERS, vnet_ip6_fib_counters)
 
@@ -216,6 +218,76 @@ do_combined_interface_counters (stats_main_t * sm)
   vnet_interface_counter_unlock (im);
 }
 
+static void
+do_span_counters (stats_main_t * sm)
+{
+  vl_api_vnet_span_counters_t *mp = 0;
+  vnet_interface_main_t *im = sm->interface_main;
+  span_main_t *spm = &span_main;
+  api_main_t *am = sm->api_main;
+  vl_shmem_hdr_t *shmem_hdr = am->shmem_hdr;
+  unix_shared_memory_queue_t *q = shmem_hdr->vl_input_queue;
+  vlib_simple_counter_main_t *cm;
+  u32 items_this_message = 0;
+  u64 v, *vp = 0;
+  int i, t;
+
+  /*
+   * SPAN validates its counters under this lock. Index 0 holds the drop
+   * session, source sw_if_index n is at n + 1.
+   */
+  vnet_interface_counter_lock (im);
+
+  for (t = 0; t < SPAN_N_COUNTER; t++)
+    {
+      cm = &spm->counters[t];
+
+      /* the drop session, in a block of its own under SPAN_SRC_DROP */
+      if (vec_len (cm->maxi) > 0)
+	{
+	  mp = vl_msg_api_alloc_as_if_client (sizeof (*mp) + sizeof (v));
+	  mp->_vl_msg_id = ntohs (VL_API_VNET_SPAN_COUNTERS);
+	  mp->span_counter_type = t;
+	  mp->first_sw_if_index = htonl (SPAN_SRC_DROP);
+	  mp->count = htonl (1);
+	  v = vlib_get_simple_counter (cm, 0);
+	  clib_mem_unaligned (mp->data, u64) = clib_host_to_net_u64 (v);
+	  vl_msg_api_send_shmem (q, (u8 *) & mp);
+	  mp = 0;
+	}
+
+      for (i = 1; i < vec_len (cm->maxi); i++)
+	{
+	  if (mp == 0)
+	    {
+	      items_this_message = clib_min (SIMPLE_COUNTER_BATCH_SIZE,
+					     vec_len (cm->maxi) - i);
+
+	      mp = vl_msg_api_alloc_as_if_client
+		(sizeof (*mp) + items_this_message * sizeof (v));
+	      mp->_vl_msg_id = ntohs (VL_API_VNET_SPAN_COUNTERS);
+	      mp->span_counter_type = t;
+	      mp->first_sw_if_index = htonl (i - 1);
+	      mp->count = 0;
+	      vp = (u64 *) mp->data;
+	    }
+	  v = vlib_get_simple_counter (cm, i);
+	  clib_mem_unaligned (vp, u64) = clib_host_to_net_u64 (v);
+	  vp++;
+	  mp->count++;
+	  if (mp->count == items_this_message)
+	    {
+	      mp->count = htonl (items_this_message);
+	      /* Send to the main thread... */
+	      vl_msg_api_send_shmem (q, (u8 *) & mp);
+	      mp = 0;
+	    }
+	}
+      ASSERT (mp == 0);
+    }
+  vnet_interface_counter_unlock (im);
+}
+
 /* from .../vnet/vnet/ip/lookup.c. Yuck */
 typedef CLIB_PACKED (struct
 		     {
@@ -615,6 +687,7 @@ stats_thread_fn (void *arg)
 	continue;
       do_simple_interface_counters (sm);
       do_combined_interface_counters (sm);
+      do_span_counters (sm);
       do_ip4_fibs (sm);
       do_ip6_fibs (sm);
     }
@@ -754,6 +827,44 @@ vl_api_vnet_interface_counters_t_handler (vl_api_vnet_interface_counters_t *
     }
 }
 
+static void
+vl_api_vnet_span_counters_t_handler (vl_api_vnet_span_counters_t * mp)
+{
+  vpe_client_registration_t *reg;
+  stats_main_t *sm = &stats_main;
+  unix_shared_memory_queue_t *q, *q_prev = NULL;
+  vl_api_vnet_span_counters_t *mp_copy = NULL;
+  u32 mp_size;
+
+  mp_size = sizeof (*mp) + ntohl (mp->count) * sizeof (u64);
+
+  /* *INDENT-OFF* */
+  pool_foreach(reg, sm->stats_registrations,
+  ({
+    q = vl_api_client_index_to_input_queue (reg->client_index);
+    if (q)
+      {
+        if (q_prev && (q_prev->cursize < q_prev->maxsize))
+          {
+            mp_copy = vl_msg_api_alloc_as_if_client(mp_size);
+            clib_memcpy(mp_copy, mp, mp_size);
+            vl_msg_api_send_shmem (q_prev, (u8 *)&mp);
+            mp = mp_copy;
+          }
+        q_prev = q;
+      }
+  }));
+  /* *INDENT-ON* */
+  if (q_prev && (q_prev->cursize < q_prev->maxsize))
+    {
+      vl_msg_api_send_shmem (q_prev, (u8 *) & mp);
+    }
+  else
+    {
+      vl_msg_api_free (mp);
+    }
+}
+
 static void
 vl_api_vnet_ip4_fib_counters_t_handler (vl_api_vnet_ip4_fib_counters_t * mp)
 {
@@ -948,6 +1059,7 @@ stats_init (vlib_main_t * vm)
 
   /* tell the msg infra not to free these messages... */
   am->message_bounce[VL_API_VNET_INTERFACE_COUNTERS] = 1;
+  am->message_bounce[VL_API_VNET_SPAN_COUNTERS] = 1;
   am->message_bounce[VL_API_VNET_IP4_FIB_COUNTERS] = 1;
   am->message_bounce[VL_API_VNET_IP6_FIB_COUNTERS] = 1;
 
@@ -111,6 +111,7 @@
 #include <vnet/l2/l2_bd.h>
 #include <vpp-api/vpe_msg_enum.h>
 #include <vnet/span/span.h>
+#include <vnet/span/erspan.h>
 
 #include <vnet/fib/ip6_fib.h>
 #include <vnet/fib/ip4_fib.h>
@@ -417,6 +418,11 @@ _(IPFIX_CLASSIFY_TABLE_ADD_DEL, ipfix_classify_table_add_del)           \
 _(IPFIX_CLASSIFY_TABLE_DUMP, ipfix_classify_table_dump)                 \
 _(SPAN_CREATE, span_create)                                             \
 _(SPAN_DELETE, span_delete)                                             \
+_(SPAN_RATE_LIMIT, span_rate_limit)                                     \
+_(SPAN_CLASSIFY, span_classify)                                         \
+_(SPAN_SAMPLE, span_sample)                                             \
+_(SPAN_METADATA, span_metadata)                                         \
+_(ERSPAN_ADD_DEL_TUNNEL, erspan_add_del_tunnel)                         \
 _(SPAN_DUMP, span_dump)                                                 \
 _(GET_NEXT_INDEX, get_next_index)                                       \
 _(PG_CREATE_INTERFACE, pg_create_interface)                             \
@@ -8150,12 +8156,21 @@ static void
 vl_api_span_create_t_handler (vl_api_span_create_t * mp)
 {
   vl_api_span_create_reply_t *rmp;
-  int rv;
+  clib_error_t *error;
+  int rv = 0;
 
   vlib_main_t *vm = vlib_get_main ();
 
-  rv = (0 == set_span_add_delete_entry (vm, ntohl (mp->sw_if_index_from),
-					ntohl (mp->sw_if_index_to), 0));
+  error = set_span_add_delete_entry (vm, ntohl (mp->sw_if_index_from),
+				     ntohl (mp->sw_if_index_to), mp->mode,
+				     ntohs (mp->snaplen),
+				     mp->direction ? mp->direction : ~0,
+				     mp->is_l2 != 0, 0);
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
 
   REPLY_MACRO (VL_API_SPAN_CREATE_REPLY);
 }
@@ -8164,40 +8179,188 @@ static void
 vl_api_span_delete_t_handler (vl_api_span_delete_t * mp)
 {
   vl_api_span_delete_reply_t *rmp;
-  int rv;
+  clib_error_t *error;
+  int rv = 0;
 
   vlib_main_t *vm = vlib_get_main ();
 
-  rv =
-    (0 ==
-     set_span_add_delete_entry (vm, ntohl (mp->sw_if_index_from), ~0, 1));
+  error = set_span_add_delete_entry (vm, ntohl (mp->sw_if_index_from),
+				     ntohl (mp->sw_if_index_to), ~0, ~0, ~0,
+				     ~0, 1);
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
 
   REPLY_MACRO (VL_API_SPAN_DELETE_REPLY);
 }
 
+static void
+vl_api_span_rate_limit_t_handler (vl_api_span_rate_limit_t * mp)
+{
+  vl_api_span_rate_limit_reply_t *rmp;
+  clib_error_t *error;
+  int rv = 0;
+
+  vlib_main_t *vm = vlib_get_main ();
+
+  error = span_set_dst_max_pps (vm, ntohl (mp->sw_if_index_to),
+				ntohl (mp->max_pps));
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
+
+  REPLY_MACRO (VL_API_SPAN_RATE_LIMIT_REPLY);
+}
+
+static void
+vl_api_span_classify_t_handler (vl_api_span_classify_t * mp)
+{
+  vl_api_span_classify_reply_t *rmp;
+  clib_error_t *error;
+  int rv = 0;
+
+  vlib_main_t *vm = vlib_get_main ();
+
+  error = span_set_classify_table (vm, ntohl (mp->sw_if_index_from),
+				   ntohl (mp->table_index));
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
+
+  REPLY_MACRO (VL_API_SPAN_CLASSIFY_REPLY);
+}
+
+static void
+vl_api_span_sample_t_handler (vl_api_span_sample_t * mp)
+{
+  vl_api_span_sample_reply_t *rmp;
+  clib_error_t *error;
+  int rv = 0;
+
+  vlib_main_t *vm = vlib_get_main ();
+
+  error = span_set_sample (vm, ntohl (mp->sw_if_index_from), mp->mode,
+			   ntohl (mp->rate));
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
+
+  REPLY_MACRO (VL_API_SPAN_SAMPLE_REPLY);
+}
+
+static void
+vl_api_span_metadata_t_handler (vl_api_span_metadata_t * mp)
+{
+  vl_api_span_metadata_reply_t *rmp;
+  clib_error_t *error;
+  int rv = 0;
+
+  vlib_main_t *vm = vlib_get_main ();
+
+  error = span_set_metadata (vm, ntohl (mp->sw_if_index_from), mp->mode);
+  if (error)
+    {
+      clib_error_report (error);
+      rv = VNET_API_ERROR_UNSPECIFIED;
+    }
+
+  REPLY_MACRO (VL_API_SPAN_METADATA_REPLY);
+}
+
+static void
+vl_api_erspan_add_del_tunnel_t_handler (vl_api_erspan_add_del_tunnel_t * mp)
+{
+  vl_api_erspan_add_del_tunnel_reply_t *rmp;
+  vnet_erspan_add_del_tunnel_args_t _a, *a = &_a;
+  u32 sw_if_index = ~0;
+  int rv = 0;
+
+  memset (a, 0, sizeof (*a));
+
+  a->encap_fib_index = ip4_fib_index_from_table_id (ntohl (mp->encap_vrf_id));
+  if (a->encap_fib_index == ~0)
+    {
+      rv = VNET_API_ERROR_NO_SUCH_FIB;
+      goto out;
+    }
+
+  /* Check src & dst are different */
+  if (memcmp (mp->src_address, mp->dst_address, 4) == 0)
+    {
+      rv = VNET_API_ERROR_SAME_SRC_DST;
+      goto out;
+    }
+
+  a->is_add = mp->is_add;
+  a->type = mp->type;
+  a->session_id = ntohs (mp->session_id);
+  /* ip addresses sent in network byte order */
+  clib_memcpy (&a->src, mp->src_address, 4);
+  clib_memcpy (&a->dst, mp->dst_address, 4);
+
+  rv = vnet_erspan_add_del_tunnel (a, &sw_if_index);
+
+out:
+  /* *INDENT-OFF* */
+  REPLY_MACRO2(VL_API_ERSPAN_ADD_DEL_TUNNEL_REPLY,
+  ({
+    rmp->sw_if_index = ntohl (sw_if_index);
+  }));
+  /* *INDENT-ON* */
+}
+
 static void
 vl_api_span_dump_t_handler (vl_api_span_dump_t * mp)
 {
   unix_shared_memory_queue_t *q;
   vl_api_span_details_t *rmp;
   span_main_t *sm = &span_main;
-  u32 sw_if_index_from;
-  u32 sw_if_index_to;
+  span_session_t *session;
+  span_dst_t *d;
+  vlib_counter_t v, dv;
 
   q = vl_api_client_index_to_input_queue (mp->client_index);
+  if (!q)
+    return;
 
   /* *INDENT-OFF* */
-  hash_foreach (sw_if_index_from, sw_if_index_to, sm->dst_sw_if_index_by_src,
+  pool_foreach (session, sm->sessions,
   ({
-    rmp = vl_msg_api_alloc (sizeof (*rmp));
-    memset (rmp, 0, sizeof (*rmp));
-    rmp->_vl_msg_id       = ntohs(VL_API_SPAN_DETAILS);
-    rmp->context          = mp->context;
-
-	rmp->sw_if_index_from = htonl(sw_if_index_from);
-    rmp->sw_if_index_to   = htonl(sw_if_index_to);
-
-    vl_msg_api_send_shmem (q, (u8 *)&rmp);
+    vec_foreach (d, session->dsts)
+      {
+        span_get_dst_counter (d, &v);
+        span_get_dst_drop_counter (d, &dv);
+
+        rmp = vl_msg_api_alloc (sizeof (*rmp));
+        memset (rmp, 0, sizeof (*rmp));
+        rmp->_vl_msg_id       = ntohs(VL_API_SPAN_DETAILS);
+        rmp->context          = mp->context;
+
+        rmp->sw_if_index_from = htonl(session->src_sw_if_index);
+        rmp->sw_if_index_to   = htonl(d->sw_if_index);
+        rmp->mode             = session->mode;
+        rmp->snaplen          = htons(session->snaplen);
+        rmp->direction        = session->direction;
+        rmp->is_l2            = session->is_l2;
+        rmp->table_index      = htonl(session->table_index);
+        rmp->sample_mode      = session->sample_mode;
+        rmp->sample_rate      = htonl(session->sample_rate);
+        rmp->metadata         = session->metadata_mode;
+        rmp->packets          = clib_host_to_net_u64 (v.packets);
+        rmp->bytes            = clib_host_to_net_u64 (v.bytes);
+        rmp->rate_limit_drops = clib_host_to_net_u64 (dv.packets);
+        rmp->max_pps          = htonl(span_get_dst_max_pps (d->sw_if_index));
+
+        vl_msg_api_send_shmem (q, (u8 *)&rmp);
+      }
   }));
   /* *INDENT-ON* */
 }
@@ -31,6 +31,7 @@
 #include <vnet/policer/xlate.h>
 #include <vnet/policer/policer.h>
 #include <vnet/classify/flow_classify.h>
+#include <vnet/span/span.h>
 #include <vlib/vlib.h>
 #include <vlib/unix/unix.h>
 #include <vlibapi/api.h>
@@ -2235,6 +2236,14 @@ static void *vl_api_span_create_t_print
   s = format (0, "SCRIPT: span_create ");
   s = format (s, "sw_if_index_from %u ", ntohl (mp->sw_if_index_from));
   s = format (s, "sw_if_index_to %u ", ntohl (mp->sw_if_index_to));
+  s = format (s, "mode %s ",
+	      mp->mode == SPAN_MIRROR_MODE_CLONE ? "clone" : "copy");
+  if (mp->snaplen)
+    s = format (s, "snaplen %u ", ntohs (mp->snaplen));
+  if (mp->direction)
+    s = format (s, "%U ", format_span_direction, mp->direction);
+  if (mp->is_l2)
+    s = format (s, "l2 ");
 
   FINISH;
 }
@@ -2246,6 +2255,88 @@ static void *vl_api_span_delete_t_print
 
   s = format (0, "SCRIPT: span_delete ");
   s = format (s, "sw_if_index_from %u ", ntohl (mp->sw_if_index_from));
+  if (mp->sw_if_index_to != ~0)
+    s = format (s, "sw_if_index_to %u ", ntohl (mp->sw_if_index_to));
+
+  FINISH;
+}
+
+static void *vl_api_span_rate_limit_t_print
+  (vl_api_span_rate_limit_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: span_rate_limit ");
+  s = format (s, "sw_if_index_to %u ", ntohl (mp->sw_if_index_to));
+  s = format (s, "max_pps %u ", ntohl (mp->max_pps));
+
+  FINISH;
+}
+
+static void *vl_api_span_classify_t_print
+  (vl_api_span_classify_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: span_classify ");
+  s = format (s, "sw_if_index_from %u ", ntohl (mp->sw_if_index_from));
+  if (ntohl (mp->table_index) != ~0)
+    s = format (s, "table_index %u ", ntohl (mp->table_index));
+  else
+    s = format (s, "disable ");
+
+  FINISH;
+}
+
+static void *vl_api_span_sample_t_print
+  (vl_api_span_sample_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: span_sample ");
+  s = format (s, "sw_if_index_from %u ", ntohl (mp->sw_if_index_from));
+  if (mp->mode != SPAN_SAMPLE_NONE)
+    s = format (s, "%U %u ", format_span_sample_mode, mp->mode,
+		ntohl (mp->rate));
+  else
+    s = format (s, "disable ");
+
+  FINISH;
+}
+
+static void *vl_api_span_metadata_t_print
+  (vl_api_span_metadata_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: span_metadata ");
+  s = format (s, "sw_if_index_from %u ", ntohl (mp->sw_if_index_from));
+  if (mp->mode != SPAN_METADATA_NONE)
+    s = format (s, "%U ", format_span_metadata_mode, mp->mode);
+  else
+    s = format (s, "disable ");
+
+  FINISH;
+}
+
+static void *vl_api_erspan_add_del_tunnel_t_print
+  (vl_api_erspan_add_del_tunnel_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: erspan_add_del_tunnel ");
+  s = format (s, "src %U ", format_ip4_address,
+	      (ip4_address_t *) mp->src_address);
+  s = format (s, "dst %U ", format_ip4_address,
+	      (ip4_address_t *) mp->dst_address);
+  s = format (s, "session-id %d ", ntohs (mp->session_id));
+  s = format (s, "type %d ", mp->type);
+
+  if (mp->encap_vrf_id)
+    s = format (s, "encap-vrf-id %d ", ntohl (mp->encap_vrf_id));
+
+  if (mp->is_add == 0)
+    s = format (s, "del ");
 
   FINISH;
 }
@@ -2989,6 +3080,11 @@ _(IPFIX_CLASSIFY_TABLE_ADD_DEL, ipfix_classify_table_add_del)           \
 _(IPFIX_CLASSIFY_TABLE_DUMP, ipfix_classify_table_dump)                 \
 _(SPAN_CREATE, span_create)                                             \
 _(SPAN_DELETE, span_delete)                                             \
+_(SPAN_RATE_LIMIT, span_rate_limit)                                     \
+_(SPAN_CLASSIFY, span_classify)                                         \
+_(SPAN_SAMPLE, span_sample)                                             \
+_(SPAN_METADATA, span_metadata)                                         \
+_(ERSPAN_ADD_DEL_TUNNEL, erspan_add_del_tunnel)                         \
 _(SPAN_DUMP, span_dump)                                                 \
 _(GET_NEXT_INDEX, get_next_index)                                       \
 _(PG_CREATE_INTERFACE,pg_create_interface)                              \
@@ -38,6 +38,12 @@
     backing pages.  We use an additional log2_pages' worth of bits
     from h(k) to compute the offset of the page which will contain the
     (key,value) pair we're trying to find.
+
+    Writers lock the bucket they modify, so writers of different
+    buckets run in parallel, and bump the bucket version when they
+    unlock it. Readers never lock: they wait for the bucket to be
+    unlocked, search its pages, and search again if the bucket
+    changed while they were at it.
 */
 
 /** template key/value backing page structure */
@@ -58,8 +64,9 @@ typedef struct clib_bihash_value
     struct
     {
       u32 offset;  /**< backing page offset in the clib memory heap */
-      u8 pad[3];   /**< log2 (size of the packing page block) */
-      u8 log2_pages;
+      u16 version; /**< bumped by each writer, readers retry on a change */
+      u8 lock;     /**< writer lock of the bucket */
+      u8 log2_pages; /**< log2 (size of the packing page block) */
     };
     u64 as_u64;
   };
@@ -69,10 +76,7 @@ typedef struct clib_bihash_value
 typedef struct
 {
   clib_bihash_bucket_t *buckets;  /**< Hash bucket vector, power-of-two in size */
-  volatile u32 *writer_lock;  /**< Writer lock, in its own cache line */
-    BVT (clib_bihash_value) ** working_copies;
-					    /**< Working copies (various sizes), to avoid locking against readers */
-  clib_bihash_bucket_t saved_bucket; /**< Saved bucket pointer */
+  volatile u32 *alloc_lock;  /**< Freelist and heap lock, in its own cache line */
   u32 nbuckets;			     /**< Number of hash buckets */
   u32 log2_nbuckets;		     /**< lg(nbuckets) */
   u8 *name;			     /**< hash table name */
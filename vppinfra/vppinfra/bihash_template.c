@@ -30,8 +30,9 @@ void BV (clib_bihash_init)
 
   oldheap = clib_mem_set_heap (h->mheap);
   vec_validate_aligned (h->buckets, nbuckets - 1, CLIB_CACHE_LINE_BYTES);
-  h->writer_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,
-					   CLIB_CACHE_LINE_BYTES);
+  h->alloc_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,
+					  CLIB_CACHE_LINE_BYTES);
+  h->alloc_lock[0] = 0;
 
   clib_mem_set_heap (oldheap);
 }
@@ -49,7 +50,9 @@ BV (value_alloc) (BVT (clib_bihash) * h, u32 log2_pages)
   BVT (clib_bihash_value) * rv = 0;
   void *oldheap;
 
-  ASSERT (h->writer_lock[0]);
+  while (__sync_lock_test_and_set (h->alloc_lock, 1))
+    clib_smp_pause ();
+
   if (log2_pages >= vec_len (h->freelists) || h->freelists[log2_pages] == 0)
     {
       oldheap = clib_mem_set_heap (h->mheap);
@@ -63,6 +66,9 @@ BV (value_alloc) (BVT (clib_bihash) * h, u32 log2_pages)
   h->freelists[log2_pages] = rv->next_free;
 
 initialize:
+  CLIB_MEMORY_BARRIER ();
+  h->alloc_lock[0] = 0;
+
   ASSERT (rv);
   ASSERT (vec_len (rv) == (1 << log2_pages));
   /*
@@ -74,65 +80,27 @@ initialize:
   return rv;
 }
 
+/*
+ * Readers may still be searching v: it stays in the heap, and the bucket
+ * it belonged to has changed, so they will search again.
+ */
 static void
 BV (value_free) (BVT (clib_bihash) * h, BVT (clib_bihash_value) * v)
 {
   u32 log2_pages;
 
-  ASSERT (h->writer_lock[0]);
-
   log2_pages = min_log2 (vec_len (v));
 
+  while (__sync_lock_test_and_set (h->alloc_lock, 1))
+    clib_smp_pause ();
+
   ASSERT (vec_len (h->freelists) > log2_pages);
 
   v->next_free = h->freelists[log2_pages];
   h->freelists[log2_pages] = v;
-}
-
-static inline void
-BV (make_working_copy) (BVT (clib_bihash) * h, clib_bihash_bucket_t * b)
-{
-  BVT (clib_bihash_value) * v;
-  clib_bihash_bucket_t working_bucket __attribute__ ((aligned (8)));
-  void *oldheap;
-  BVT (clib_bihash_value) * working_copy;
-  u32 cpu_number = os_get_cpu_number ();
-
-  if (cpu_number >= vec_len (h->working_copies))
-    {
-      oldheap = clib_mem_set_heap (h->mheap);
-      vec_validate (h->working_copies, cpu_number);
-      clib_mem_set_heap (oldheap);
-    }
-
-  /*
-   * working_copies are per-cpu so that near-simultaneous
-   * updates from multiple threads will not result in sporadic, spurious
-   * lookup failures.
-   */
-  working_copy = h->working_copies[cpu_number];
-
-  h->saved_bucket.as_u64 = b->as_u64;
-  oldheap = clib_mem_set_heap (h->mheap);
-
-  if ((1 << b->log2_pages) > vec_len (working_copy))
-    {
-      vec_validate_aligned (working_copy, (1 << b->log2_pages) - 1,
-			    sizeof (u64));
-      h->working_copies[cpu_number] = working_copy;
-    }
-
-  _vec_len (working_copy) = 1 << b->log2_pages;
-  clib_mem_set_heap (oldheap);
 
-  v = BV (clib_bihash_get_value) (h, b->offset);
-
-  clib_memcpy (working_copy, v, sizeof (*v) * (1 << b->log2_pages));
-  working_bucket.as_u64 = b->as_u64;
-  working_bucket.offset = BV (clib_bihash_get_offset) (h, working_copy);
   CLIB_MEMORY_BARRIER ();
-  b->as_u64 = working_bucket.as_u64;
-  h->working_copies[cpu_number] = working_copy;
+  h->alloc_lock[0] = 0;
 }
 
 static
@@ -182,18 +150,22 @@ BV (split_and_rehash)
   return new_values;
 }
 
+/*
+ * Writers of different buckets do not wait for each other: the bucket
+ * lock serializes the writers of a bucket, and its version tells the
+ * readers to search again.
+ */
 int BV (clib_bihash_add_del)
   (BVT (clib_bihash) * h, BVT (clib_bihash_kv) * add_v, int is_add)
 {
   u32 bucket_index;
   clib_bihash_bucket_t *b, tmp_b;
-  BVT (clib_bihash_value) * v, *new_v, *save_new_v, *working_copy;
+  BVT (clib_bihash_value) * v, *old_v, *new_v, *save_new_v;
   u32 value_index;
   int rv = 0;
   int i;
   u64 hash, new_hash;
   u32 new_log2_pages;
-  u32 cpu_number = os_get_cpu_number ();
 
   hash = BV (clib_bihash_hash) (add_v);
 
@@ -202,8 +174,7 @@ int BV (clib_bihash_add_del)
 
   hash >>= h->log2_nbuckets;
 
-  while (__sync_lock_test_and_set (h->writer_lock, 1))
-    ;
+  clib_bihash_bucket_lock (b);
 
   /* First elt in the bucket? */
   if (b->offset == 0)
@@ -216,18 +187,18 @@ int BV (clib_bihash_add_del)
 
       v = BV (value_alloc) (h, 0);
       *v->kvp = *add_v;
-      tmp_b.as_u64 = 0;
+      tmp_b.as_u64 = b->as_u64;
       tmp_b.offset = BV (clib_bihash_get_offset) (h, v);
+      tmp_b.log2_pages = 0;
 
+      CLIB_MEMORY_BARRIER ();
       b->as_u64 = tmp_b.as_u64;
       goto unlock;
     }
 
-  BV (make_working_copy) (h, b);
-
-  v = BV (clib_bihash_get_value) (h, h->saved_bucket.offset);
-  value_index = hash & ((1 << h->saved_bucket.log2_pages) - 1);
-  v += value_index;
+  old_v = BV (clib_bihash_get_value) (h, b->offset);
+  value_index = hash & ((1 << b->log2_pages) - 1);
+  v = old_v + value_index;
 
   if (is_add)
     {
@@ -240,9 +211,6 @@ int BV (clib_bihash_add_del)
 	  if (!memcmp (&(v->kvp[i]), &add_v->key, sizeof (add_v->key)))
 	    {
 	      clib_memcpy (&(v->kvp[i]), add_v, sizeof (*add_v));
-	      CLIB_MEMORY_BARRIER ();
-	      /* Restore the previous (k,v) pairs */
-	      b->as_u64 = h->saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
@@ -251,8 +219,6 @@ int BV (clib_bihash_add_del)
 	  if (BV (clib_bihash_is_free) (&(v->kvp[i])))
 	    {
 	      clib_memcpy (&(v->kvp[i]), add_v, sizeof (*add_v));
-	      CLIB_MEMORY_BARRIER ();
-	      b->as_u64 = h->saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
@@ -265,21 +231,17 @@ int BV (clib_bihash_add_del)
 	  if (!memcmp (&(v->kvp[i]), &add_v->key, sizeof (add_v->key)))
 	    {
 	      memset (&(v->kvp[i]), 0xff, sizeof (*(add_v)));
-	      CLIB_MEMORY_BARRIER ();
-	      b->as_u64 = h->saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
       rv = -3;
-      b->as_u64 = h->saved_bucket.as_u64;
       goto unlock;
     }
 
-  new_log2_pages = h->saved_bucket.log2_pages + 1;
+  new_log2_pages = b->log2_pages + 1;
 
 expand_again:
-  working_copy = h->working_copies[cpu_number];
-  new_v = BV (split_and_rehash) (h, working_copy, new_log2_pages);
+  new_v = BV (split_and_rehash) (h, old_v, new_log2_pages);
   if (new_v == 0)
     {
       new_log2_pages++;
@@ -307,16 +269,15 @@ expand_again:
   goto expand_again;
 
 expand_ok:
+  tmp_b.as_u64 = b->as_u64;
   tmp_b.log2_pages = min_log2 (vec_len (save_new_v));
   tmp_b.offset = BV (clib_bihash_get_offset) (h, save_new_v);
   CLIB_MEMORY_BARRIER ();
   b->as_u64 = tmp_b.as_u64;
-  v = BV (clib_bihash_get_value) (h, h->saved_bucket.offset);
-  BV (value_free) (h, v);
+  BV (value_free) (h, old_v);
 
 unlock:
-  CLIB_MEMORY_BARRIER ();
-  h->writer_lock[0] = 0;
+  clib_bihash_bucket_unlock (b);
   return rv;
 }
 
@@ -324,38 +285,7 @@ int BV (clib_bihash_search)
   (const BVT (clib_bihash) * h,
    BVT (clib_bihash_kv) * search_key, BVT (clib_bihash_kv) * valuep)
 {
-  u64 hash;
-  u32 bucket_index;
-  uword value_index;
-  BVT (clib_bihash_value) * v;
-  clib_bihash_bucket_t *b;
-  int i;
-
-  ASSERT (valuep);
-
-  hash = BV (clib_bihash_hash) (search_key);
-
-  bucket_index = hash & (h->nbuckets - 1);
-  b = &h->buckets[bucket_index];
-
-  if (b->offset == 0)
-    return -1;
-
-  hash >>= h->log2_nbuckets;
-
-  v = BV (clib_bihash_get_value) (h, b->offset);
-  value_index = hash & ((1 << b->log2_pages) - 1);
-  v += value_index;
-
-  for (i = 0; i < BIHASH_KVP_PER_PAGE; i++)
-    {
-      if (BV (clib_bihash_key_compare) (v->kvp[i].key, search_key->key))
-	{
-	  *valuep = v->kvp[i];
-	  return 0;
-	}
-    }
-  return -1;
+  return BV (clib_bihash_search_inline_2) (h, search_key, valuep);
 }
 
 u8 *BV (format_bihash) (u8 * s, va_list * args)
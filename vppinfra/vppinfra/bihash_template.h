@@ -26,6 +26,7 @@
 #include <vppinfra/heap.h>
 #include <vppinfra/format.h>
 #include <vppinfra/pool.h>
+#include <vppinfra/smp.h>
 
 #ifndef BIHASH_TYPE
 #error BIHASH_TYPE not defined
@@ -61,22 +62,70 @@ typedef struct
     struct
     {
       u32 offset;
-      u8 pad[3];
+      u16 version;
+      u8 lock;
       u8 log2_pages;
     };
     u64 as_u64;
   };
 } clib_bihash_bucket_t;
+
+/*
+ * Writers lock the bucket they change, and bump its version when they
+ * unlock it. Readers take a snapshot of the (unlocked) bucket, search its
+ * pages, and search again if the bucket changed meanwhile. The version
+ * wraps after 64K updates of a bucket, far more than a search can miss.
+ */
+static inline u64
+clib_bihash_bucket_read (clib_bihash_bucket_t * b)
+{
+  clib_bihash_bucket_t snapshot;
+
+  while (1)
+    {
+      snapshot.as_u64 = *(volatile u64 *) & b->as_u64;
+      if (PREDICT_TRUE (snapshot.lock == 0))
+	break;
+      clib_smp_pause ();
+    }
+  CLIB_MEMORY_LOAD_BARRIER ();
+  return snapshot.as_u64;
+}
+
+static inline int
+clib_bihash_bucket_changed (clib_bihash_bucket_t * b, u64 snapshot)
+{
+  CLIB_MEMORY_LOAD_BARRIER ();
+  return *(volatile u64 *) & b->as_u64 != snapshot;
+}
+
+static inline void
+clib_bihash_bucket_lock (clib_bihash_bucket_t * b)
+{
+  while (__sync_lock_test_and_set (&b->lock, 1))
+    clib_smp_pause ();
+}
+
+static inline void
+clib_bihash_bucket_unlock (clib_bihash_bucket_t * b)
+{
+  clib_bihash_bucket_t tmp_b;
+
+  tmp_b.as_u64 = b->as_u64;
+  tmp_b.version++;
+  tmp_b.lock = 0;
+  CLIB_MEMORY_BARRIER ();
+  b->as_u64 = tmp_b.as_u64;
+}
 #endif /* __defined_clib_bihash_bucket_t__ */
 
 typedef struct
 {
   BVT (clib_bihash_value) * values;
   clib_bihash_bucket_t *buckets;
-  volatile u32 *writer_lock;
 
-    BVT (clib_bihash_value) ** working_copies;
-  clib_bihash_bucket_t saved_bucket;
+  /* Writers lock buckets, this only protects the freelists and heap */
+  volatile u32 *alloc_lock;
 
   u32 nbuckets;
   u32 log2_nbuckets;
@@ -127,41 +176,6 @@ format_function_t BV (format_bihash);
 format_function_t BV (format_bihash_kvp);
 
 
-static inline int BV (clib_bihash_search_inline)
-  (const BVT (clib_bihash) * h, BVT (clib_bihash_kv) * kvp)
-{
-  u64 hash;
-  u32 bucket_index;
-  uword value_index;
-  BVT (clib_bihash_value) * v;
-  clib_bihash_bucket_t *b;
-  int i;
-
-  hash = BV (clib_bihash_hash) (kvp);
-
-  bucket_index = hash & (h->nbuckets - 1);
-  b = &h->buckets[bucket_index];
-
-  if (b->offset == 0)
-    return -1;
-
-  hash >>= h->log2_nbuckets;
-
-  v = BV (clib_bihash_get_value) (h, b->offset);
-  value_index = hash & ((1 << b->log2_pages) - 1);
-  v += value_index;
-
-  for (i = 0; i < BIHASH_KVP_PER_PAGE; i++)
-    {
-      if (BV (clib_bihash_key_compare) (v->kvp[i].key, kvp->key))
-	{
-	  *kvp = v->kvp[i];
-	  return 0;
-	}
-    }
-  return -1;
-}
-
 static inline int BV (clib_bihash_search_inline_2)
   (const BVT (clib_bihash) * h,
    BVT (clib_bihash_kv) * search_key, BVT (clib_bihash_kv) * valuep)
@@ -170,8 +184,9 @@ static inline int BV (clib_bihash_search_inline_2)
   u32 bucket_index;
   uword value_index;
   BVT (clib_bihash_value) * v;
-  clib_bihash_bucket_t *b;
-  int i;
+  BVT (clib_bihash_kv) kv;
+  clib_bihash_bucket_t *b, snapshot;
+  int i, rv;
 
   ASSERT (valuep);
 
@@ -180,24 +195,41 @@ static inline int BV (clib_bihash_search_inline_2)
   bucket_index = hash & (h->nbuckets - 1);
   b = &h->buckets[bucket_index];
 
-  if (b->offset == 0)
-    return -1;
-
   hash >>= h->log2_nbuckets;
 
-  v = BV (clib_bihash_get_value) (h, b->offset);
-  value_index = hash & ((1 << b->log2_pages) - 1);
-  v += value_index;
-
-  for (i = 0; i < BIHASH_KVP_PER_PAGE; i++)
+  do
     {
-      if (BV (clib_bihash_key_compare) (v->kvp[i].key, search_key->key))
+      snapshot.as_u64 = clib_bihash_bucket_read (b);
+
+      if (snapshot.offset == 0)
+	return -1;
+
+      v = BV (clib_bihash_get_value) (h, snapshot.offset);
+      value_index = hash & ((1 << snapshot.log2_pages) - 1);
+      v += value_index;
+
+      rv = -1;
+      for (i = 0; i < BIHASH_KVP_PER_PAGE; i++)
 	{
-	  *valuep = v->kvp[i];
-	  return 0;
+	  if (BV (clib_bihash_key_compare) (v->kvp[i].key, search_key->key))
+	    {
+	      kv = v->kvp[i];
+	      rv = 0;
+	      break;
+	    }
 	}
     }
-  return -1;
+  while (PREDICT_FALSE (clib_bihash_bucket_changed (b, snapshot.as_u64)));
+
+  if (rv == 0)
+    *valuep = kv;
+  return rv;
+}
+
+static inline int BV (clib_bihash_search_inline)
+  (const BVT (clib_bihash) * h, BVT (clib_bihash_kv) * kvp)
+{
+  return BV (clib_bihash_search_inline_2) (h, kvp, kvp);
 }
 
 
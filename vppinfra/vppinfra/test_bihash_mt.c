@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2016 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Multi-threaded bihash stress and throughput test. Reader threads look
+ * up a fixed set of keys, which must always be found, while 0, 1 and N
+ * writer threads add, look up and delete keys of their own in the same
+ * table. Reports the lookups per second of the readers in each case.
+ *
+ * Threads other than the main thread only allocate memory from the
+ * table heap, under its lock.
+ */
+
+#include <pthread.h>
+
+#include <vppinfra/time.h>
+#include <vppinfra/cache.h>
+#include <vppinfra/error.h>
+#include <vppinfra/random.h>
+
+#include <vppinfra/bihash_8_8.h>
+#include <vppinfra/bihash_template.h>
+
+#include <vppinfra/bihash_template.c>
+
+struct test_main_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  struct test_main_t *tm;
+  u32 index;
+  u64 n_ops;
+  u64 n_errors;
+  pthread_t thread;
+} test_thread_t;
+
+typedef struct test_main_t
+{
+  u32 seed;
+  u32 nbuckets;
+  u32 nitems;
+  u32 nchurn;
+  u32 nreaders;
+  u32 nwriters;
+  f64 seconds;
+  int verbose;
+
+  /* nitems reader keys, then nchurn keys per writer */
+  u64 *keys;
+  uword *key_hash;
+
+  volatile u32 stop;
+  test_thread_t *readers;
+  test_thread_t *writers;
+
+    BVT (clib_bihash) hash;
+  clib_time_t clib_time;
+
+  unformat_input_t *input;
+
+} test_main_t;
+
+test_main_t test_main;
+
+static void *
+reader_thread (void *arg)
+{
+  test_thread_t *tt = arg;
+  test_main_t *tm = tt->tm;
+  BVT (clib_bihash_kv) kv;
+  u32 i;
+
+  while (!tm->stop)
+    {
+      for (i = 0; i < tm->nitems; i++)
+	{
+	  kv.key = tm->keys[i];
+	  if (BV (clib_bihash_search_inline) (&tm->hash, &kv) < 0
+	      || kv.value != (u64) (i + 1))
+	    tt->n_errors++;
+	  tt->n_ops++;
+	}
+    }
+  return 0;
+}
+
+static void *
+writer_thread (void *arg)
+{
+  test_thread_t *tt = arg;
+  test_main_t *tm = tt->tm;
+  BVT (clib_bihash_kv) kv;
+  u32 first, i;
+
+  first = tm->nitems + tt->index * tm->nchurn;
+
+  /* Whole passes only, the table holds the reader keys on return */
+  while (!tm->stop)
+    {
+      for (i = first; i < first + tm->nchurn; i++)
+	{
+	  kv.key = tm->keys[i];
+	  kv.value = i + 1;
+	  BV (clib_bihash_add_del) (&tm->hash, &kv, 1 /* is_add */ );
+	}
+      for (i = first; i < first + tm->nchurn; i++)
+	{
+	  kv.key = tm->keys[i];
+	  if (BV (clib_bihash_search) (&tm->hash, &kv, &kv) < 0
+	      || kv.value != (u64) (i + 1))
+	    tt->n_errors++;
+	}
+      for (i = first; i < first + tm->nchurn; i++)
+	{
+	  kv.key = tm->keys[i];
+	  if (BV (clib_bihash_add_del) (&tm->hash, &kv, 0 /* is_add */ ) < 0)
+	    tt->n_errors++;
+	}
+      tt->n_ops += 2 * tm->nchurn;
+    }
+  return 0;
+}
+
+static u64
+test_run (test_main_t * tm, u32 nwriters)
+{
+  test_thread_t *tt;
+  u64 n_lookups = 0, n_updates = 0, n_errors = 0;
+  f64 before, delta;
+
+  tm->stop = 0;
+
+  before = clib_time_now (&tm->clib_time);
+
+  vec_foreach (tt, tm->readers)
+  {
+    tt->n_ops = tt->n_errors = 0;
+    if (pthread_create (&tt->thread, 0, reader_thread, tt))
+      clib_unix_warning ("pthread_create");
+  }
+  for (tt = tm->writers; tt < tm->writers + nwriters; tt++)
+    {
+      tt->n_ops = tt->n_errors = 0;
+      if (pthread_create (&tt->thread, 0, writer_thread, tt))
+	clib_unix_warning ("pthread_create");
+    }
+
+  while (clib_time_now (&tm->clib_time) - before < tm->seconds)
+    unix_sleep (10e-3);
+  tm->stop = 1;
+
+  vec_foreach (tt, tm->readers)
+  {
+    pthread_join (tt->thread, 0);
+    n_lookups += tt->n_ops;
+    n_errors += tt->n_errors;
+  }
+  for (tt = tm->writers; tt < tm->writers + nwriters; tt++)
+    {
+      pthread_join (tt->thread, 0);
+      n_updates += tt->n_ops;
+      n_errors += tt->n_errors;
+    }
+
+  delta = clib_time_now (&tm->clib_time) - before;
+
+  fformat (stdout, "%d readers, %d writers: %.f lookups per second, "
+	   "%.f adds and deletes per second, %lld errors\n",
+	   vec_len (tm->readers), nwriters, (f64) n_lookups / delta,
+	   (f64) n_updates / delta, n_errors);
+
+  return n_errors;
+}
+
+static clib_error_t *
+test_bihash_mt (test_main_t * tm)
+{
+  BVT (clib_bihash) * h;
+  BVT (clib_bihash_kv) kv;
+  u64 n_errors = 0;
+  u32 nwriters[3];
+  uword *p;
+  int i;
+
+  h = &tm->hash;
+
+  BV (clib_bihash_init) (h, "test", tm->nbuckets, 3ULL << 30);
+
+  fformat (stdout, "Pick %d reader and %d writer keys...\n",
+	   tm->nitems, tm->nwriters * tm->nchurn);
+
+  for (i = 0; i < tm->nitems + tm->nwriters * tm->nchurn; i++)
+    {
+      u64 rndkey;
+
+    again:
+      rndkey = random_u64 (&tm->seed);
+
+      p = hash_get (tm->key_hash, rndkey);
+      if (p)
+	goto again;
+
+      hash_set (tm->key_hash, rndkey, i + 1);
+      vec_add1 (tm->keys, rndkey);
+    }
+
+  for (i = 0; i < tm->nitems; i++)
+    {
+      kv.key = tm->keys[i];
+      kv.value = i + 1;
+      BV (clib_bihash_add_del) (h, &kv, 1 /* is_add */ );
+    }
+
+  vec_validate_aligned (tm->readers, tm->nreaders - 1, CLIB_CACHE_LINE_BYTES);
+  vec_validate_aligned (tm->writers, tm->nwriters - 1, CLIB_CACHE_LINE_BYTES);
+  for (i = 0; i < tm->nreaders; i++)
+    {
+      tm->readers[i].tm = tm;
+      tm->readers[i].index = i;
+    }
+  for (i = 0; i < tm->nwriters; i++)
+    {
+      tm->writers[i].tm = tm;
+      tm->writers[i].index = i;
+    }
+
+  /* 0, 1 and N concurrent writers */
+  nwriters[0] = 0;
+  nwriters[1] = 1;
+  nwriters[2] = tm->nwriters;
+  for (i = 0; i < ARRAY_LEN (nwriters); i++)
+    if (i == 0 || nwriters[i] > nwriters[i - 1])
+      n_errors += test_run (tm, nwriters[i]);
+
+  if (tm->verbose)
+    fformat (stdout, "%U", BV (format_bihash), h, 0 /* very verbose */ );
+
+  /* The writers deleted all their keys */
+  for (i = 0; i < tm->nitems + tm->nwriters * tm->nchurn; i++)
+    {
+      kv.key = tm->keys[i];
+      if ((BV (clib_bihash_search) (h, &kv, &kv) == 0) != (i < tm->nitems))
+	n_errors++;
+    }
+
+  vec_free (tm->readers);
+  vec_free (tm->writers);
+  BV (clib_bihash_free) (h);
+
+  if (n_errors)
+    return clib_error_return (0, "%lld errors", n_errors);
+
+  return 0;
+}
+
+clib_error_t *
+test_bihash_mt_main (test_main_t * tm)
+{
+  unformat_input_t *i = tm->input;
+  clib_error_t *error;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "seed %u", &tm->seed))
+	;
+      else if (unformat (i, "nbuckets %d", &tm->nbuckets))
+	;
+      else if (unformat (i, "nitems %d", &tm->nitems))
+	;
+      else if (unformat (i, "nchurn %d", &tm->nchurn))
+	;
+      else if (unformat (i, "readers %d", &tm->nreaders))
+	;
+      else if (unformat (i, "writers %d", &tm->nwriters))
+	;
+      else if (unformat (i, "seconds %f", &tm->seconds))
+	;
+      else if (unformat (i, "verbose"))
+	tm->verbose = 1;
+      else
+	return clib_error_return (0, "unknown input '%U'",
+				  format_unformat_error, i);
+    }
+
+  if (tm->nreaders == 0 || tm->nwriters == 0)
+    return clib_error_return (0, "readers and writers must be > 0");
+
+  error = test_bihash_mt (tm);
+
+  return error;
+}
+
+#ifdef CLIB_UNIX
+int
+main (int argc, char *argv[])
+{
+  unformat_input_t i;
+  clib_error_t *error;
+  test_main_t *tm = &test_main;
+
+  clib_mem_init (0, 3ULL << 30);
+
+  tm->input = &i;
+  tm->seed = 0xdeaddabe;
+
+  tm->nbuckets = 64 << 10;
+  tm->nitems = 100 << 10;
+  tm->nchurn = 10 << 10;
+  tm->nreaders = 2;
+  tm->nwriters = 4;
+  tm->seconds = 1.0;
+  tm->key_hash = hash_create (0, sizeof (uword));
+  clib_time_init (&tm->clib_time);
+
+  unformat_init_command_line (&i, argv);
+  error = test_bihash_mt_main (tm);
+  unformat_free (&i);
+
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+#endif /* CLIB_UNIX */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -95,6 +95,11 @@ typedef u64 u64x2 _vector_size (16);
 
 typedef f32 f32x4 _vector_size (16);
 typedef f64 f64x2 _vector_size (16);
+
+/* Unsigned 256 bit: pairs of 128 bit vectors, single registers in code
+   compiled for AVX2 (e.g. the avx2 variants of multiarch node functions). */
+typedef u32 u32x8 _vector_size (32);
+typedef u64 u64x4 _vector_size (32);
 #endif /* CLIB_HAVE_VEC128 */
 
 /* Vector word sized types. */